@@ -0,0 +1,220 @@
+/* Runs the benchmarks and reports how long each operation takes, how many
+ * allocations it makes and how many cycles it uses
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER
+#endif
+
+struct bench_result {
+    double ns_per_op;
+    double allocs_per_op;
+    double cycles_per_op;
+};
+
+/* Counting allocations. With glibc we can just put our own malloc() in front
+ * of the real one, which catches everything GLib allocates as well. Everywhere
+ * else allocations just don't get counted.
+ */
+static unsigned long alloc_count;
+
+#ifdef __GLIBC__
+#define HAVE_ALLOC_COUNTER
+
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+
+void * malloc(size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t nmemb, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif // __GLIBC__
+
+static inline uint64_t get_cycles() {
+#ifdef HAVE_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t get_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int compare_doubles(const void * a, const void * b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static double median(double * values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    return values[count / 2];
+}
+
+static void run_bench(const struct sqchat_bench * bench,
+                      unsigned long iterations,
+                      int rounds,
+                      struct bench_result * result) {
+    double ns[rounds];
+    double allocs[rounds];
+    double cycles[rounds];
+    void * data = bench->setup();
+
+    // Warm up the caches before we start measuring anything
+    bench->run(data, iterations / 10 + 1);
+
+    for (int i = 0; i < rounds; i++) {
+        unsigned long start_allocs = alloc_count;
+        uint64_t start_cycles = get_cycles();
+        uint64_t start_ns = get_ns();
+
+        bench->run(data, iterations);
+
+        ns[i] = (double)(get_ns() - start_ns) / iterations;
+        cycles[i] = (double)(get_cycles() - start_cycles) / iterations;
+        allocs[i] = (double)(alloc_count - start_allocs) / iterations;
+    }
+
+    bench->teardown(data);
+
+    result->ns_per_op = median(ns, rounds);
+    result->allocs_per_op = median(allocs, rounds);
+    result->cycles_per_op = median(cycles, rounds);
+}
+
+static void print_usage(const char * name) {
+    fprintf(stderr,
+            "Usage: %s [options] [benchmark...]\n"
+            "  -n ITERATIONS  Operations per round (default: %d)\n"
+            "  -r ROUNDS      Rounds to take the median of (default: %d)\n"
+            "  -j             Print the results as JSON\n"
+            "  -l             List the benchmarks and exit\n",
+            name, SQCHAT_BENCH_ITERATIONS, SQCHAT_BENCH_ROUNDS);
+}
+
+static bool is_selected(const char * name, char ** selected, int count) {
+    if (count == 0)
+        return true;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, selected[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char * argv[]) {
+    unsigned long iterations = SQCHAT_BENCH_ITERATIONS;
+    int rounds = SQCHAT_BENCH_ROUNDS;
+    bool json = false;
+    bool first = true;
+    int arg;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+            iterations = strtoul(argv[++arg], NULL, 10);
+        else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc)
+            rounds = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-j") == 0)
+            json = true;
+        else if (strcmp(argv[arg], "-l") == 0) {
+            for (const struct sqchat_bench * b = sqchat_benchmarks;
+                 b->name != NULL; b++)
+                printf("%s\n", b->name);
+            return 0;
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (iterations == 0 || rounds <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (json)
+        printf("{\"iterations\": %lu, \"rounds\": %d, \"benchmarks\": [",
+               iterations, rounds);
+    else
+        printf("%-24s %12s %12s %12s\n",
+               "benchmark", "ns/op", "allocs/op", "cycles/op");
+
+    for (const struct sqchat_bench * b = sqchat_benchmarks;
+         b->name != NULL; b++) {
+        struct bench_result result;
+
+        if (!is_selected(b->name, &argv[arg], argc - arg))
+            continue;
+
+        run_bench(b, iterations, rounds, &result);
+
+        if (json) {
+            printf("%s\n  {\"name\": \"%s\", \"ns_per_op\": %.3f",
+                   first ? "" : ",", b->name, result.ns_per_op);
+#ifdef HAVE_ALLOC_COUNTER
+            printf(", \"allocs_per_op\": %.3f", result.allocs_per_op);
+#else
+            printf(", \"allocs_per_op\": null");
+#endif
+#ifdef HAVE_CYCLE_COUNTER
+            printf(", \"cycles_per_op\": %.1f}", result.cycles_per_op);
+#else
+            printf(", \"cycles_per_op\": null}");
+#endif
+        }
+        else
+            printf("%-24s %12.3f %12.3f %12.1f\n", b->name, result.ns_per_op,
+                   result.allocs_per_op, result.cycles_per_op);
+
+        first = false;
+    }
+
+    if (json)
+        printf("\n]}\n");
+
+    return 0;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,53 @@
+/* A tiny harness for timing the hot paths in squirrelcore
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdbool.h>
+
+/* How many times each benchmark gets run by default. The median of the rounds
+ * is what gets reported, which keeps the occasional context switch from
+ * throwing everything off
+ */
+#define SQCHAT_BENCH_ROUNDS     7
+#define SQCHAT_BENCH_ITERATIONS 200000
+
+struct sqchat_bench {
+    const char * name;
+
+    /* Sets up whatever the benchmark needs. This isn't timed, and whatever it
+     * returns gets passed to run() and teardown()
+     */
+    void * (*setup)();
+
+    // Runs the operation being measured the given number of times
+    void (*run)(void * data, unsigned long iterations);
+    void (*teardown)(void * data);
+};
+
+// Every benchmark we have, terminated by an entry with a NULL name
+extern const struct sqchat_bench sqchat_benchmarks[];
+
+/* Keeps the compiler from optimizing away a result we don't otherwise do
+ * anything with
+ */
+#define sqchat_bench_keep(value) \
+    __asm__ __volatile__("" : : "g"(value) : "memory")
+
+#endif // __BENCH_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
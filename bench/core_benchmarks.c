@@ -0,0 +1,250 @@
+/* Benchmarks for the message parser, the trie, the RFC1459 casemapping,
+ * nickname colors and highlighting
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include "irc_message.h"
+#include "irc_connection.h"
+#include "trie.h"
+#include "casemap.h"
+#include "nick_color.h"
+#include "highlight.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIE_KEY_COUNT 1024
+
+// A mix of what a busy channel usually looks like
+static const char * const sample_lines[] = {
+    ":nick!~user@host.example.com PRIVMSG #channel :hello there, how's it "
+        "going?",
+    ":irc.example.net 353 me = #channel :@op +voiced regular [away]nick "
+        "another_one someone_else",
+    ":nick!~user@host.example.com JOIN #channel",
+    ":nick!~user@host.example.com PART #channel :Leaving",
+    "PING :irc.example.net",
+    ":irc.example.net 005 me CHANTYPES=# EXCEPTS INVEX CHANMODES=eIbq,k,flj,"
+        "CFLMPQScgimnprstz PREFIX=(ov)@+ NETWORK=example :are supported by "
+        "this server",
+    ":nick!~user@host.example.com NOTICE me :\x01VERSION\x01",
+    ":other!~other@192.0.2.1 QUIT :Ping timeout: 240 seconds"
+};
+
+#define SAMPLE_LINE_COUNT (sizeof(sample_lines) / sizeof(sample_lines[0]))
+
+static void * no_setup() {
+    return NULL;
+}
+
+static void no_teardown(void * data) {}
+
+static void parse_msg_run(void * data, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++) {
+        struct sqchat_msg * msg =
+            sqchat_parse_msg(sample_lines[i % SAMPLE_LINE_COUNT]);
+
+        sqchat_bench_keep(msg);
+        free(msg);
+    }
+}
+
+/* Nicknames are what we look up in tries the most, so use keys that look like
+ * them. These are always generated the same way so runs can be compared
+ */
+struct trie_bench {
+    sqchat_trie * trie;
+    char keys[TRIE_KEY_COUNT][16];
+};
+
+static void * trie_setup() {
+    struct trie_bench * bench = malloc(sizeof(struct trie_bench));
+
+    bench->trie = sqchat_trie_new(sqchat_trie_rfc1459_strtolower);
+    for (int i = 0; i < TRIE_KEY_COUNT; i++) {
+        snprintf(bench->keys[i], sizeof(bench->keys[i]), "Nick[%x]_%d",
+                 (i * 2654435761u) & 0xffff, i);
+        sqchat_trie_set(bench->trie, bench->keys[i], bench->keys[i]);
+    }
+
+    return bench;
+}
+
+static void trie_teardown(struct trie_bench * bench) {
+    sqchat_trie_free(bench->trie, NULL, NULL);
+    free(bench);
+}
+
+static void trie_get_run(struct trie_bench * bench, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++)
+        sqchat_bench_keep(sqchat_trie_get(bench->trie,
+                                          bench->keys[i % TRIE_KEY_COUNT]));
+}
+
+static void trie_set_run(struct trie_bench * bench, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++) {
+        char * key = bench->keys[i % TRIE_KEY_COUNT];
+        sqchat_trie_set(bench->trie, key, key);
+    }
+}
+
+/* Deleting a key leaves the trie without it, so every delete gets paired with
+ * putting the key back
+ */
+static void trie_del_run(struct trie_bench * bench, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++) {
+        char * key = bench->keys[i % TRIE_KEY_COUNT];
+
+        sqchat_bench_keep(sqchat_trie_del(bench->trie, key));
+        sqchat_trie_set(bench->trie, key, key);
+    }
+}
+
+static void strcasecmp_run(void * data, unsigned long iterations) {
+    static const char * const pairs[][2] = {
+        { "SomeNick[away]",     "somenick{AWAY}" },
+        { "another_nick|work",  "ANOTHER_NICK\\WORK" },
+        { "#SquirrelChat",      "#squirrelchat" },
+        { "short",              "shorter" },
+        { "nick^",              "NICK~" },
+        { "DifferentNick",      "differentnack" }
+    };
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        const char * const * pair =
+            pairs[i % (sizeof(pairs) / sizeof(pairs[0]))];
+
+        sqchat_bench_keep(sqchat_rfc1459_strcasecmp(pair[0], pair[1]));
+    }
+}
+
+// This gets done for every message that's printed, so it needs to stay cheap
+static void nick_color_run(void * data, unsigned long iterations) {
+    static const char * const nicks[] = {
+        "SomeNick[away]", "another_nick|work", "short", "nick^",
+        "DifferentNick", "x"
+    };
+
+    for (unsigned long i = 0; i < iterations; i++)
+        sqchat_bench_keep(sqchat_nick_color_code(
+            nicks[i % (sizeof(nicks) / sizeof(nicks[0]))]));
+}
+
+/* Scanning messages for highlights, with a handful of keywords. Most messages
+ * don't highlight anyone, so most of these don't match.
+ */
+static void * highlight_setup() {
+    static const char * const keywords[] = {
+        "squirrelchat", "squirrel", "highlight me", "c++", "lyude", NULL
+    };
+    struct sqchat_highlighter * highlighter =
+        sqchat_highlighter_new(keywords, sqchat_trie_rfc1459_strtolower);
+
+    sqchat_highlighter_set_nickname(highlighter, "SomeNick[away]");
+    return highlighter;
+}
+
+static void highlight_run(struct sqchat_highlighter * highlighter,
+                          unsigned long iterations) {
+    static const char * const messages[] = {
+        "hello there, how's it going?",
+        "has anyone tried building squirrelchat on BSD yet?",
+        "somenick{away}: ping",
+        "I keep getting a segfault whenever I close a channel buffer, "
+            "does anyone else see that?",
+        "nope",
+        "somenick{away}ish isn't a real nickname"
+    };
+
+    for (unsigned long i = 0; i < iterations; i++)
+        sqchat_bench_keep(sqchat_highlighter_match(
+            highlighter,
+            messages[i % (sizeof(messages) / sizeof(messages[0]))]));
+}
+
+/* Splitting up lines in the receive buffer. The buffer gets filled the same way
+ * it would be by a read from the socket, and the cost of that is counted too
+ */
+struct next_line_bench {
+    struct sqchat_connection connection;
+    char chunk[SQCHAT_TLS_RECORD_LEN];
+    size_t chunk_len;
+};
+
+static void * next_line_setup() {
+    struct next_line_bench * bench = calloc(1, sizeof(struct next_line_bench));
+
+    for (int i = 0;; i++) {
+        const char * line = sample_lines[i % SAMPLE_LINE_COUNT];
+        size_t len = strlen(line);
+
+        if (bench->chunk_len + len + 2 >= sizeof(bench->chunk))
+            break;
+
+        memcpy(&bench->chunk[bench->chunk_len], line, len);
+        memcpy(&bench->chunk[bench->chunk_len + len], "\r\n", 2);
+        bench->chunk_len += len + 2;
+    }
+
+    return bench;
+}
+
+static void next_line_run(struct next_line_bench * bench,
+                          unsigned long iterations) {
+    struct sqchat_connection * connection = &bench->connection;
+    char * line;
+
+    while (iterations > 0) {
+        memcpy(connection->recv_buffer, bench->chunk, bench->chunk_len);
+        connection->recv_buffer[bench->chunk_len] = '\0';
+        connection->buffer_fill_len = bench->chunk_len;
+        connection->buffer_cursor = 0;
+
+        while (iterations > 0 &&
+               (line = sqchat_connection_next_line(connection)) != NULL) {
+            sqchat_bench_keep(line);
+            iterations--;
+        }
+    }
+}
+
+static void free_teardown(void * data) {
+    free(data);
+}
+
+const struct sqchat_bench sqchat_benchmarks[] = {
+    { "parse_msg",            no_setup,        parse_msg_run,
+                              no_teardown },
+    { "trie_get",             trie_setup,      (void*)trie_get_run,
+                              (void*)trie_teardown },
+    { "trie_set",             trie_setup,      (void*)trie_set_run,
+                              (void*)trie_teardown },
+    { "trie_del+set",         trie_setup,      (void*)trie_del_run,
+                              (void*)trie_teardown },
+    { "rfc1459_strcasecmp",   no_setup,        strcasecmp_run,
+                              no_teardown },
+    { "connection_next_line", next_line_setup, (void*)next_line_run,
+                              free_teardown },
+    { "nick_color",           no_setup,        nick_color_run,
+                              no_teardown },
+    { "highlight_match",      highlight_setup, (void*)highlight_run,
+                              (void*)sqchat_highlighter_free },
+    { NULL }
+};
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,251 @@
+/* A stand-in IRC server that runs on the loopback interface and plays back
+ * canned traffic to whoever connects to it
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fake_server.h"
+#include "macros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <gnutls/gnutls.h>
+#include <gnutls/x509.h>
+
+static double get_time() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Makes up a self-signed certificate for the server to use. The client doesn't
+ * check it, so all that matters is that the handshake costs about the same as
+ * it would with a real server.
+ */
+static gnutls_certificate_credentials_t make_credentials() {
+    gnutls_certificate_credentials_t cred;
+    gnutls_x509_privkey_t key;
+    gnutls_x509_crt_t crt;
+    time_t now = time(NULL);
+    unsigned char serial = 1;
+
+    gnutls_x509_privkey_init(&key);
+    gnutls_x509_privkey_generate(key, GNUTLS_PK_RSA, 2048, 0);
+
+    gnutls_x509_crt_init(&crt);
+    gnutls_x509_crt_set_version(crt, 3);
+    gnutls_x509_crt_set_serial(crt, &serial, sizeof(serial));
+    gnutls_x509_crt_set_activation_time(crt, now - 60);
+    gnutls_x509_crt_set_expiration_time(crt, now + 24 * 60 * 60);
+    gnutls_x509_crt_set_dn_by_oid(crt, GNUTLS_OID_X520_COMMON_NAME, 0,
+                                  "localhost", strlen("localhost"));
+    gnutls_x509_crt_set_key(crt, key);
+    gnutls_x509_crt_sign2(crt, crt, key, GNUTLS_DIG_SHA256, 0);
+
+    gnutls_certificate_allocate_credentials(&cred);
+    gnutls_certificate_set_x509_key(cred, &crt, 1, key);
+
+    gnutls_x509_crt_deinit(crt);
+    gnutls_x509_privkey_deinit(key);
+    return cred;
+}
+
+static void write_all(struct sqchat_fake_server * server,
+                      const char * data,
+                      size_t len) {
+    ssize_t written;
+
+    while (len > 0) {
+        if (server->tls)
+            written = gnutls_record_send(server->tls_session, data, len);
+        else
+            written = send(server->socket, data, len, MSG_NOSIGNAL);
+
+        if (written == GNUTLS_E_AGAIN || written == GNUTLS_E_INTERRUPTED ||
+            (written == -1 && errno == EINTR))
+            continue;
+        else if (written < 0) {
+            fprintf(stderr, "fake server: lost the client while writing\n");
+            _exit(1);
+        }
+
+        data += written;
+        len -= written;
+    }
+}
+
+static void flush(struct sqchat_fake_server * server) {
+    write_all(server, server->send_buffer, server->send_buffer_len);
+    server->send_buffer_len = 0;
+}
+
+/* Queues a line to be sent to the client, adding the line ending for us. If
+ * we're sending at a fixed rate, this waits until it's time for the line to go
+ * out.
+ */
+void sqchat_fake_server_send(struct sqchat_fake_server * server,
+                             const char * line, ...) {
+    char msg[SQCHAT_MSG_BUF_LEN];
+    va_list args;
+    int len;
+
+    va_start(args, line);
+    len = vsnprintf(msg, SQCHAT_IRC_MSG_LEN - 1, line, args);
+    va_end(args);
+
+    if (len > SQCHAT_IRC_MSG_LEN - 2)
+        len = SQCHAT_IRC_MSG_LEN - 2;
+    memcpy(&msg[len], "\r\n", 2);
+    len += 2;
+
+    if (server->rate != 0) {
+        double due = server->start_time +
+                     (double)server->lines_sent / server->rate;
+        double now = get_time();
+
+        if (due > now) {
+            struct timespec delay;
+
+            flush(server);
+            delay.tv_sec = (time_t)(due - now);
+            delay.tv_nsec = (long)((due - now - delay.tv_sec) * 1e9);
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    if (server->send_buffer_len + len > SQCHAT_FAKE_SERVER_BUF_LEN)
+        flush(server);
+
+    memcpy(&server->send_buffer[server->send_buffer_len], msg, len);
+    server->send_buffer_len += len;
+    server->lines_sent++;
+}
+
+// Everything the server process does after forking
+static void run_server(struct sqchat_fake_server * server,
+                       sqchat_fake_server_script script,
+                       void * data) {
+    gnutls_certificate_credentials_t cred = NULL;
+    int ret;
+
+    if (server->tls)
+        cred = make_credentials();
+
+    if ((server->socket = accept(server->listen_socket, NULL, NULL)) == -1) {
+        perror("fake server: accept");
+        _exit(1);
+    }
+    close(server->listen_socket);
+
+    if (server->tls) {
+        gnutls_init(&server->tls_session, GNUTLS_SERVER);
+        gnutls_priority_set_direct(server->tls_session, "NORMAL", NULL);
+        gnutls_credentials_set(server->tls_session, GNUTLS_CRD_CERTIFICATE,
+                               cred);
+        gnutls_transport_set_int(server->tls_session, server->socket);
+
+        do {
+            ret = gnutls_handshake(server->tls_session);
+        } while (ret < 0 && !gnutls_error_is_fatal(ret));
+
+        if (ret < 0) {
+            fprintf(stderr, "fake server: handshake failed: %s\n",
+                    gnutls_strerror(ret));
+            _exit(1);
+        }
+    }
+
+    server->start_time = get_time();
+    script(server, data);
+    flush(server);
+
+    if (server->tls) {
+        gnutls_bye(server->tls_session, GNUTLS_SHUT_WR);
+        gnutls_deinit(server->tls_session);
+        gnutls_certificate_free_credentials(cred);
+    }
+    close(server->socket);
+
+    _exit(0);
+}
+
+/* Starts up a server in it's own process, so it doesn't get counted against
+ * the client's memory usage or CPU time. The server accepts one connection,
+ * plays the script to it and then hangs up. Returns 0 on success, or -1 with
+ * errno set if the server couldn't be started.
+ */
+int sqchat_fake_server_start(struct sqchat_fake_server * server,
+                             bool tls,
+                             unsigned long rate,
+                             sqchat_fake_server_script script,
+                             void * data) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    memset(server, 0, sizeof(struct sqchat_fake_server));
+    server->tls = tls;
+    server->rate = rate;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if ((server->listen_socket = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+        return -1;
+
+    if (bind(server->listen_socket, (struct sockaddr*)&addr, addr_len) == -1 ||
+        listen(server->listen_socket, 1) == -1 ||
+        getsockname(server->listen_socket, (struct sockaddr*)&addr,
+                    &addr_len) == -1) {
+        close(server->listen_socket);
+        return -1;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    if ((server->pid = fork()) == -1) {
+        close(server->listen_socket);
+        return -1;
+    }
+    else if (server->pid == 0)
+        run_server(server, script, data);
+
+    close(server->listen_socket);
+    return 0;
+}
+
+// Waits for the server to finish, and returns it's exit status
+int sqchat_fake_server_wait(struct sqchat_fake_server * server) {
+    int status;
+
+    if (waitpid(server->pid, &status, 0) == -1)
+        return -1;
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
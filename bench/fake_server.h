@@ -0,0 +1,69 @@
+/* A stand-in IRC server that runs on the loopback interface and plays back
+ * canned traffic to whoever connects to it
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FAKE_SERVER_H__
+#define __FAKE_SERVER_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <gnutls/gnutls.h>
+
+// How much we let pile up before writing it out to the client
+#define SQCHAT_FAKE_SERVER_BUF_LEN 8192
+
+struct sqchat_fake_server {
+    pid_t pid;
+    unsigned short port;
+
+    // Everything past here is only used by the server process
+    int listen_socket;
+    int socket;
+    bool tls;
+    gnutls_session_t tls_session;
+
+    // Lines per second to send, or 0 to send them as fast as we can
+    unsigned long rate;
+    unsigned long lines_sent;
+    double start_time;
+
+    char send_buffer[SQCHAT_FAKE_SERVER_BUF_LEN];
+    size_t send_buffer_len;
+};
+
+/* Plays back a recording by calling sqchat_fake_server_send() for each line in
+ * it
+ */
+typedef void (*sqchat_fake_server_script)(struct sqchat_fake_server * server,
+                                          void * data);
+
+extern int sqchat_fake_server_start(struct sqchat_fake_server * server,
+                                    bool tls,
+                                    unsigned long rate,
+                                    sqchat_fake_server_script script,
+                                    void * data)
+    _attr_nonnull(1, 4);
+extern int sqchat_fake_server_wait(struct sqchat_fake_server * server)
+    _attr_nonnull(1);
+
+extern void sqchat_fake_server_send(struct sqchat_fake_server * server,
+                                    const char * line, ...)
+    _attr_nonnull(1, 2) _attr_format(printf, 2, 3);
+
+#endif // __FAKE_SERVER_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
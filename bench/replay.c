@@ -0,0 +1,435 @@
+/* Replays recorded IRC traffic from a fake server into a real connection, and
+ * measures how well the receive path keeps up with it
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fake_server.h"
+#include "irc_connection.h"
+#include "irc_message.h"
+#include "net_io_thread.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <gnutls/gnutls.h>
+
+#define REPLAY_USER_COUNT       10000
+#define REPLAY_PRIVMSG_COUNT    200000
+
+/* How often we check on the main loop to see if it's been held up (in
+ * milliseconds). Anything that keeps it busy for longer than this counts as a
+ * stall.
+ */
+#define REPLAY_TICK_MS          5
+
+struct replay_client {
+    struct sqchat_connection connection;
+    GMainLoop * loop;
+
+    unsigned long lines;
+    gint64 first_line;
+    gint64 last_line;
+
+    gint64 last_tick;
+    gint64 stall_total;
+    gint64 stall_max;
+};
+
+struct replay_result {
+    unsigned long lines;
+    double seconds;
+    double stall_total_ms;
+    double stall_max_ms;
+    long peak_rss_kb;
+};
+
+/* The recordings. Each one has the server welcome us and put us in a channel
+ * first, the same way a real server would.
+ */
+static void send_welcome(struct sqchat_fake_server * server) {
+    sqchat_fake_server_send(server, ":irc.example.net 001 me :Welcome to the "
+                            "Example IRC Network me!~me@localhost");
+    sqchat_fake_server_send(server, ":me!~me@localhost JOIN #bench");
+}
+
+// A NAMES reply for a big channel, packed as tight as a real server would
+static void send_names(struct sqchat_fake_server * server, int user_count) {
+    const char * prefix = ":irc.example.net 353 me = #bench :";
+    char line[SQCHAT_MSG_BUF_LEN];
+    size_t len = 0;
+
+    for (int i = 0; i < user_count; i++) {
+        char nick[32];
+        int nick_len = snprintf(nick, sizeof(nick), "%suser%05d",
+                                i % 50 == 0 ? "@" : i % 7 == 0 ? "+" : "", i);
+
+        if (len + nick_len + 1 > SQCHAT_IRC_MSG_LEN - 2 - strlen(prefix)) {
+            sqchat_fake_server_send(server, "%s%s", prefix, line);
+            len = 0;
+        }
+
+        len += sprintf(&line[len], len == 0 ? "%s" : " %s", nick);
+    }
+
+    if (len != 0)
+        sqchat_fake_server_send(server, "%s%s", prefix, line);
+    sqchat_fake_server_send(server, ":irc.example.net 366 me #bench "
+                            ":End of /NAMES list.");
+}
+
+static void names_script(struct sqchat_fake_server * server, void * data) {
+    send_welcome(server);
+    send_names(server, REPLAY_USER_COUNT);
+}
+
+// Half the channel goes away at once when a server splits off the network
+static void netsplit_script(struct sqchat_fake_server * server, void * data) {
+    send_welcome(server);
+    send_names(server, REPLAY_USER_COUNT);
+
+    for (int i = 0; i < REPLAY_USER_COUNT; i += 2)
+        sqchat_fake_server_send(server, ":user%05d!~user%05d@198.51.100.%d "
+                                "QUIT :hub.example.net leaf.example.net",
+                                i, i, i % 256);
+}
+
+static void joins_script(struct sqchat_fake_server * server, void * data) {
+    send_welcome(server);
+
+    for (int i = 0; i < REPLAY_USER_COUNT; i++)
+        sqchat_fake_server_send(server, ":user%05d!~user%05d@198.51.100.%d "
+                                "JOIN #bench", i, i, i % 256);
+}
+
+static void privmsg_script(struct sqchat_fake_server * server, void * data) {
+    send_welcome(server);
+
+    for (int i = 0; i < REPLAY_PRIVMSG_COUNT; i++)
+        sqchat_fake_server_send(server, ":user%05d!~user%05d@198.51.100.%d "
+                                "PRIVMSG #bench :message number %d, with "
+                                "enough text after it to look like a real "
+                                "conversation",
+                                i % 500, i % 500, i % 256, i);
+}
+
+// Plays back traffic captured from a real server, one line at a time
+static void file_script(struct sqchat_fake_server * server,
+                        const char * path) {
+    char line[SQCHAT_MSG_BUF_LEN + 2];
+    FILE * file = fopen(path, "r");
+
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0')
+            sqchat_fake_server_send(server, "%s", line);
+    }
+
+    fclose(file);
+}
+
+static const struct replay_scenario {
+    const char * name;
+    const char * description;
+    sqchat_fake_server_script script;
+} scenarios[] = {
+    { "names",    "NAMES burst for a 10k user channel",  names_script },
+    { "netsplit", "QUIT storm from a netsplit",           netsplit_script },
+    { "joins",    "Join flood of 10k users",              joins_script },
+    { "privmsg",  "High-rate PRIVMSG stream",             privmsg_script },
+    { NULL }
+};
+
+static bool on_message(struct sqchat_connection * connection,
+                       struct sqchat_msg * msg,
+                       void * data) {
+    struct replay_client * client = data;
+    gint64 now = g_get_monotonic_time();
+
+    if (client->lines++ == 0)
+        client->first_line = now;
+    client->last_line = now;
+
+    return true;
+}
+
+static bool on_rehandshake(struct sqchat_connection * connection,
+                           void * data) {
+    sqchat_connection_watch(connection);
+    return true;
+}
+
+static bool on_closed(struct sqchat_connection * connection,
+                      const char * error,
+                      const char * quit_msg,
+                      void * data) {
+    struct replay_client * client = data;
+
+    if (error)
+        fprintf(stderr, "%s", error);
+
+    sqchat_connection_close(connection);
+    g_main_loop_quit(client->loop);
+    return false;
+}
+
+static const struct sqchat_connection_observer replay_observer = {
+    .message     = on_message,
+    .rehandshake = on_rehandshake,
+    .closed      = on_closed
+};
+
+/* Runs every REPLAY_TICK_MS on the main loop. If it shows up late, whatever
+ * was running in the meantime stalled the loop for that long
+ */
+static gboolean stall_tick(struct replay_client * client) {
+    gint64 now = g_get_monotonic_time();
+    gint64 stall = now - client->last_tick - REPLAY_TICK_MS * 1000;
+
+    if (stall > 0) {
+        client->stall_total += stall;
+        if (stall > client->stall_max)
+            client->stall_max = stall;
+    }
+
+    client->last_tick = now;
+    return TRUE;
+}
+
+static int connect_to_server(unsigned short port) {
+    struct sockaddr_in addr;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (sock == -1 ||
+        connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("connect");
+        return -1;
+    }
+    return sock;
+}
+
+static bool start_tls(struct sqchat_connection * connection,
+                      gnutls_certificate_credentials_t cred) {
+    int ret;
+
+    gnutls_init(&connection->ssl_session, GNUTLS_CLIENT);
+    gnutls_priority_set_direct(connection->ssl_session, "NORMAL", NULL);
+    gnutls_credentials_set(connection->ssl_session, GNUTLS_CRD_CERTIFICATE,
+                           cred);
+    gnutls_transport_set_int(connection->ssl_session, connection->socket);
+
+    do {
+        ret = gnutls_handshake(connection->ssl_session);
+    } while (ret < 0 && !gnutls_error_is_fatal(ret));
+
+    if (ret < 0) {
+        fprintf(stderr, "Handshake failed: %s\n", gnutls_strerror(ret));
+        return false;
+    }
+    return true;
+}
+
+static bool run_replay(sqchat_fake_server_script script,
+                       void * script_data,
+                       bool tls,
+                       unsigned long rate,
+                       struct replay_result * result) {
+    struct sqchat_fake_server server;
+    struct replay_client * client = calloc(1, sizeof(struct replay_client));
+    gnutls_certificate_credentials_t cred = NULL;
+    struct rusage usage;
+    guint tick_source;
+    int sock;
+
+    if (sqchat_fake_server_start(&server, tls, rate, script,
+                                 script_data) == -1) {
+        perror("Couldn't start the fake server");
+        free(client);
+        return false;
+    }
+
+    sqchat_connection_init(&client->connection, &replay_observer, client);
+    client->loop = g_main_loop_new(NULL, FALSE);
+
+    if ((sock = connect_to_server(server.port)) == -1)
+        goto error;
+
+    sqchat_connection_open(&client->connection, sock, tls, "ISO-8859-1");
+    if (tls) {
+        gnutls_certificate_allocate_credentials(&cred);
+        if (!start_tls(&client->connection, cred)) {
+            sqchat_connection_close(&client->connection);
+            goto error;
+        }
+    }
+
+    client->last_tick = g_get_monotonic_time();
+    tick_source = g_timeout_add(REPLAY_TICK_MS, (GSourceFunc)stall_tick,
+                                client);
+
+    sqchat_connection_watch(&client->connection);
+    g_main_loop_run(client->loop);
+    g_source_remove(tick_source);
+
+    getrusage(RUSAGE_SELF, &usage);
+    result->lines = client->lines;
+    result->seconds = (client->last_line - client->first_line) / 1e6;
+    result->stall_total_ms = client->stall_total / 1e3;
+    result->stall_max_ms = client->stall_max / 1e3;
+    result->peak_rss_kb = usage.ru_maxrss;
+
+    sqchat_fake_server_wait(&server);
+    if (cred)
+        gnutls_certificate_free_credentials(cred);
+
+    g_main_loop_unref(client->loop);
+    sqchat_connection_cleanup(&client->connection);
+    sqchat_net_io_free(client, free);
+    return true;
+
+error:
+    kill(server.pid, SIGTERM);
+    sqchat_fake_server_wait(&server);
+    g_main_loop_unref(client->loop);
+    sqchat_connection_cleanup(&client->connection);
+    free(client);
+    return false;
+}
+
+static void print_usage(const char * name) {
+    fprintf(stderr,
+            "Usage: %s [options] [scenario...]\n"
+            "  -f FILE  Replay the lines in FILE instead of a scenario\n"
+            "  -r RATE  Lines per second to send (default: unlimited)\n"
+            "  -t       Connect with TLS\n"
+            "  -j       Print the results as JSON\n"
+            "  -l       List the scenarios and exit\n"
+            "Peak RSS is for the whole run, so run scenarios one at a time to "
+            "compare them.\n",
+            name);
+}
+
+static void print_result(const char * name,
+                         struct replay_result * result,
+                         bool json,
+                         bool first) {
+    double lines_per_sec = result->seconds > 0 ?
+                           result->lines / result->seconds : 0;
+
+    if (json)
+        printf("%s\n  {\"name\": \"%s\", \"lines\": %lu, \"seconds\": %.4f, "
+               "\"lines_per_sec\": %.0f, \"stall_total_ms\": %.3f, "
+               "\"stall_max_ms\": %.3f, \"peak_rss_kb\": %ld}",
+               first ? "" : ",", name, result->lines, result->seconds,
+               lines_per_sec, result->stall_total_ms, result->stall_max_ms,
+               result->peak_rss_kb);
+    else
+        printf("%-12s %10lu %12.0f %12.3f %12.3f %12ld\n", name,
+               result->lines, lines_per_sec, result->stall_total_ms,
+               result->stall_max_ms, result->peak_rss_kb);
+}
+
+int main(int argc, char * argv[]) {
+    const char * file = NULL;
+    unsigned long rate = 0;
+    bool tls = false;
+    bool json = false;
+    bool first = true;
+    bool ok = true;
+    int arg;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc)
+            file = argv[++arg];
+        else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc)
+            rate = strtoul(argv[++arg], NULL, 10);
+        else if (strcmp(argv[arg], "-t") == 0)
+            tls = true;
+        else if (strcmp(argv[arg], "-j") == 0)
+            json = true;
+        else if (strcmp(argv[arg], "-l") == 0) {
+            for (const struct replay_scenario * s = scenarios; s->name; s++)
+                printf("%-12s %s\n", s->name, s->description);
+            return 0;
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    gnutls_global_init();
+    sqchat_net_io_thread_init();
+
+    if (json)
+        printf("{\"tls\": %s, \"rate\": %lu, \"results\": [",
+               tls ? "true" : "false", rate);
+    else
+        printf("%-12s %10s %12s %12s %12s %12s\n", "scenario", "lines",
+               "lines/sec", "stall ms", "max stall ms", "peak RSS KB");
+
+    if (file != NULL) {
+        struct replay_result result;
+
+        if ((ok = run_replay((sqchat_fake_server_script)file_script,
+                             (void*)file, tls, rate, &result)))
+            print_result(file, &result, json, first);
+    }
+    else {
+        for (const struct replay_scenario * s = scenarios; s->name; s++) {
+            struct replay_result result;
+            bool selected = arg == argc;
+
+            for (int i = arg; i < argc && !selected; i++)
+                selected = strcmp(argv[i], s->name) == 0;
+            if (!selected)
+                continue;
+
+            if (!run_replay(s->script, NULL, tls, rate, &result)) {
+                ok = false;
+                continue;
+            }
+
+            print_result(s->name, &result, json, first);
+            first = false;
+        }
+    }
+
+    if (json)
+        printf("\n]}\n");
+
+    return ok ? 0 : 1;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
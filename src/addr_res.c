@@ -0,0 +1,248 @@
+/* A small in-process cache for hostname lookups
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "addr_res.h"
+#include "trie.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+struct addr_res_entry {
+    struct addrinfo * results;
+    int error;
+    gint64 expires;
+    gint64 prefetch_time;
+    bool refreshing;
+};
+
+struct addr_res_refresh_params {
+    char * address;
+    char * port;
+};
+
+static sqchat_trie * addr_res_cache;
+static GMutex addr_res_mutex;
+static struct sqchat_addr_res_stats addr_res_stats;
+
+static void store_result(const char * key, int error, struct addrinfo * results);
+
+void sqchat_addr_res_init() {
+    g_mutex_init(&addr_res_mutex);
+    addr_res_cache = sqchat_trie_new(sqchat_trie_strtolower);
+}
+
+/* Makes a copy of a list of results from getaddrinfo(). Each node gets it's
+ * socket address tacked onto the end of the same allocation, so the copy can be
+ * freed with sqchat_addr_res_free()
+ */
+static struct addrinfo * copy_results(const struct addrinfo * src) {
+    struct addrinfo * head = NULL;
+    struct addrinfo ** tail = &head;
+
+    for (; src != NULL; src = src->ai_next) {
+        struct addrinfo * copy = malloc(sizeof(struct addrinfo) +
+                                        src->ai_addrlen);
+        memcpy(copy, src, sizeof(struct addrinfo));
+        copy->ai_addr = (struct sockaddr*)(copy + 1);
+        memcpy(copy->ai_addr, src->ai_addr, src->ai_addrlen);
+        copy->ai_canonname = NULL;
+        copy->ai_next = NULL;
+
+        *tail = copy;
+        tail = &copy->ai_next;
+    }
+
+    return head;
+}
+
+void sqchat_addr_res_free(struct addrinfo * results) {
+    struct addrinfo * next;
+    for (; results != NULL; results = next) {
+        next = results->ai_next;
+        free(results);
+    }
+}
+
+static void free_entry(struct addr_res_entry * entry) {
+    sqchat_addr_res_free(entry->results);
+    free(entry);
+}
+
+static inline char * make_key(const char * address, const char * port) {
+    return g_strconcat(address, "/", port, NULL);
+}
+
+static int resolve(const char * address,
+                   const char * port,
+                   struct addrinfo ** results) {
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    return getaddrinfo(address, port, &hints, results);
+}
+
+/* Refreshes an entry in the cache before it expires. If the lookup fails we
+ * just leave the old results alone until they expire on their own
+ */
+static void refresh_thread(struct addr_res_refresh_params * params) {
+    struct addrinfo * results;
+    char * key = make_key(params->address, params->port);
+    int error = resolve(params->address, params->port, &results);
+
+    if (error == 0) {
+        store_result(key, 0, results);
+        freeaddrinfo(results);
+    }
+    else {
+        struct addr_res_entry * entry;
+
+        g_mutex_lock(&addr_res_mutex);
+        if ((entry = sqchat_trie_get(addr_res_cache, key)) != NULL)
+            entry->refreshing = false;
+        g_mutex_unlock(&addr_res_mutex);
+    }
+
+    g_free(key);
+    g_free(params->address);
+    g_free(params->port);
+    free(params);
+}
+
+/* Adds the results of a lookup to the cache, replacing whatever was there
+ * before. Errors that are likely to go away on their own are not cached.
+ */
+static void store_result(const char * key,
+                         int error,
+                         struct addrinfo * results) {
+    struct addr_res_entry * entry;
+    gint64 now = g_get_monotonic_time();
+    gint64 ttl;
+
+    if (error == EAI_AGAIN || error == EAI_SYSTEM || error == EAI_MEMORY)
+        return;
+
+    ttl = (error == 0 ? SQCHAT_ADDR_RES_TTL : SQCHAT_ADDR_RES_NEGATIVE_TTL) *
+          G_USEC_PER_SEC;
+
+    g_mutex_lock(&addr_res_mutex);
+
+    if ((entry = sqchat_trie_get(addr_res_cache, key)) == NULL) {
+        entry = malloc(sizeof(struct addr_res_entry));
+        sqchat_trie_set(addr_res_cache, key, entry);
+        addr_res_stats.entries++;
+    }
+    else
+        sqchat_addr_res_free(entry->results);
+
+    entry->error = error;
+    entry->results = error == 0 ? copy_results(results) : NULL;
+    entry->expires = now + ttl;
+    entry->prefetch_time = now + ttl * SQCHAT_ADDR_RES_PREFETCH_AT / 100;
+    entry->refreshing = false;
+
+    g_mutex_unlock(&addr_res_mutex);
+}
+
+/* Looks up the address and port given, checking the cache first. Works just
+ * like getaddrinfo(), except the results must be freed with
+ * sqchat_addr_res_free(). This may block, so don't call it from the main
+ * thread.
+ */
+int sqchat_addr_res_lookup(const char * address,
+                           const char * port,
+                           struct addrinfo ** results) {
+    struct addr_res_entry * entry;
+    struct addrinfo * lookup_results;
+    char * key = make_key(address, port);
+    gint64 now = g_get_monotonic_time();
+    int error;
+
+    g_mutex_lock(&addr_res_mutex);
+    if ((entry = sqchat_trie_get(addr_res_cache, key)) != NULL &&
+        now < entry->expires) {
+        error = entry->error;
+        if (error == 0) {
+            addr_res_stats.hits++;
+            *results = copy_results(entry->results);
+
+            // Start refreshing the entry if it's close to expiring
+            if (now >= entry->prefetch_time && !entry->refreshing) {
+                struct addr_res_refresh_params * params =
+                    malloc(sizeof(struct addr_res_refresh_params));
+
+                params->address = g_strdup(address);
+                params->port = g_strdup(port);
+                entry->refreshing = true;
+                addr_res_stats.prefetches++;
+
+                g_thread_unref(g_thread_new("Address Prefetch",
+                                            (GThreadFunc)&refresh_thread,
+                                            params));
+            }
+        }
+        else {
+            addr_res_stats.negative_hits++;
+            *results = NULL;
+        }
+
+        g_mutex_unlock(&addr_res_mutex);
+        g_free(key);
+        return error;
+    }
+
+    if (entry != NULL)
+        addr_res_stats.expired++;
+    addr_res_stats.misses++;
+    g_mutex_unlock(&addr_res_mutex);
+
+    error = resolve(address, port, &lookup_results);
+    store_result(key, error, lookup_results);
+
+    if (error == 0) {
+        *results = copy_results(lookup_results);
+        freeaddrinfo(lookup_results);
+    }
+    else
+        *results = NULL;
+
+    g_free(key);
+    return error;
+}
+
+void sqchat_addr_res_get_stats(struct sqchat_addr_res_stats * stats) {
+    g_mutex_lock(&addr_res_mutex);
+    memcpy(stats, &addr_res_stats, sizeof(struct sqchat_addr_res_stats));
+    g_mutex_unlock(&addr_res_mutex);
+}
+
+// Throws away everything in the cache
+void sqchat_addr_res_flush() {
+    g_mutex_lock(&addr_res_mutex);
+    sqchat_trie_free(addr_res_cache, free_entry, NULL);
+    addr_res_cache = sqchat_trie_new(sqchat_trie_strtolower);
+    addr_res_stats.entries = 0;
+    g_mutex_unlock(&addr_res_mutex);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -1,4 +1,7 @@
-/*
+/* A small in-process cache for hostname lookups, so that reconnecting to a
+ * network (or moving on to the next server in the list) doesn't have to wait on
+ * the system resolver every single time
+ *
  * Copyright (C) 2013 Stephen Chandler Paul
  *
  * This file is free software: you may copy it, redistribute it and/or modify it
@@ -14,11 +17,43 @@
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef __CONNECTION_SETUP_H__
-#define __CONNECTION_SETUP_H__
+#ifndef __ADDR_RES_H__
+#define __ADDR_RES_H__
+
+#include <netdb.h>
+#include <stdbool.h>
+
+/* getaddrinfo() doesn't tell us the TTL of the records it hands back, so we
+ * just use fixed lifetimes for everything (in seconds)
+ */
+#define SQCHAT_ADDR_RES_TTL             300
+#define SQCHAT_ADDR_RES_NEGATIVE_TTL    30
+
+/* Once an entry is this far into it's lifetime (in percent), the next lookup
+ * that hits it will start refreshing it in the background
+ */
+#define SQCHAT_ADDR_RES_PREFETCH_AT     80
+
+struct sqchat_addr_res_stats {
+    unsigned long hits;
+    unsigned long negative_hits;
+    unsigned long misses;
+    unsigned long expired;
+    unsigned long prefetches;
+    unsigned long entries;
+};
+
+extern void sqchat_addr_res_init();
+
+extern int sqchat_addr_res_lookup(const char * address,
+                                  const char * port,
+                                  struct addrinfo ** results)
+    _attr_nonnull(1, 2, 3);
+extern void sqchat_addr_res_free(struct addrinfo * results);
 
-extern void sqchat_begin_connection_attempt(struct sqchat_network * network)
+extern void sqchat_addr_res_get_stats(struct sqchat_addr_res_stats * stats)
     _attr_nonnull(1);
+extern void sqchat_addr_res_flush();
 
-#endif __CONNECTION_SETUP_H__
+#endif // __ADDR_RES_H__
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -29,6 +29,16 @@
 #include "irc_numerics.h"
 #include "cmd_responses.h"
 #include "ctcp.h"
+#include "addr_res.h"
+#include "stats.h"
+#include "trace.h"
+#include "log_writer.h"
+#include "log_search.h"
+#include "log_segment.h"
+
+#ifdef WITH_SSL
+#include "ssl.h"
+#endif
 
 #define DEFAULT_AWAY_MSG "I am not here right now."
 
@@ -69,6 +79,14 @@ void sqchat_add_builtin_commands() {
                              "the server, which may be retreived with "
                              "\"/server list\".\n"
                              "\n"
+                             "PROBE [on|off]:\n"
+                             "With no arguments, tries connecting to several "
+                             "servers in the list at once and connects to the "
+                             "one that responds the fastest. 'on' makes "
+                             "SquirrelChat do this automatically every time it "
+                             "connects to this network, and 'off' goes back to "
+                             "trying each server in order.\n"
+                             "\n"
                              "PASSWORD <password>\n"
                              "Sets the password to be used for connecting to "
                              "each server.\n"));
@@ -255,6 +273,42 @@ void sqchat_add_builtin_commands() {
                            "will not affect the current connection. Some "
                            "servers do however, have a command to change your "
                            "real name without having to reconnect.\n");
+    sqchat_add_irc_command("dnscache", sqchat_cmd_dnscache, 1,
+                           "/dnscache [stats|flush]",
+                           "Shows how well the cache for server address "
+                           "lookups is doing, or throws away everything in it "
+                           "if flush is specified.\n");
+    sqchat_add_irc_command("stats", sqchat_cmd_stats, 2,
+                           "/stats [dump <file>]",
+                           "Shows how much traffic the current network has "
+                           "seen, and how long the client is taking to parse, "
+                           "handle and print messages. If dump is specified, "
+                           "the stats are written to the file given instead. "
+                           "To query the server's own stats, use /quote "
+                           "STATS.\n");
+    sqchat_add_irc_command("profile", sqchat_cmd_profile, 2,
+                           "/profile start <file> | stop | slow <milliseconds>",
+                           "Records how long every message handler takes to "
+                           "run into a file, in the trace event format used by "
+                           "chrome://tracing. While recording, any handler "
+                           "that takes longer than the slow threshold is also "
+                           "pointed out in the network's buffer.\n");
+    sqchat_add_irc_command("search", sqchat_cmd_search, 0,
+                           "/search [-all] [-days <days>] <words>",
+                           "Searches the logs for this buffer for messages "
+                           "containing all of the given words, or the logs "
+                           "for the whole network if used in the network's "
+                           "buffer. If -all is specified, the logs for every "
+                           "network are searched instead. If -days is "
+                           "specified, only messages from the last number of "
+                           "days given are searched.\n");
+#ifdef WITH_SSL
+    sqchat_add_irc_command("certificate", sqchat_cmd_certificate, 0,
+                           "/certificate",
+                           "Shows the certificate the server for the current "
+                           "network presented the last time you connected to "
+                           "it over SSL.\n");
+#endif
 }
 
 #define BI_CMD(func_name)                           \
@@ -286,6 +340,7 @@ BI_CMD(sqchat_cmd_nick) {
     else {
         free(buffer->network->nickname);
         buffer->network->nickname = strdup(argv[0]);
+        sqchat_highlighter_set_nickname(buffer->network->highlighter, argv[0]);
         sqchat_buffer_print(buffer, "* You are now known as %s.\n", argv[0]);
     }
     return 0;
@@ -317,6 +372,15 @@ BI_CMD(sqchat_cmd_server) {
                                 server->address,
                                 server->port,
                                 server->ssl ? "Yes" : "No");
+            if (g_atomic_int_get(&server->rtt_samples) != 0)
+                sqchat_buffer_print(buffer,
+                                    "\tLatency:\t%.1f ms (average %.1f ms "
+                                    "over %i connections)\n",
+                                    g_atomic_int_get(&server->rtt_last) /
+                                        1000.0,
+                                    g_atomic_int_get(&server->rtt_avg) /
+                                        1000.0,
+                                    g_atomic_int_get(&server->rtt_samples));
         }
         sqchat_buffer_print(buffer, "--- End of Server List ---\n");
     }
@@ -380,6 +444,38 @@ BI_CMD(sqchat_cmd_server) {
                             "Server to use for connection is now set to %s\n",
                             argv[1]);
     }
+    else if (strcasecmp(argv[0], "probe") == 0) {
+        if (argc < 2) {
+            if (buffer->network->status != DISCONNECTED) {
+                sqchat_buffer_print(buffer,
+                                    "Error: Can't probe servers while "
+                                    "connected\n");
+                return 0;
+            }
+            else if (buffer->network->servers == NULL) {
+                sqchat_buffer_print(buffer,
+                                    "No servers have been set for this "
+                                    "buffer.\n");
+                return 0;
+            }
+
+            g_atomic_int_set(&buffer->network->probe_pending, TRUE);
+            sqchat_network_connect(buffer->network);
+        }
+        else if (strcasecmp(argv[1], "on") == 0) {
+            buffer->network->probe_servers = true;
+            sqchat_buffer_print(buffer,
+                                "Servers will be probed when connecting\n");
+        }
+        else if (strcasecmp(argv[1], "off") == 0) {
+            buffer->network->probe_servers = false;
+            sqchat_buffer_print(buffer,
+                                "Servers will be tried in order when "
+                                "connecting\n");
+        }
+        else
+            return SQCHAT_CMD_SYNTAX_ERR;
+    }
     else if (strcasecmp(argv[0], "password") == 0) {
         if (argc < 2)
             return SQCHAT_CMD_SYNTAX_ERR;
@@ -925,4 +1021,177 @@ BI_CMD(sqchat_cmd_realname) {
     return 0;
 }
 
+BI_CMD(sqchat_cmd_dnscache) {
+    if (argc == 0 || strcasecmp(argv[0], "stats") == 0) {
+        struct sqchat_addr_res_stats stats;
+        unsigned long lookups;
+
+        sqchat_addr_res_get_stats(&stats);
+        lookups = stats.hits + stats.negative_hits + stats.misses;
+
+        sqchat_buffer_print(buffer,
+                            "--- Address Cache Stats ---\n"
+                            "\tEntries:\t%lu\n"
+                            "\tHits:\t%lu\n"
+                            "\tNegative hits:\t%lu\n"
+                            "\tMisses:\t%lu (%lu expired)\n"
+                            "\tPrefetches:\t%lu\n"
+                            "\tHit ratio:\t%.1f%%\n"
+                            "--- End of Address Cache Stats ---\n",
+                            stats.entries, stats.hits, stats.negative_hits,
+                            stats.misses, stats.expired, stats.prefetches,
+                            lookups ? (stats.hits + stats.negative_hits) *
+                                      100.0 / lookups : 0.0);
+    }
+    else if (strcasecmp(argv[0], "flush") == 0) {
+        sqchat_addr_res_flush();
+        sqchat_buffer_print(buffer, "Address cache flushed\n");
+    }
+    else
+        return SQCHAT_CMD_SYNTAX_ERR;
+
+    return 0;
+}
+
+BI_CMD(sqchat_cmd_stats) {
+    GString * output;
+    GError * error = NULL;
+
+    if (argc > 0 && (strcasecmp(argv[0], "dump") != 0 || argc < 2))
+        return SQCHAT_CMD_SYNTAX_ERR;
+
+    output = g_string_new(NULL);
+    if (buffer->network) {
+        g_string_append(output, "--- Network Stats ---\n");
+        sqchat_connection_stats_format(output,
+                                       &buffer->network->connection.stats);
+        g_string_append(output, "--- End of Network Stats ---\n");
+    }
+    sqchat_stats_format(output);
+
+    if (argc == 0)
+        sqchat_buffer_print(buffer, "%s", output->str);
+    else if (g_file_set_contents(argv[1], output->str, output->len, &error))
+        sqchat_buffer_print(buffer, "Stats written to %s\n", argv[1]);
+    else {
+        sqchat_buffer_print(buffer, "Couldn't write stats: %s\n",
+                            error->message);
+        g_error_free(error);
+    }
+
+    g_string_free(output, TRUE);
+    return 0;
+}
+
+BI_CMD(sqchat_cmd_profile) {
+    GError * error = NULL;
+
+    if (argc == 0)
+        return SQCHAT_CMD_SYNTAX_ERR;
+    else if (strcasecmp(argv[0], "start") == 0 && argc == 2) {
+        if (sqchat_trace_start(argv[1], &error))
+            sqchat_buffer_print(buffer, "Recording a trace to %s\n", argv[1]);
+        else {
+            sqchat_buffer_print(buffer, "Couldn't start recording: %s\n",
+                                error->message);
+            g_error_free(error);
+        }
+    }
+    else if (strcasecmp(argv[0], "stop") == 0) {
+        if (!sqchat_trace_enabled())
+            sqchat_buffer_print(buffer, "Not recording a trace.\n");
+        else {
+            sqchat_trace_stop();
+            sqchat_buffer_print(buffer, "Trace finished.\n");
+        }
+    }
+    else if (strcasecmp(argv[0], "slow") == 0 && argc == 2) {
+        sqchat_trace_slow_threshold = strtoll(argv[1], NULL, 10) * 1000000;
+        sqchat_buffer_print(buffer,
+                            "Handlers slower than %sms will be pointed out.\n",
+                            argv[1]);
+    }
+    else
+        return SQCHAT_CMD_SYNTAX_ERR;
+
+    return 0;
+}
+
+static void print_search_results(const char * output,
+                                 struct sqchat_buffer * buffer) {
+    sqchat_buffer_print_unlogged(buffer, "%s", output);
+}
+
+BI_CMD(sqchat_cmd_search) {
+    bool everywhere = false;
+    gint64 since = 0;
+    char * path;
+    const char * pos;
+    size_t len;
+
+    // Options come before the words to search for
+    while (trailing != NULL && trailing[0] == '-') {
+        char * option = strtok_r(trailing, " ", &trailing);
+
+        if (strcasecmp(option, "-all") == 0)
+            everywhere = true;
+        else if (strcasecmp(option, "-days") == 0) {
+            char * days_str = strtok_r(trailing, " ", &trailing);
+            long days = days_str ? strtol(days_str, NULL, 10) : 0;
+
+            if (days <= 0)
+                return SQCHAT_CMD_SYNTAX_ERR;
+            since = g_get_real_time() - days * 24 * 60 * 60 * G_USEC_PER_SEC;
+        }
+        else
+            return SQCHAT_CMD_SYNTAX_ERR;
+    }
+
+    // The search won't start without at least one word to look for
+    if (trailing == NULL)
+        return SQCHAT_CMD_SYNTAX_ERR;
+    pos = trailing;
+    if (sqchat_log_next_word(&pos, trailing + strlen(trailing), &len) == NULL)
+        return SQCHAT_CMD_SYNTAX_ERR;
+
+    if (everywhere)
+        path = sqchat_log_path(NULL, NULL);
+    else {
+        const char * network_name = sqchat_network_log_name(buffer->network);
+
+        path = sqchat_log_path(network_name ? network_name : "unknown",
+                               buffer->buffer_name);
+    }
+
+    if (path == NULL) {
+        sqchat_buffer_print(buffer,
+                            "Logging is turned off, so there aren't any logs "
+                            "to search.\n");
+        return 0;
+    }
+
+    if (buffer->search)
+        sqchat_log_search_cancel(buffer->search);
+
+    /* The results get printed from the search's worker threads as soon as
+     * they're found, so this has to go first
+     */
+    sqchat_buffer_print_unlogged(buffer, "* Searching the logs for \"%s\"...\n",
+                                 trailing);
+
+    buffer->search = sqchat_log_search_start(path, since, trailing,
+                                             (sqchat_log_search_output)
+                                             print_search_results,
+                                             buffer);
+    g_free(path);
+    return 0;
+}
+
+#ifdef WITH_SSL
+BI_CMD(sqchat_cmd_certificate) {
+    sqchat_ssl_print_peer_certificate(buffer, buffer->network);
+    return 0;
+}
+#endif
+
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
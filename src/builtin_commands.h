@@ -61,6 +61,13 @@ BI_CMD(sqchat_cmd_wallops);
 BI_CMD(sqchat_cmd_trace);
 BI_CMD(sqchat_cmd_username);
 BI_CMD(sqchat_cmd_realname);
+BI_CMD(sqchat_cmd_dnscache);
+BI_CMD(sqchat_cmd_stats);
+BI_CMD(sqchat_cmd_profile);
+BI_CMD(sqchat_cmd_search);
+#ifdef WITH_SSL
+BI_CMD(sqchat_cmd_certificate);
+#endif
 
 #undef BI_CMD
 
@@ -19,6 +19,7 @@
 #include "builtin_ctcp_requests.h"
 #include "ui/buffer.h"
 #include "ui/network_tree.h"
+#include "nick_color.h"
 
 #define CTCP_REQ_HANDLER(func_name)                     \
     void func_name(struct sqchat_network * network,     \
@@ -51,7 +52,8 @@ CTCP_REQ_HANDLER(sqchat_ctcp_action_req_handler) {
             return;
         }
 
-        sqchat_buffer_print(output, "* %s %s\n", nickname, msg);
+        sqchat_buffer_print(output, "* %s%s\x03 %s\n",
+                            sqchat_nick_color_code(nickname), nickname, msg);
     }
     else {
         // Check if we have a query open with this user, if not open a new one
@@ -59,8 +61,14 @@ CTCP_REQ_HANDLER(sqchat_ctcp_action_req_handler) {
             output = sqchat_buffer_new(target, QUERY, network);
             sqchat_network_tree_buffer_add(output, network);
         }
-        sqchat_buffer_print(output, "* %s %s\n", nickname, msg);
+        sqchat_buffer_print(output, "* %s%s\x03 %s\n",
+                            sqchat_nick_color_code(nickname), nickname, msg);
     }
+
+    if (sqchat_highlighter_match(network->highlighter, msg))
+        sqchat_chat_window_highlight(network->window, output);
+    else
+        sqchat_network_tree_buffer_activity(output, SQCHAT_ACTIVITY_MESSAGE);
 }
 
 CTCP_REQ_HANDLER(sqchat_ctcp_ping_req_handler) {
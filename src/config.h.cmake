@@ -19,5 +19,6 @@
 #cmakedefine WITH_SSL
 #cmakedefine GNUTLS_DEBUG_LEVEL @GNUTLS_DEBUG_LEVEL@
 #cmakedefine CAFILE_PATH "@CAFILE_PATH@"
+#cmakedefine USE_SYSTEM_TRUST
 
 #endif // CONFIG_H
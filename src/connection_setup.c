@@ -19,6 +19,9 @@
 #include "ui/buffer.h"
 #include "net_input_handler.h"
 #include "net_io.h"
+#include "addr_res.h"
+#include "server_probe.h"
+#include "settings.h"
 
 #ifdef WITH_SSL
 #include "ssl.h"
@@ -26,6 +29,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -48,19 +52,34 @@ void sqchat_begin_connection_attempt(struct sqchat_network * network) {
 }
 
 static void connection_setup_thread(struct sqchat_network * network) {
-    struct addrinfo hints;
     struct addrinfo * results;
     struct addrinfo * rp;
     int func_result;
-    sqchat_server * server = network->current_server->data;
-    
-    // Try to get the addrinfo for the server
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
+    int sock = -1;
+    gint64 connect_start;
+    sqchat_server * server;
+
+    if (g_atomic_int_compare_and_exchange(&network->probe_pending, TRUE,
+                                          FALSE)) {
+        if ((sock = sqchat_server_probe(network)) != -1) {
+            server = network->current_server->data;
+            sqchat_buffer_print(network->buffer,
+                                _("Connected to %s:%s\n"),
+                                server->address, server->port);
+            network->connection.socket = sock;
+            g_idle_add((GSourceFunc) connection_final_setup_phase, network);
+            return;
+        }
+
+        sqchat_buffer_print(network->buffer,
+                            _("Falling back to the server list...\n"));
+    }
+
+    server = network->current_server->data;
 
-    func_result = getaddrinfo(server->address, server->port, &hints,
-                              &results);
+    // Try to get the addrinfo for the server
+    func_result = sqchat_addr_res_lookup(server->address, server->port,
+                                         &results);
     if (func_result != 0) {
         sqchat_buffer_print(network->buffer,
                             _("Failed to look up \"%s\": %s\n"),
@@ -78,32 +97,34 @@ static void connection_setup_thread(struct sqchat_network * network) {
      * it's simpler just to run it from this thread
      */
     for (rp = results; rp != NULL; rp = rp->ai_next) {
-        network->socket = socket(rp->ai_family, rp->ai_socktype,
-                                 rp->ai_protocol);
-        
-        if (network->socket == -1)
+        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+
+        if (sock == -1)
             continue;
 
-        if (connect(network->socket, rp->ai_addr, rp->ai_addrlen) != -1)
+        connect_start = g_get_monotonic_time();
+        if (connect(sock, rp->ai_addr, rp->ai_addrlen) != -1)
             break; // Success
 
-        close(network->socket);
+        close(sock);
     }
 
-    freeaddrinfo(results);
-    
+    sqchat_addr_res_free(results);
+
     if (rp == NULL) {
         sqchat_buffer_print(network->buffer, _("Connection failed!\n"));
         try_next_server_in_list(network);
         return;
     }
 
+    sqchat_server_record_rtt(server, g_get_monotonic_time() - connect_start);
     sqchat_buffer_print(network->buffer, _("Connection successful!\n"));
 
     /* We've completed the basic connection portion, now for simplicity sake we
      * pass the rest of the work for setting up the connection back to the main
      * thread
      */
+    network->connection.socket = sock;
     g_idle_add((GSourceFunc) connection_final_setup_phase, network);
 }
 
@@ -126,6 +147,9 @@ void try_next_server_in_list(struct sqchat_network * network) {
 static gboolean connection_final_setup_phase(struct sqchat_network * network) {
     sqchat_server * server = network->current_server->data;
 
+    sqchat_connection_open(&network->connection, network->connection.socket,
+                           server->ssl, sqchat_fallback_encoding);
+
 #ifdef WITH_SSL
     if (server->ssl)
         sqchat_begin_ssl_handshake(network);
@@ -133,12 +157,7 @@ static gboolean connection_final_setup_phase(struct sqchat_network * network) {
 #endif
         sqchat_begin_registration(network);
 
-    network->input_channel = g_io_channel_unix_new(network->socket);
-    g_io_channel_set_encoding(network->input_channel, NULL, NULL);
-    g_io_channel_set_buffered(network->input_channel, FALSE);
-
-    g_io_add_watch_full(network->input_channel, G_PRIORITY_DEFAULT, G_IO_IN,
-                        (GIOFunc)sqchat_net_input_handler, network, NULL);
+    sqchat_net_input_start(network);
     return false;
 }
 
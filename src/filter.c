@@ -0,0 +1,192 @@
+/* Decides which messages shouldn't be shown at all, either because they're
+ * from someone being ignored, match one of the user's filters, or are a kind
+ * of message the user doesn't want to see in big channels
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * const event_names[] = {
+    [SQCHAT_FILTER_JOIN] = "join",
+    [SQCHAT_FILTER_PART] = "part",
+    [SQCHAT_FILTER_QUIT] = "quit",
+    [SQCHAT_FILTER_NICK] = "nick"
+};
+
+/* Turns a hostmask with wildcards into a regex. A mask that's just a nickname
+ * matches that nickname from anywhere.
+ */
+static void append_mask(GString * regex, const char * mask) {
+    for (const char * c = mask; *c != '\0'; c++) {
+        if (*c == '*')
+            g_string_append(regex, ".*");
+        else if (*c == '?')
+            g_string_append_c(regex, '.');
+        else {
+            char * escaped = g_regex_escape_string(c, 1);
+
+            g_string_append(regex, escaped);
+            g_free(escaped);
+        }
+    }
+
+    if (strpbrk(mask, "!@") == NULL)
+        g_string_append(regex, "!.*");
+}
+
+/* Each pattern gets compiled on it's own first so a broken one can be left out
+ * instead of breaking all of the others
+ */
+static GRegex * compile_pattern(const char * pattern) {
+    GError * error = NULL;
+    GRegex * regex = g_regex_new(pattern, 0, 0, &error);
+
+    if (regex == NULL) {
+        g_warning("Ignoring invalid filter \"%s\": %s", pattern,
+                  error->message);
+        g_error_free(error);
+    }
+
+    return regex;
+}
+
+/* Joins the rules into one big alternation. G_REGEX_OPTIMIZE gets GLib to JIT
+ * compile it, which is worth it since it gets run on every message.
+ */
+static GRegex * compile_rules(GString * alternation,
+                              GRegexCompileFlags flags) {
+    GError * error = NULL;
+    GRegex * regex;
+
+    if (alternation->len == 0)
+        return NULL;
+
+    regex = g_regex_new(alternation->str, flags | G_REGEX_OPTIMIZE, 0, &error);
+    if (regex == NULL) {
+        g_warning("Couldn't compile filters: %s", error->message);
+        g_error_free(error);
+    }
+
+    return regex;
+}
+
+struct sqchat_filter * sqchat_filter_new(const char * const * masks,
+                                         const char * const * patterns,
+                                         const char * const * hidden_events,
+                                         unsigned int large_channel_size) {
+    struct sqchat_filter * filter = calloc(1, sizeof(struct sqchat_filter));
+    GString * alternation = g_string_new(NULL);
+    GPtrArray * joined = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)g_regex_unref);
+
+    for (; masks && *masks; masks++) {
+        if (**masks == '\0')
+            continue;
+
+        g_string_append(alternation, alternation->len ? "|(?:" : "(?:");
+        append_mask(alternation, *masks);
+        g_string_append_c(alternation, ')');
+    }
+    // Masks have to match the whole hostmask
+    if (alternation->len) {
+        g_string_prepend(alternation, "^(?:");
+        g_string_append(alternation, ")$");
+    }
+    filter->masks = compile_rules(alternation, G_REGEX_CASELESS);
+
+    g_string_truncate(alternation, 0);
+    filter->separate_text = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)g_regex_unref);
+    for (; patterns && *patterns; patterns++) {
+        GRegex * regex;
+
+        if (**patterns == '\0' || (regex = compile_pattern(*patterns)) == NULL)
+            continue;
+
+        /* Backreferences count groups from the start of the whole regex, so
+         * they'd point at the wrong group once the patterns are joined
+         */
+        if (g_regex_get_max_backref(regex) > 0) {
+            g_ptr_array_add(filter->separate_text, regex);
+            continue;
+        }
+        g_ptr_array_add(joined, regex);
+
+        g_string_append(alternation, alternation->len ? "|(?:" : "(?:");
+        g_string_append(alternation, *patterns);
+        g_string_append_c(alternation, ')');
+    }
+
+    /* Patterns are allowed to use the same group names as each other. If the
+     * joined regex still won't compile, every pattern just gets checked on
+     * it's own instead of losing all of them.
+     */
+    filter->text = compile_rules(alternation, G_REGEX_DUPNAMES);
+    if (filter->text == NULL) {
+        for (guint i = 0; i < joined->len; i++)
+            g_ptr_array_add(filter->separate_text,
+                            g_regex_ref(g_ptr_array_index(joined, i)));
+    }
+
+    g_ptr_array_free(joined, TRUE);
+    g_string_free(alternation, TRUE);
+
+    for (; hidden_events && *hidden_events; hidden_events++) {
+        for (unsigned int i = 0; i < G_N_ELEMENTS(event_names); i++) {
+            if (g_ascii_strcasecmp(*hidden_events, event_names[i]) == 0)
+                filter->hidden_events |= 1 << i;
+        }
+    }
+    filter->large_channel_size = large_channel_size;
+
+    return filter;
+}
+
+void sqchat_filter_free(struct sqchat_filter * filter) {
+    if (filter->masks)
+        g_regex_unref(filter->masks);
+    if (filter->text)
+        g_regex_unref(filter->text);
+    g_ptr_array_free(filter->separate_text, TRUE);
+    free(filter);
+}
+
+bool sqchat_filter_ignores(const struct sqchat_filter * filter,
+                           const char * hostmask,
+                           const char * text) {
+    if (hostmask && filter->masks &&
+        g_regex_match(filter->masks, hostmask, 0, NULL))
+        return true;
+
+    if (text == NULL)
+        return false;
+    if (filter->text && g_regex_match(filter->text, text, 0, NULL))
+        return true;
+
+    for (guint i = 0; i < filter->separate_text->len; i++) {
+        if (g_regex_match(g_ptr_array_index(filter->separate_text, i), text, 0,
+                          NULL))
+            return true;
+    }
+
+    return false;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,80 @@
+/* Decides which messages shouldn't be shown at all, either because they're
+ * from someone being ignored, match one of the user's filters, or are a kind
+ * of message the user doesn't want to see in big channels
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+enum sqchat_filter_event {
+    SQCHAT_FILTER_JOIN,
+    SQCHAT_FILTER_PART,
+    SQCHAT_FILTER_QUIT,
+    SQCHAT_FILTER_NICK
+};
+
+/* All of the ignore masks get compiled into one regex, and so do all of the
+ * text filters, so checking a message is one pass over it's hostmask and one
+ * over it's text no matter how many rules there are. Either regex is NULL if
+ * there's nothing to look for.
+ */
+struct sqchat_filter {
+    GRegex * masks;
+    GRegex * text;
+
+    /* Text filters that can't be joined in with the rest, like ones with
+     * backreferences, each get a regex of their own
+     */
+    GPtrArray * separate_text;
+
+    // Bit 1 << event is set for each event that gets hidden in big channels
+    unsigned int hidden_events;
+    unsigned int large_channel_size;
+};
+
+/* masks are hostmasks with * and ? wildcards, patterns are regexes, and
+ * hidden_events are the names of events ("join", "part", "quit" or "nick") to
+ * hide in channels with at least large_channel_size users. Each list is NULL
+ * terminated, and can be NULL if it's empty.
+ */
+extern struct sqchat_filter * sqchat_filter_new(
+    const char * const * masks,
+    const char * const * patterns,
+    const char * const * hidden_events,
+    unsigned int large_channel_size);
+extern void sqchat_filter_free(struct sqchat_filter * filter)
+    _attr_nonnull(1);
+
+/* Returns true if messages from the hostmask should be ignored. If text isn't
+ * NULL, the message is also ignored if it matches any of the text filters.
+ */
+extern bool sqchat_filter_ignores(const struct sqchat_filter * filter,
+                                  const char * hostmask,
+                                  const char * text)
+    _attr_nonnull(1);
+
+// Doesn't take the size of the channel into account
+static inline bool sqchat_filter_hides(const struct sqchat_filter * filter,
+                                       enum sqchat_filter_event event) {
+    return filter->hidden_events & (1 << event);
+}
+
+#endif // __FILTER_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,117 @@
+/* Templates for the text that gets printed to buffers. A template only gets
+ * parsed once, and expanding it is just a matter of copying it's pieces and
+ * arguments into the output.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "format.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+static void add_text(GArray * segments, const char * text, size_t len) {
+    struct sqchat_format_segment segment = {
+        .type = SQCHAT_FORMAT_TEXT,
+        .text = text,
+        .len = len
+    };
+
+    if (len != 0)
+        g_array_append_val(segments, segment);
+}
+
+static void parse_format(struct sqchat_format * format) {
+    GArray * segments = g_array_new(FALSE, FALSE,
+                                    sizeof(struct sqchat_format_segment));
+    const char * pos = format->template;
+    const char * text_start = pos;
+
+    while (*pos != '\0') {
+        struct sqchat_format_segment segment = { .type = SQCHAT_FORMAT_ARG };
+        char * end;
+
+        if (*pos != '$') {
+            pos++;
+            continue;
+        }
+
+        // $$ turns into a single $, which gets tacked onto the text before it
+        if (pos[1] == '$') {
+            add_text(segments, text_start, pos + 1 - text_start);
+            pos += 2;
+            text_start = pos;
+            continue;
+        }
+        // A $ that isn't followed by a number is just a $
+        else if (!g_ascii_isdigit(pos[1])) {
+            pos++;
+            continue;
+        }
+
+        add_text(segments, text_start, pos - text_start);
+
+        segment.arg = strtoul(pos + 1, &end, 10);
+        pos = end;
+        if (*pos == '-') {
+            segment.type = SQCHAT_FORMAT_ARGS_FROM;
+            pos++;
+        }
+        g_array_append_val(segments, segment);
+
+        text_start = pos;
+    }
+    add_text(segments, text_start, pos - text_start);
+
+    format->segment_count = segments->len;
+    format->segments = (struct sqchat_format_segment *)
+        g_array_free(segments, FALSE);
+}
+
+/* Appends the template to output, filled in with the arguments. This is safe
+ * to call from any thread.
+ */
+void sqchat_format_expand(struct sqchat_format * format,
+                          unsigned int argc,
+                          const char * const * argv,
+                          GString * output) {
+    if (g_once_init_enter(&format->parsed)) {
+        parse_format(format);
+        g_once_init_leave(&format->parsed, 1);
+    }
+
+    for (unsigned int i = 0; i < format->segment_count; i++) {
+        const struct sqchat_format_segment * segment = &format->segments[i];
+
+        switch (segment->type) {
+            case SQCHAT_FORMAT_TEXT:
+                g_string_append_len(output, segment->text, segment->len);
+                break;
+            case SQCHAT_FORMAT_ARG:
+                if (segment->arg < argc && argv[segment->arg] != NULL)
+                    g_string_append(output, argv[segment->arg]);
+                break;
+            case SQCHAT_FORMAT_ARGS_FROM:
+                for (unsigned int arg = segment->arg; arg < argc; arg++) {
+                    if (arg != segment->arg)
+                        g_string_append_c(output, ' ');
+                    g_string_append(output, argv[arg]);
+                }
+                break;
+        }
+    }
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
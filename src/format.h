@@ -0,0 +1,67 @@
+/* Templates for the text that gets printed to buffers. A template only gets
+ * parsed once, and expanding it is just a matter of copying it's pieces and
+ * arguments into the output.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FORMAT_H__
+#define __FORMAT_H__
+
+#include <glib.h>
+#include <stddef.h>
+
+enum sqchat_format_segment_type {
+    SQCHAT_FORMAT_TEXT,
+    // A single argument, $N
+    SQCHAT_FORMAT_ARG,
+    // An argument and every one after it separated by spaces, $N-
+    SQCHAT_FORMAT_ARGS_FROM
+};
+
+struct sqchat_format_segment {
+    enum sqchat_format_segment_type type;
+
+    // Text segments point right into the template
+    const char * text;
+    size_t len;
+
+    unsigned int arg;
+};
+
+/* Templates look like "* $0 sets mode $1-\n", where $N gets replaced with the
+ * Nth argument, $N- with the Nth argument and everything after it, and $$ with
+ * a $. Arguments that weren't given are left out. Templates are meant to be
+ * declared static with SQCHAT_FORMAT(), and get parsed the first time they're
+ * used.
+ */
+struct sqchat_format {
+    const char * template;
+
+    gsize parsed;
+    struct sqchat_format_segment * segments;
+    unsigned int segment_count;
+};
+
+#define SQCHAT_FORMAT(_template) { .template = (_template) }
+
+extern void sqchat_format_expand(struct sqchat_format * format,
+                                 unsigned int argc,
+                                 const char * const * argv,
+                                 GString * output)
+    _attr_nonnull(1, 4);
+
+#endif // __FORMAT_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,303 @@
+/* Finds highlights (our nickname, or any of the user's keywords) in messages.
+ * Everything being looked for gets compiled into one Aho-Corasick automaton, so
+ * a message only has to be scanned once no matter how many keywords there are.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "highlight.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROOT 0
+#define NO_STATE -1
+
+/* Each state's children are kept in a linked list through their siblings,
+ * since most states only ever have one child. The root is the exception, so
+ * it gets a full table of it's own.
+ */
+struct state {
+    gint32 child;
+    gint32 sibling;
+
+    gint32 fail;
+    // The closest state down the fail links that a pattern ends at
+    gint32 output;
+
+    guint32 depth;
+    // How many patterns end at this state, a keyword can be our nickname too
+    guint16 patterns;
+    guchar c;
+};
+
+struct sqchat_highlighter {
+    GArray * states;
+    gint32 root_next[256];
+
+    void (*casemap_lower)(char *);
+    char fold[256];
+
+    // These are kept as they were given, so they can be refolded later
+    GPtrArray * keywords;
+    char * nickname;
+    gint32 nickname_state;
+
+    // How many states all of the patterns could possibly need
+    guint needed_states;
+};
+
+#define STATE(_highlighter, _state) \
+    (&g_array_index((_highlighter)->states, struct state, (_state)))
+
+/* Runs the casemap over every possible byte once, so folding a message is just
+ * a table lookup for each character
+ */
+static void build_fold_table(struct sqchat_highlighter * highlighter) {
+    char bytes[256];
+
+    for (int i = 1; i < 256; i++)
+        bytes[i - 1] = i;
+    bytes[255] = '\0';
+
+    highlighter->casemap_lower(bytes);
+
+    highlighter->fold[0] = '\0';
+    memcpy(&highlighter->fold[1], bytes, 255);
+}
+
+static inline gint32 find_child(const struct sqchat_highlighter * highlighter,
+                                gint32 state,
+                                guchar c) {
+    if (state == ROOT)
+        return highlighter->root_next[c];
+
+    for (state = STATE(highlighter, state)->child;
+         state != NO_STATE && STATE(highlighter, state)->c != c;
+         state = STATE(highlighter, state)->sibling);
+
+    return state;
+}
+
+// Returns the state the pattern ends at
+static gint32 add_pattern(struct sqchat_highlighter * highlighter,
+                          const char * pattern) {
+    gint32 state = ROOT;
+
+    for (const char * p = pattern; *p != '\0'; p++) {
+        guchar c = highlighter->fold[(guchar)*p];
+        gint32 next = find_child(highlighter, state, c);
+
+        if (next == NO_STATE) {
+            struct state new_state = {
+                .child = NO_STATE,
+                .sibling = STATE(highlighter, state)->child,
+                .fail = ROOT,
+                .output = NO_STATE,
+                .depth = STATE(highlighter, state)->depth + 1,
+                .c = c
+            };
+
+            next = highlighter->states->len;
+            g_array_append_val(highlighter->states, new_state);
+            STATE(highlighter, state)->child = next;
+
+            if (state == ROOT)
+                highlighter->root_next[c] = next;
+        }
+
+        state = next;
+    }
+
+    STATE(highlighter, state)->patterns++;
+    highlighter->needed_states += strlen(pattern);
+    return state;
+}
+
+/* Works out the fail and output links for every state, a level at a time,
+ * since a state's links always point to a state closer to the root
+ */
+static void link_states(struct sqchat_highlighter * highlighter) {
+    gint32 * queue = malloc(sizeof(gint32) * highlighter->states->len);
+    guint head = 0;
+    guint tail = 0;
+
+    queue[tail++] = ROOT;
+    while (head < tail) {
+        gint32 parent = queue[head++];
+
+        for (gint32 child = STATE(highlighter, parent)->child;
+             child != NO_STATE;
+             child = STATE(highlighter, child)->sibling) {
+            struct state * state = STATE(highlighter, child);
+            gint32 fail = ROOT;
+
+            if (parent != ROOT) {
+                gint32 next;
+
+                for (fail = STATE(highlighter, parent)->fail;
+                     (next = find_child(highlighter, fail, state->c))
+                         == NO_STATE && fail != ROOT;
+                     fail = STATE(highlighter, fail)->fail);
+
+                if (next != NO_STATE)
+                    fail = next;
+            }
+
+            state->fail = fail;
+            state->output = STATE(highlighter, fail)->patterns
+                ? fail : STATE(highlighter, fail)->output;
+
+            queue[tail++] = child;
+        }
+    }
+
+    free(queue);
+}
+
+// Throws away all of the states and builds everything again from scratch
+static void compile(struct sqchat_highlighter * highlighter) {
+    struct state root = {
+        .child = NO_STATE,
+        .sibling = NO_STATE,
+        .fail = ROOT,
+        .output = NO_STATE
+    };
+
+    g_array_set_size(highlighter->states, 0);
+    g_array_append_val(highlighter->states, root);
+    for (int i = 0; i < 256; i++)
+        highlighter->root_next[i] = NO_STATE;
+    highlighter->needed_states = 1;
+
+    for (guint i = 0; i < highlighter->keywords->len; i++)
+        add_pattern(highlighter, g_ptr_array_index(highlighter->keywords, i));
+
+    if (highlighter->nickname && *highlighter->nickname != '\0')
+        highlighter->nickname_state = add_pattern(highlighter,
+                                                  highlighter->nickname);
+    else
+        highlighter->nickname_state = NO_STATE;
+
+    link_states(highlighter);
+}
+
+struct sqchat_highlighter * sqchat_highlighter_new(
+    const char * const * keywords,
+    void (*casemap_lower)(char *)) {
+    struct sqchat_highlighter * highlighter =
+        calloc(1, sizeof(struct sqchat_highlighter));
+
+    highlighter->states = g_array_new(FALSE, FALSE, sizeof(struct state));
+    highlighter->keywords = g_ptr_array_new_with_free_func(g_free);
+    highlighter->casemap_lower = casemap_lower;
+
+    for (; keywords && *keywords; keywords++) {
+        if (**keywords != '\0')
+            g_ptr_array_add(highlighter->keywords, g_strdup(*keywords));
+    }
+
+    build_fold_table(highlighter);
+    compile(highlighter);
+
+    return highlighter;
+}
+
+void sqchat_highlighter_free(struct sqchat_highlighter * highlighter) {
+    g_array_free(highlighter->states, TRUE);
+    g_ptr_array_free(highlighter->keywords, TRUE);
+    g_free(highlighter->nickname);
+    free(highlighter);
+}
+
+/* The keywords stay where they are, the old nickname just stops counting as a
+ * pattern and the new one gets added on. The states the old nickname used are
+ * left behind until there's enough of them to be worth building everything
+ * again.
+ */
+void sqchat_highlighter_set_nickname(struct sqchat_highlighter * highlighter,
+                                     const char * nickname) {
+    if (highlighter->nickname_state != NO_STATE) {
+        STATE(highlighter, highlighter->nickname_state)->patterns--;
+        highlighter->needed_states -= strlen(highlighter->nickname);
+    }
+
+    g_free(highlighter->nickname);
+    highlighter->nickname = g_strdup(nickname);
+
+    if (highlighter->states->len > highlighter->needed_states * 2 + 64) {
+        compile(highlighter);
+        return;
+    }
+
+    if (nickname && *nickname != '\0')
+        highlighter->nickname_state = add_pattern(highlighter, nickname);
+    else
+        highlighter->nickname_state = NO_STATE;
+
+    link_states(highlighter);
+}
+
+// Everything has to be folded again, so there's nothing to keep here
+void sqchat_highlighter_set_casemap(struct sqchat_highlighter * highlighter,
+                                    void (*casemap_lower)(char *)) {
+    if (highlighter->casemap_lower == casemap_lower)
+        return;
+
+    highlighter->casemap_lower = casemap_lower;
+    build_fold_table(highlighter);
+    compile(highlighter);
+}
+
+static inline bool is_word_char(char c) {
+    return c != '\0' &&
+           (g_ascii_isalnum(c) || (guchar)c >= 0x80 ||
+            strchr("[]\\`_^{|}-", c));
+}
+
+static inline bool is_whole_word(const char * text,
+                                 const char * start,
+                                 const char * end) {
+    return (start == text || !is_word_char(start[-1])) && !is_word_char(*end);
+}
+
+bool sqchat_highlighter_match(const struct sqchat_highlighter * highlighter,
+                              const char * text) {
+    gint32 state = ROOT;
+
+    for (const char * c = text; *c != '\0'; c++) {
+        guchar folded = highlighter->fold[(guchar)*c];
+        gint32 next;
+
+        while ((next = find_child(highlighter, state, folded)) == NO_STATE &&
+               state != ROOT)
+            state = STATE(highlighter, state)->fail;
+        state = next == NO_STATE ? ROOT : next;
+
+        for (gint32 match = STATE(highlighter, state)->patterns
+                 ? state : STATE(highlighter, state)->output;
+             match != NO_STATE;
+             match = STATE(highlighter, match)->output) {
+            if (is_whole_word(text, c + 1 - STATE(highlighter, match)->depth,
+                              c + 1))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
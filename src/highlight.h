@@ -0,0 +1,55 @@
+/* Finds highlights (our nickname, or any of the user's keywords) in messages.
+ * Everything being looked for gets compiled into one Aho-Corasick automaton, so
+ * a message only has to be scanned once no matter how many keywords there are.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HIGHLIGHT_H__
+#define __HIGHLIGHT_H__
+
+#include <stdbool.h>
+
+struct sqchat_highlighter;
+
+/* keywords is NULL terminated, and can be NULL if there aren't any. Case gets
+ * folded with casemap_lower, which should be the network's casemap.
+ */
+extern struct sqchat_highlighter * sqchat_highlighter_new(
+    const char * const * keywords,
+    void (*casemap_lower)(char *))
+    _attr_nonnull(2);
+extern void sqchat_highlighter_free(struct sqchat_highlighter * highlighter)
+    _attr_nonnull(1);
+
+extern void sqchat_highlighter_set_nickname(
+    struct sqchat_highlighter * highlighter,
+    const char * nickname)
+    _attr_nonnull(1);
+extern void sqchat_highlighter_set_casemap(
+    struct sqchat_highlighter * highlighter,
+    void (*casemap_lower)(char *))
+    _attr_nonnull(1, 2);
+
+/* Returns true if the text contains our nickname or one of the keywords as a
+ * whole word
+ */
+extern bool sqchat_highlighter_match(
+    const struct sqchat_highlighter * highlighter,
+    const char * text)
+    _attr_nonnull(1, 2);
+
+#endif // __HIGHLIGHT_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
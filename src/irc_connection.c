@@ -0,0 +1,328 @@
+/* The connection to an IRC server underneath a network. Everything that reads
+ * from the server runs on the I/O thread, and gets handed back to the main
+ * thread through the connection's observer.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "irc_connection.h"
+#include "irc_message.h"
+#include "net_io_thread.h"
+#include "spsc_queue.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <gnutls/gnutls.h>
+
+void sqchat_connection_init(struct sqchat_connection * connection,
+                            const struct sqchat_connection_observer * observer,
+                            void * data) {
+    memset(connection, 0, sizeof(struct sqchat_connection));
+
+    connection->socket = -1;
+    connection->observer = observer;
+    connection->observer_data = data;
+    connection->events = sqchat_spsc_queue_new(SQCHAT_NET_EVENT_QUEUE_LEN);
+}
+
+void sqchat_connection_cleanup(struct sqchat_connection * connection) {
+    sqchat_spsc_queue_free(connection->events, sqchat_net_event_free);
+}
+
+/* Gets a connection ready to start talking to a server over a socket we've
+ * just connected. Anything left over from the last time the connection was
+ * used gets thrown away.
+ */
+void sqchat_connection_open(struct sqchat_connection * connection,
+                            int socket,
+                            bool ssl,
+                            const char * fallback_encoding) {
+    connection->socket = socket;
+    connection->ssl = ssl;
+    connection->ssl_session_saved = false;
+    connection->fallback_encoding = fallback_encoding;
+
+    connection->buffer_cursor = 0;
+    connection->buffer_fill_len = 0;
+    connection->recv_buffer[0] = '\0';
+
+    memset(&connection->stats, 0, sizeof(struct sqchat_connection_stats));
+
+    connection->input_channel = g_io_channel_unix_new(socket);
+    g_io_channel_set_encoding(connection->input_channel, NULL, NULL);
+    g_io_channel_set_buffered(connection->input_channel, FALSE);
+}
+
+void sqchat_connection_close(struct sqchat_connection * connection) {
+#ifdef WITH_SSL
+    if (connection->ssl)
+        gnutls_deinit(connection->ssl_session);
+#endif
+    close(connection->socket);
+    connection->socket = -1;
+
+    if (connection->input_channel) {
+        g_io_channel_unref(connection->input_channel);
+        connection->input_channel = NULL;
+    }
+}
+
+ssize_t sqchat_connection_send(struct sqchat_connection * connection,
+                               const void * data,
+                               size_t len) {
+    gint64 start = sqchat_stats_now();
+    ssize_t result;
+
+#ifdef WITH_SSL
+    if (connection->ssl)
+        result = gnutls_write(connection->ssl_session, data, len);
+    else
+#endif
+        result = send(connection->socket, data, len, 0);
+
+    sqchat_histogram_add(&sqchat_stats.send_time, sqchat_stats_now() - start);
+    if (result > 0) {
+        g_atomic_pointer_add(&connection->stats.bytes_sent, result);
+        g_atomic_pointer_add(&connection->stats.lines_sent, 1);
+    }
+
+    return result;
+}
+
+/* Saves the parameters for the current session so we can resume it the next
+ * time we connect to the same server. Under TLS 1.3 the server only sends us a
+ * ticket after the handshake, so this has to be retried until one shows up.
+ */
+void sqchat_connection_save_session(struct sqchat_connection * connection) {
+#ifdef WITH_SSL
+    gnutls_datum_t session_data;
+
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+    if (gnutls_protocol_get_version(connection->ssl_session) == GNUTLS_TLS1_3 &&
+        !(gnutls_session_get_flags(connection->ssl_session) &
+          GNUTLS_SFLAGS_SESSION_TICKET))
+        return;
+#endif
+
+    if (connection->ssl_session_store == NULL ||
+        gnutls_session_get_data2(connection->ssl_session, &session_data) < 0)
+        return;
+
+    gnutls_free(connection->ssl_session_store->data);
+    *connection->ssl_session_store = session_data;
+    connection->ssl_session_saved = true;
+#endif
+}
+
+/* Checks for messages waiting in a connection's buffer
+ * If there is still a message waiting in the connection's buffer, it returns it
+ * and moves the buffer cursor forward. Otherwise returns null. NULL is returned
+ * and errno is set in the event of an error. The contents of the buffer must
+ * always be null-terminated. The line returned points into the buffer, so it's
+ * only good until the next time data is read into it.
+ */
+char * sqchat_connection_next_line(struct sqchat_connection * connection) {
+    char * next_terminator =
+        strstr(&connection->recv_buffer[connection->buffer_cursor], "\r\n");
+    char * output;
+
+    // If a message was found, remove the terminator, set output variable
+    if (next_terminator != NULL) {
+        *next_terminator = '\0';
+        *(next_terminator + 1) = '\0';
+        output = &connection->recv_buffer[connection->buffer_cursor];
+        connection->buffer_cursor = (int)(next_terminator -
+                                          &connection->recv_buffer[0]) + 2;
+        return output;
+    }
+
+    /* If no message was found, whatever is left after the cursor is only a
+     * partially received message. Move it to the front of the buffer to make
+     * room for the rest of it
+     */
+    connection->buffer_fill_len -= connection->buffer_cursor;
+    memmove(&connection->recv_buffer[0],
+            &connection->recv_buffer[connection->buffer_cursor],
+            connection->buffer_fill_len + 1);
+    connection->buffer_cursor = 0;
+
+    /* If the buffer is full and the message still hasn't ended, there's
+     * nothing we can do with it but throw it away
+     */
+    if (connection->buffer_fill_len >= SQCHAT_RECV_BUF_LEN - 1) {
+        errno = EMSGSIZE;
+        connection->buffer_fill_len = 0;
+        connection->recv_buffer[0] = '\0';
+    }
+
+    return NULL;
+}
+
+static void post_closed(struct sqchat_connection * connection,
+                        char * error,
+                        const char * quit_msg) {
+    struct sqchat_net_event * event =
+        sqchat_net_event_new(SQCHAT_NET_EVENT_CLOSED);
+
+    event->error = error;
+    event->quit_msg = quit_msg;
+    sqchat_net_io_post(connection, event);
+}
+
+/* Parses all of the messages waiting in a connection's receive buffer and
+ * hands them off to the main thread
+ */
+static void post_messages(struct sqchat_connection * connection) {
+    struct sqchat_net_event * event;
+    struct sqchat_msg * msg;
+    char * line;
+    gint64 start;
+
+    while ((line = sqchat_connection_next_line(connection)) != NULL) {
+        g_atomic_pointer_add(&connection->stats.lines_received, 1);
+        g_atomic_pointer_add(&sqchat_stats.lines_received, 1);
+        start = sqchat_stats_now();
+
+        // Make sure that the string is encoded in UTF-8 before handing it off
+        if (g_utf8_validate(line, -1, NULL))
+            msg = sqchat_parse_msg(line);
+        else {
+            char * line_utf8 =
+                g_convert_with_fallback(line, -1, "UTF-8",
+                                        connection->fallback_encoding,
+                                        "�", NULL, NULL, NULL);
+            if (line_utf8 == NULL)
+                continue;
+
+            msg = sqchat_parse_msg(line_utf8);
+            g_free(line_utf8);
+        }
+
+        sqchat_histogram_add(&sqchat_stats.parse_time,
+                             sqchat_stats_now() - start);
+
+        if (msg == NULL)
+            continue;
+
+        event = sqchat_net_event_new(SQCHAT_NET_EVENT_MSG);
+        event->msg = msg;
+        sqchat_net_io_post(connection, event);
+    }
+}
+
+// Accounts for data that was just read into the receive buffer
+static inline void count_received(struct sqchat_connection * connection,
+                                  int len) {
+    connection->buffer_fill_len += len;
+    connection->recv_buffer[connection->buffer_fill_len] = '\0';
+
+    g_atomic_pointer_add(&connection->stats.bytes_received, len);
+    g_atomic_pointer_add(&sqchat_stats.bytes_received, len);
+}
+
+/* Reads from a connection. This runs on the I/O thread, so everything it finds
+ * gets handed off to the main thread instead of being acted on here. Once it
+ * posts an event saying it's done with the connection, it can't touch the
+ * connection anymore.
+ */
+static gboolean io_input_handler(GIOChannel * source,
+                                 GIOCondition condition,
+                                 struct sqchat_connection * connection) {
+    int result;
+
+#ifdef WITH_SSL
+    if (connection->ssl) {
+        do {
+            result = gnutls_read(
+                connection->ssl_session,
+                &connection->recv_buffer[connection->buffer_fill_len],
+                SQCHAT_RECV_BUF_LEN - 1 - connection->buffer_fill_len);
+            if (result == 0) {
+                post_closed(connection, NULL, NULL);
+                return FALSE;
+            }
+            // The handshake has to happen on the main thread
+            else if (result == GNUTLS_E_REHANDSHAKE) {
+                sqchat_net_io_post(connection,
+                    sqchat_net_event_new(SQCHAT_NET_EVENT_REHANDSHAKE));
+                return FALSE;
+            }
+            else if (result == GNUTLS_E_INTERRUPTED ||
+                     result == GNUTLS_E_AGAIN)
+                return TRUE;
+            /* If the receive fails for any reason, close the connection
+             * We may eventually want to improve on this behavior
+             */
+            else if (result < 0) {
+                post_closed(connection,
+                            g_strdup_printf("SSL error during record receive: "
+                                            "%s\n"
+                                            "* Disconnected.\n",
+                                            gnutls_strerror(result)),
+                            "SSL error");
+                return FALSE;
+            }
+
+            count_received(connection, result);
+
+            // Hold onto the session ticket once the server sends one
+            if (!connection->ssl_session_saved)
+                sqchat_connection_save_session(connection);
+
+            post_messages(connection);
+        } while (gnutls_record_check_pending(connection->ssl_session));
+    }
+    else {
+#endif // WITH_SSL
+        result = recv(connection->socket,
+                      &connection->recv_buffer[connection->buffer_fill_len],
+                      SQCHAT_RECV_BUF_LEN - 1 - connection->buffer_fill_len,
+                      0);
+
+        if (result == 0) {
+            post_closed(connection, NULL, NULL);
+            return FALSE;
+        }
+        else if (result == -1) {
+            post_closed(connection,
+                        g_strdup_printf("Error: %s\n"
+                                        "Closing connection.\n",
+                                        strerror(errno)),
+                        NULL);
+            return FALSE;
+        }
+
+        count_received(connection, result);
+
+        post_messages(connection);
+#ifdef WITH_SSL
+    }
+#endif
+
+    return TRUE;
+}
+
+// Starts reading from the connection on the I/O thread
+void sqchat_connection_watch(struct sqchat_connection * connection) {
+    sqchat_net_io_watch(connection, (GIOFunc)io_input_handler);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,123 @@
+/* The connection to an IRC server underneath a network. This takes care of
+ * reading from the server and splitting up what it sends us, and hands
+ * everything off to an observer. It doesn't depend on the UI at all.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __IRC_CONNECTION_H__
+#define __IRC_CONNECTION_H__
+
+#include "macros.h"
+#include "irc_message.h"
+#include "spsc_queue.h"
+#include "stats.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <gnutls/gnutls.h>
+
+struct sqchat_connection;
+
+/* Gets told about everything that happens on a connection. These are all
+ * called from the default main context, never from the I/O thread. Each one
+ * returns false if the connection was freed while handling the event, in which
+ * case nothing else gets delivered.
+ */
+struct sqchat_connection_observer {
+    bool (*message)(struct sqchat_connection * connection,
+                    struct sqchat_msg * msg,
+                    void * data);
+
+    /* The server wants another SSL handshake. The connection stops reading
+     * until sqchat_connection_watch() is called again.
+     */
+    bool (*rehandshake)(struct sqchat_connection * connection, void * data);
+
+    /* The server closed the connection, or something went wrong with it. error
+     * is NULL if the connection closed normally, and quit_msg is the message to
+     * send the server if we should still try to say goodbye. The observer has
+     * to call sqchat_connection_close() itself.
+     */
+    bool (*closed)(struct sqchat_connection * connection,
+                   const char * error,
+                   const char * quit_msg,
+                   void * data);
+};
+
+struct sqchat_connection {
+    int socket;
+    bool ssl;
+    gnutls_session_t ssl_session;
+
+    /* Where to keep the parameters for resuming our SSL session once the
+     * server sends them
+     */
+    gnutls_datum_t * ssl_session_store;
+    bool ssl_session_saved;
+
+    // What to assume messages that aren't valid UTF-8 are encoded with
+    const char * fallback_encoding;
+
+    GIOChannel * input_channel;
+    char recv_buffer[SQCHAT_RECV_BUF_LEN];
+    int buffer_cursor;
+    size_t buffer_fill_len;
+
+    const struct sqchat_connection_observer * observer;
+    void * observer_data;
+
+    // Events waiting to be handed to the observer, see net_io_thread.h
+    sqchat_spsc_queue * events;
+    gint events_scheduled;
+
+    // Counters for the connection, reset every time it's opened
+    struct sqchat_connection_stats stats;
+};
+
+extern void sqchat_connection_init(
+    struct sqchat_connection * connection,
+    const struct sqchat_connection_observer * observer,
+    void * data)
+    _attr_nonnull(1, 2);
+extern void sqchat_connection_cleanup(struct sqchat_connection * connection)
+    _attr_nonnull(1);
+
+extern void sqchat_connection_open(struct sqchat_connection * connection,
+                                   int socket,
+                                   bool ssl,
+                                   const char * fallback_encoding)
+    _attr_nonnull(1, 4);
+extern void sqchat_connection_watch(struct sqchat_connection * connection)
+    _attr_nonnull(1);
+extern void sqchat_connection_close(struct sqchat_connection * connection)
+    _attr_nonnull(1);
+
+extern char * sqchat_connection_next_line(
+    struct sqchat_connection * connection)
+    _attr_nonnull(1);
+
+extern ssize_t sqchat_connection_send(struct sqchat_connection * connection,
+                                      const void * data,
+                                      size_t len)
+    _attr_nonnull(1, 2);
+extern void sqchat_connection_save_session(
+    struct sqchat_connection * connection)
+    _attr_nonnull(1);
+
+#endif // __IRC_CONNECTION_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,114 @@
+/* Functions for splitting up the messages we get from IRC servers. None of this
+ * depends on any other part of the client.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "irc_message.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* A function to convert strings to shorts, optimized specifically for IRC
+ * numerics
+ */
+short sqchat_numeric_to_short(const char * numeric) {
+    short result = 0;
+    short i;
+    for (i = 0; i < 3; i++) {
+        if (numeric[i] < '0' || numeric[i] > '9')
+            return -1;
+        result = (result * 10) + (numeric[i] - '0');
+    }
+    if (numeric[i] != '\0')
+        return -1;
+    else
+        return result;
+}
+
+/* Splits a message from the server up into it's sender, command and
+ * parameters. The message is copied, so the original can be freed afterwards.
+ * Returns NULL if the message is malformed. This doesn't touch any network
+ * state, so it's safe to call from any thread.
+ */
+struct sqchat_msg * sqchat_parse_msg(const char * line) {
+    struct sqchat_msg * msg;
+    size_t line_len = strlen(line) + 1;
+    char * cursor;
+    char * buf;
+
+    /* Every parameter has to have a space in front of it, so there can't be
+     * any more parameters than there are spaces in the message
+     */
+    short max_argc = 1;
+    for (const char * c = line; *c != '\0'; c++)
+        if (*c == ' ')
+            max_argc++;
+
+    msg = malloc(sizeof(struct sqchat_msg) + max_argc * sizeof(char*) +
+                 line_len);
+    buf = (char*)&msg->argv[max_argc];
+    memcpy(buf, line, line_len);
+
+    /* TODO: Maybe figure out a better behavior for when bad messages are
+     * received...
+     */
+    // Check to see if the message has a sender
+    if (buf[0] == ':') {
+        if ((msg->hostmask = strtok_r(buf+1, " ", &cursor)) == NULL ||
+            (msg->command = strtok_r(NULL, " ", &cursor)) == NULL) {
+            free(msg);
+            return NULL;
+        }
+    }
+    else {
+        msg->hostmask = NULL;
+        if ((msg->command = strtok_r(buf, " ", &cursor)) == NULL) {
+            free(msg);
+            return NULL;
+        }
+    }
+
+    for (msg->argc = 0; ; msg->argc++) {
+        char * param_end;
+
+        /* If there's a ':' at the beginning of the message we need to stop
+         * processing spaces
+         */
+        if (*cursor == ':') {
+            msg->argv[msg->argc++] = cursor + 1;
+            break;
+        }
+
+        else if ((param_end = strchr(cursor, ' ')) == NULL) {
+            msg->argv[msg->argc] = cursor;
+            msg->argc++;
+            break;
+        }
+        *param_end = '\0';
+        msg->argv[msg->argc] = cursor;
+        for (cursor = param_end + 1; *cursor == ' '; cursor++);
+    }
+
+    return msg;
+}
+
+void sqchat_split_hostmask(char * hostmask, char ** nickname, char ** address) {
+    char * saveptr;
+    *nickname = strtok_r(hostmask, "!", &saveptr);
+    *address = strtok_r(NULL, "!", &saveptr);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,39 @@
+/* Functions for splitting up the messages we get from IRC servers
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __IRC_MESSAGE_H__
+#define __IRC_MESSAGE_H__
+
+// A message from the server, split up into it's sender, command and parameters
+struct sqchat_msg {
+    char * hostmask;
+    char * command;
+    short argc;
+    char * argv[];
+};
+
+extern struct sqchat_msg * sqchat_parse_msg(const char * line)
+    _attr_nonnull(1);
+extern short sqchat_numeric_to_short(const char * numeric)
+    _attr_nonnull(1);
+extern void sqchat_split_hostmask(char * hostmask,
+                                  char ** nickname,
+                                  char ** address)
+    _attr_nonnull(1, 2, 3);
+
+#endif // __IRC_MESSAGE_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
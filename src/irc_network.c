@@ -18,9 +18,11 @@
 #include "ui/buffer.h"
 #include "net_io.h"
 #include "net_input_handler.h"
+#include "net_io_thread.h"
 #include "settings.h"
 #include "connection_setup.h"
 #include "cmd_responses.h"
+#include "netsplit.h"
 
 #include <gtk/gtk.h>
 #include <glib.h>
@@ -53,6 +55,21 @@ struct sqchat_network * sqchat_network_new() {
 
     network->buffers = sqchat_trie_new(sqchat_trie_strtolower);
 
+    // Until the network tells us otherwise, it's casemap is rfc1459
+    network->highlighter =
+        sqchat_highlighter_new((const char * const *)sqchat_highlight_keywords,
+                               sqchat_trie_rfc1459_strtolower);
+    sqchat_highlighter_set_nickname(network->highlighter, network->nickname);
+
+    network->filter =
+        sqchat_filter_new((const char * const *)sqchat_ignore_masks,
+                          (const char * const *)sqchat_ignore_patterns,
+                          (const char * const *)sqchat_filter_hide_events,
+                          MAX(sqchat_filter_large_channel_size, 0));
+
+    sqchat_connection_init(&network->connection, &sqchat_network_observer,
+                           network);
+
     return network;
 }
 
@@ -69,11 +86,15 @@ void sqchat_network_destroy(struct sqchat_network * network) {
     else {
         sqchat_buffer_destroy(network->buffer);
         sqchat_trie_free(network->buffers, sqchat_buffer_free, NULL);
+        sqchat_netsplit_free_all(network);
 
         free(network->password);
         free(network->nickname);
         free(network->username);
         free(network->real_name);
+        free(network->ssl_peer_cert.data);
+        sqchat_highlighter_free(network->highlighter);
+        sqchat_filter_free(network->filter);
         for (struct sqchat_cmd_response_claim * c = network->claimed_responses;
              c != NULL;) {
             struct sqchat_cmd_response_claim * current = c;
@@ -81,7 +102,12 @@ void sqchat_network_destroy(struct sqchat_network * network) {
             free(current);
         }
 
-        free(network);
+        sqchat_connection_cleanup(&network->connection);
+
+        /* The I/O thread might still be wrapping up after handing us the last
+         * event for this network, so let it free the network itself
+         */
+        sqchat_net_io_free(network, free);
     }
 }
 
@@ -98,6 +124,12 @@ void sqchat_network_connect(struct sqchat_network * network) {
     if (network->current_server == NULL)
         network->current_server = network->servers;
 
+    /* If there's more then one server to pick from, let the connection thread
+     * figure out which one is the fastest
+     */
+    if (network->probe_servers && g_slist_next(network->servers) != NULL)
+        g_atomic_int_set(&network->probe_pending, TRUE);
+
     server = network->current_server->data;
 
 #ifndef WITH_SSL
@@ -109,6 +141,10 @@ void sqchat_network_connect(struct sqchat_network * network) {
     }
 #endif
 
+    // Until the network tells us it's name, log everything under the server's
+    if (network->name == NULL)
+        sqchat_network_update_logs(network);
+
     sqchat_buffer_print(network->buffer, "Attempting to connect to %s:%s...\n",
                         server->address, server->port); 
     sqchat_begin_connection_attempt(network);
@@ -116,13 +152,14 @@ void sqchat_network_connect(struct sqchat_network * network) {
 
 void sqchat_network_disconnect(struct sqchat_network * network,
                                const char * msg) {
-    sqchat_server * server = network->current_server->data;
     sqchat_network_send(network, "QUIT :%s\r\n", msg ? msg : "");
 
-#ifdef WITH_SSL
-    if (server->ssl)
-        network->ssl_cred = NULL;
-#endif
+    // Anyone who hasn't come back from a netsplit by now isn't going to
+    sqchat_netsplit_free_all(network);
+
+    /* Note that the SSL session (and our reference to the shared credentials)
+     * stays around until the connection is actually closed
+     */
 
     for (sqchat_cmd_response_claim * c = network->claimed_responses;
          c != NULL;) {
@@ -158,6 +195,35 @@ void sqchat_network_disconnect(struct sqchat_network * network,
     network->casecmp = NULL;
 }
 
+/* Figures out what directory the network's logs should go in. Returns NULL if
+ * there's nothing to go by yet.
+ */
+const char * sqchat_network_log_name(struct sqchat_network * network) {
+    if (network->name)
+        return network->name;
+    else if (network->current_server)
+        return ((sqchat_server*)network->current_server->data)->address;
+    else
+        return NULL;
+}
+
+static void update_buffer_log(struct sqchat_buffer * buffer,
+                              const char * log_name) {
+    if (buffer->log)
+        sqchat_log_set_network(buffer->log, log_name);
+}
+
+// Moves all of the network's logs over to wherever they should be now
+void sqchat_network_update_logs(struct sqchat_network * network) {
+    const char * log_name = sqchat_network_log_name(network);
+
+    if (log_name == NULL)
+        return;
+
+    update_buffer_log(network->buffer, log_name);
+    sqchat_trie_each(network->buffers, update_buffer_log, (void*)log_name);
+}
+
 sqchat_server * sqchat_parse_server_string(char * input) {
     sqchat_server * server = g_malloc(sizeof(sqchat_server));
     memset(server, '\0', sizeof(sqchat_server));
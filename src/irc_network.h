@@ -21,6 +21,9 @@
 
 #include "macros.h"
 #include "trie.h"
+#include "irc_connection.h"
+#include "highlight.h"
+#include "filter.h"
 
 #include <gtk/gtk.h>
 #include <glib.h>
@@ -34,6 +37,19 @@ struct sqchat_server {
     char * address;
     char * port;
     bool ssl;
+
+    /* Connection latency history, in microseconds. This gets written by the
+     * connection setup thread while the main thread might be showing it, so
+     * it's only ever touched with g_atomic_int_*().
+     */
+    gint rtt_last;
+    gint rtt_avg;
+    gint rtt_samples;
+    // Only used by the connection setup thread
+    unsigned int probe_failures;
+
+    // Saved parameters for resuming our last SSL session with the server
+    gnutls_datum_t ssl_session_data;
 };
 
 typedef struct sqchat_server sqchat_server;
@@ -79,11 +95,21 @@ struct sqchat_network {
     bool away                           : 1;
 
     bool destroy_on_disconnect          : 1;
+
+    bool probe_servers                  : 1;
     bool                                : 0;
 
-    gnutls_session_t ssl_session;
+    /* Set from the main thread and cleared by the connection setup thread, so
+     * it can't share a word with the flags above
+     */
+    gint probe_pending;
+
+    struct sqchat_connection connection;
+
     gnutls_certificate_credentials_t ssl_cred;
-    int socket;
+    gnutls_datum_t ssl_peer_cert;
+    unsigned int ssl_handshakes;
+    unsigned int ssl_resumed_handshakes;
     GThread * addr_res_thread;
 
     enum {
@@ -94,16 +120,18 @@ struct sqchat_network {
         REHANDSHAKE
     } status;
 
-    char recv_buffer[SQCHAT_MSG_BUF_LEN];
-    int buffer_cursor;
-    size_t buffer_fill_len;
-    GIOChannel * input_channel;
-
     struct sqchat_chat_window * window;
 
     struct sqchat_buffer * buffer;
     sqchat_trie * buffers;
     struct sqchat_cmd_response_claim * claimed_responses;
+
+    // Looks for our nickname and the highlight keywords in messages
+    struct sqchat_highlighter * highlighter;
+    // Ignores and filters, compiled once when the network's created
+    struct sqchat_filter * filter;
+    // Netsplits we're still folding the quits or joins of
+    GSList * netsplits;
 };
 
 extern sqchat_server * sqchat_parse_server_string(char * input)
@@ -119,6 +147,11 @@ extern void sqchat_network_disconnect(struct sqchat_network * network,
                                       const char * msg)
     _attr_nonnull(1);
 
+extern const char * sqchat_network_log_name(struct sqchat_network * network)
+    _attr_nonnull(1);
+extern void sqchat_network_update_logs(struct sqchat_network * network)
+    _attr_nonnull(1);
+
 #define SQCHAT_IS_CHAN(_network, _str) (strchr((_network)->chantypes, *(_str)))
 
 #endif /* __IRC_NETWORK_H__ */
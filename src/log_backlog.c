@@ -0,0 +1,219 @@
+/* Reads a buffer's history back out of it's log segments, newest first, a chunk
+ * at a time
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_backlog.h"
+#include "log_segment.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Segments are read backwards one stretch between two entries in their time
+ * index at a time, since records can only be read forwards
+ */
+struct sqchat_log_backlog {
+    char * path;
+    gint64 before;
+
+    // Segment file names, oldest first
+    GPtrArray * segments;
+    int current;
+
+    struct sqchat_log_segment * segment;
+    struct sqchat_log_index * index;
+    guint entry;
+    // Everything from here on in the current segment has been read already
+    guint64 end;
+};
+
+/* Segments are named <date>.seg, then <date>.1.seg, <date>.2.seg and so on once
+ * they fill up
+ */
+static unsigned int segment_part(const char * name) {
+    unsigned int part = 0;
+
+    sscanf(name + strlen("YYYY-MM-DD"), ".%u", &part);
+    return part;
+}
+
+static int compare_segments(const void * a, const void * b) {
+    const char * x = *(const char **)a;
+    const char * y = *(const char **)b;
+    int result = strncmp(x, y, strlen("YYYY-MM-DD"));
+
+    if (result != 0)
+        return result;
+    return (segment_part(x) > segment_part(y)) -
+           (segment_part(x) < segment_part(y));
+}
+
+/* Starts reading the logs in the directory at path, starting with the newest
+ * message from before the given time (in microseconds since the epoch)
+ */
+struct sqchat_log_backlog * sqchat_log_backlog_new(const char * path,
+                                                   gint64 before) {
+    struct sqchat_log_backlog * backlog =
+        calloc(1, sizeof(struct sqchat_log_backlog));
+    GDir * dir = g_dir_open(path, 0, NULL);
+    const char * name;
+
+    backlog->path = g_strdup(path);
+    backlog->before = before;
+    backlog->segments = g_ptr_array_new_with_free_func(g_free);
+
+    if (dir) {
+        while ((name = g_dir_read_name(dir))) {
+            if (g_str_has_suffix(name, SQCHAT_LOG_SEGMENT_SUFFIX))
+                g_ptr_array_add(backlog->segments, g_strdup(name));
+        }
+        g_dir_close(dir);
+    }
+
+    qsort(backlog->segments->pdata, backlog->segments->len, sizeof(gpointer),
+          compare_segments);
+    backlog->current = backlog->segments->len;
+
+    return backlog;
+}
+
+static void close_segment(struct sqchat_log_backlog * backlog) {
+    if (backlog->segment == NULL)
+        return;
+
+    sqchat_log_segment_close(backlog->segment);
+    sqchat_log_index_free(backlog->index);
+    backlog->segment = NULL;
+    backlog->index = NULL;
+}
+
+void sqchat_log_backlog_free(struct sqchat_log_backlog * backlog) {
+    close_segment(backlog);
+    g_ptr_array_free(backlog->segments, TRUE);
+    g_free(backlog->path);
+    free(backlog);
+}
+
+// Moves on to the segment before the current one, returns false at the end
+static bool open_previous_segment(struct sqchat_log_backlog * backlog) {
+    close_segment(backlog);
+
+    while (--backlog->current >= 0) {
+        char * path = g_build_filename(
+            backlog->path,
+            g_ptr_array_index(backlog->segments, backlog->current), NULL);
+
+        backlog->segment = sqchat_log_segment_open(path, NULL);
+        if (backlog->segment == NULL) {
+            g_free(path);
+            continue;
+        }
+
+        /* The newest segment is probably still being written to, so it won't
+         * have an index yet. This runs on the main thread and we only need
+         * the record offsets, so the bloom filter gets left out.
+         */
+        backlog->end = backlog->segment->size;
+        backlog->index = sqchat_log_index_load(path, backlog->segment->size);
+        if (backlog->index == NULL)
+            backlog->index = sqchat_log_segment_build_index(backlog->segment,
+                                                            &backlog->end,
+                                                            false);
+        g_free(path);
+
+        // Skip the segment entirely if it's all from after where we start
+        if (backlog->index->record_count == 0 ||
+            backlog->index->first_time >= backlog->before) {
+            close_segment(backlog);
+            continue;
+        }
+
+        backlog->entry = backlog->index->entries->len;
+        return true;
+    }
+
+    return false;
+}
+
+static void format_record(GString * output,
+                          const struct sqchat_log_record * record) {
+    time_t time = record->time / G_USEC_PER_SEC;
+    char timestamp[sizeof("[YYYY-MM-DD HH:MM] ")];
+    struct tm tm;
+
+    localtime_r(&time, &tm);
+    strftime(timestamp, sizeof(timestamp), "[%Y-%m-%d %H:%M] ", &tm);
+
+    g_string_append(output, timestamp);
+    g_string_append_len(output, record->text, record->length);
+    g_string_append_c(output, '\n');
+}
+
+/* Reads at least count messages from before whatever was read last time (unless
+ * we run out), and adds them to the start of output, oldest first. Returns how
+ * many messages were read, which is 0 once there's nothing left.
+ */
+unsigned int sqchat_log_backlog_read(struct sqchat_log_backlog * backlog,
+                                     unsigned int count,
+                                     GString * output) {
+    GString * chunk = g_string_new(NULL);
+    unsigned int read = 0;
+
+    while (read < count) {
+        const struct sqchat_log_record * record;
+        guint64 start;
+        guint64 offset;
+
+        if (backlog->segment == NULL && !open_previous_segment(backlog))
+            break;
+
+        /* Figure out where the stretch of records just before the ones we've
+         * already read starts
+         */
+        if (backlog->entry > 0) {
+            backlog->entry--;
+            start = g_array_index(backlog->index->entries,
+                                  struct sqchat_log_index_entry,
+                                  backlog->entry).offset;
+        }
+        else
+            start = backlog->segment->records_start;
+
+        g_string_truncate(chunk, 0);
+        for (offset = start;
+             offset < backlog->end &&
+             (record = sqchat_log_segment_next(backlog->segment, &offset));) {
+            if (record->time >= backlog->before)
+                continue;
+
+            format_record(chunk, record);
+            read++;
+        }
+        g_string_prepend_len(output, chunk->str, chunk->len);
+
+        backlog->end = start;
+        if (start <= backlog->segment->records_start)
+            close_segment(backlog);
+    }
+
+    g_string_free(chunk, TRUE);
+    return read;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
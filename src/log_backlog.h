@@ -0,0 +1,39 @@
+/* Reads a buffer's history back out of it's log segments, newest first, a chunk
+ * at a time
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOG_BACKLOG_H__
+#define __LOG_BACKLOG_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+struct sqchat_log_backlog;
+
+extern struct sqchat_log_backlog * sqchat_log_backlog_new(const char * path,
+                                                          gint64 before)
+    _attr_nonnull(1);
+extern void sqchat_log_backlog_free(struct sqchat_log_backlog * backlog)
+    _attr_nonnull(1);
+
+extern unsigned int sqchat_log_backlog_read(struct sqchat_log_backlog * backlog,
+                                            unsigned int count,
+                                            GString * output)
+    _attr_nonnull(1, 3);
+
+#endif // __LOG_BACKLOG_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,336 @@
+/* Searches through log segments in the background, using a thread for each core
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_search.h"
+#include "log_segment.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// How much output gets collected before it's handed off
+#define OUTPUT_CHUNK_SIZE 4096
+
+struct sqchat_log_search {
+    /* One reference belongs to whoever started the search, the other one to
+     * the jobs that are still running
+     */
+    gint refcount;
+    gint pending_jobs;
+
+    // Once the search is cancelled, output never gets called again
+    GMutex output_mutex;
+    gint cancelled;
+    sqchat_log_search_output output;
+    void * data;
+
+    char * root;
+    gint64 since;
+    char * words[SQCHAT_LOG_SEARCH_MAX_WORDS];
+    int word_count;
+
+    gint matches;
+    gint segments;
+    gint skipped;
+};
+
+struct search_job {
+    struct sqchat_log_search * search;
+    // NULL for the job that goes looking for segments
+    char * path;
+};
+
+static GThreadPool * search_pool;
+
+static void search_unref(struct sqchat_log_search * search) {
+    if (!g_atomic_int_dec_and_test(&search->refcount))
+        return;
+
+    for (int i = 0; i < search->word_count; i++)
+        free(search->words[i]);
+    g_free(search->root);
+    g_mutex_clear(&search->output_mutex);
+    free(search);
+}
+
+static void emit(struct sqchat_log_search * search, const char * output) {
+    g_mutex_lock(&search->output_mutex);
+    if (!search->cancelled)
+        search->output(output, search->data);
+    g_mutex_unlock(&search->output_mutex);
+}
+
+static void push_job(struct sqchat_log_search * search, char * path) {
+    struct search_job * job = malloc(sizeof(struct search_job));
+
+    job->search = search;
+    job->path = path;
+
+    g_atomic_int_inc(&search->pending_jobs);
+    g_thread_pool_push(search_pool, job, NULL);
+}
+
+/* Segments are named after the day they're from, so we can tell if one is too
+ * old without opening it
+ */
+static bool segment_too_old(const char * name, gint64 since) {
+    struct tm tm = { 0 };
+
+    if (since == 0 ||
+        sscanf(name, "%4d-%2d-%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3)
+        return false;
+
+    // Figure out when the next day starts
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_mday += 1;
+    tm.tm_isdst = -1;
+
+    return (gint64)mktime(&tm) * G_USEC_PER_SEC <= since;
+}
+
+static void find_segments(struct sqchat_log_search * search,
+                          const char * path) {
+    GDir * dir = g_dir_open(path, 0, NULL);
+    const char * name;
+
+    if (dir == NULL)
+        return;
+
+    while ((name = g_dir_read_name(dir)) &&
+           !g_atomic_int_get(&search->cancelled)) {
+        char * child = g_build_filename(path, name, NULL);
+
+        if (g_file_test(child, G_FILE_TEST_IS_DIR)) {
+            find_segments(search, child);
+            g_free(child);
+        }
+        else if (g_str_has_suffix(name, SQCHAT_LOG_SEGMENT_SUFFIX) &&
+                 !segment_too_old(name, search->since))
+            push_job(search, child);
+        else
+            g_free(child);
+    }
+
+    g_dir_close(dir);
+}
+
+// Checks if every word we're looking for is in the record
+static bool record_matches(const struct sqchat_log_search * search,
+                           const struct sqchat_log_record * record) {
+    guint32 found = 0;
+    guint32 all = ((guint64)1 << search->word_count) - 1;
+    const char * pos = record->text;
+    const char * end = record->text + record->length;
+    const char * word;
+    size_t len;
+
+    while ((word = sqchat_log_next_word(&pos, end, &len))) {
+        for (int i = 0; i < search->word_count; i++) {
+            if (strlen(search->words[i]) == len &&
+                g_ascii_strncasecmp(search->words[i], word, len) == 0)
+                found |= 1u << i;
+        }
+
+        if (found == all)
+            return true;
+    }
+
+    return false;
+}
+
+static void format_result(GString * output,
+                          const char * label,
+                          const struct sqchat_log_record * record) {
+    time_t time = record->time / G_USEC_PER_SEC;
+    char timestamp[sizeof("[YYYY-MM-DD HH:MM:SS]")];
+    struct tm tm;
+
+    localtime_r(&time, &tm);
+    strftime(timestamp, sizeof(timestamp), "[%Y-%m-%d %H:%M:%S]", &tm);
+
+    g_string_append_printf(output, "%s ", timestamp);
+    if (label)
+        g_string_append_printf(output, "%s: ", label);
+    g_string_append_len(output, record->text, record->length);
+    g_string_append_c(output, '\n');
+}
+
+static void search_segment(struct sqchat_log_search * search,
+                           const char * path) {
+    struct sqchat_log_segment * segment = sqchat_log_segment_open(path, NULL);
+    struct sqchat_log_index * index;
+    const struct sqchat_log_record * record;
+    guint64 offset;
+    char * label = NULL;
+    GString * output;
+
+    if (segment == NULL)
+        return;
+
+    offset = segment->records_start;
+
+    g_atomic_int_inc(&search->segments);
+
+    /* If the segment's been closed, we can skip it entirely when it can't have
+     * what we're looking for in it
+     */
+    index = sqchat_log_index_load(path, segment->size);
+    if (index) {
+        bool skip = search->since && index->last_time < search->since;
+
+        for (int i = 0; i < search->word_count && !skip; i++) {
+            skip = !sqchat_log_index_may_contain(index, search->words[i],
+                                                 strlen(search->words[i]));
+        }
+
+        if (skip) {
+            g_atomic_int_inc(&search->skipped);
+            sqchat_log_index_free(index);
+            sqchat_log_segment_close(segment);
+            return;
+        }
+
+        if (search->since)
+            offset = sqchat_log_index_find(index, segment, search->since);
+        sqchat_log_index_free(index);
+    }
+
+    // Label results with where they're from, if we're searching more then one
+    {
+        char * dir = g_path_get_dirname(path + strlen(search->root));
+
+        if (strcmp(dir, G_DIR_SEPARATOR_S) != 0 && strcmp(dir, ".") != 0)
+            label = g_strdup(dir + 1);
+        g_free(dir);
+    }
+
+    output = g_string_new(NULL);
+    while ((record = sqchat_log_segment_next(segment, &offset)) &&
+           !g_atomic_int_get(&search->cancelled)) {
+        if (record->time < search->since || !record_matches(search, record))
+            continue;
+
+        if (g_atomic_int_add(&search->matches, 1) >=
+            SQCHAT_LOG_SEARCH_MAX_RESULTS)
+            break;
+
+        format_result(output, label, record);
+        if (output->len >= OUTPUT_CHUNK_SIZE) {
+            emit(search, output->str);
+            g_string_truncate(output, 0);
+        }
+    }
+
+    if (output->len)
+        emit(search, output->str);
+
+    g_string_free(output, TRUE);
+    g_free(label);
+    sqchat_log_segment_close(segment);
+}
+
+static void finish_search(struct sqchat_log_search * search) {
+    int matches = MIN(g_atomic_int_get(&search->matches),
+                      SQCHAT_LOG_SEARCH_MAX_RESULTS);
+    char * summary = g_strdup_printf(
+        "* Search finished: %d matches in %d log segments (%d skipped "
+        "using their index)%s\n",
+        matches, g_atomic_int_get(&search->segments),
+        g_atomic_int_get(&search->skipped),
+        matches == SQCHAT_LOG_SEARCH_MAX_RESULTS ?
+        ", stopped at the limit" : "");
+
+    emit(search, summary);
+    g_free(summary);
+}
+
+static void run_job(struct search_job * job, gpointer data) {
+    struct sqchat_log_search * search = job->search;
+
+    if (!g_atomic_int_get(&search->cancelled)) {
+        if (job->path == NULL)
+            find_segments(search, search->root);
+        else
+            search_segment(search, job->path);
+    }
+
+    if (g_atomic_int_dec_and_test(&search->pending_jobs)) {
+        finish_search(search);
+        search_unref(search);
+    }
+
+    g_free(job->path);
+    free(job);
+}
+
+/* Starts looking for messages containing every word in query in all of the
+ * segments under path. If since isn't 0, anything from before then (in
+ * microseconds since the epoch) is left out. Returns NULL if the query doesn't
+ * have any words in it.
+ */
+struct sqchat_log_search * sqchat_log_search_start(
+    const char * path,
+    gint64 since,
+    const char * query,
+    sqchat_log_search_output output,
+    void * data) {
+    struct sqchat_log_search * search;
+    const char * pos = query;
+    const char * end = query + strlen(query);
+    const char * word;
+    size_t len;
+
+    search = calloc(1, sizeof(struct sqchat_log_search));
+    while ((word = sqchat_log_next_word(&pos, end, &len)) &&
+           search->word_count < SQCHAT_LOG_SEARCH_MAX_WORDS)
+        search->words[search->word_count++] = strndup(word, len);
+
+    if (search->word_count == 0) {
+        free(search);
+        return NULL;
+    }
+
+    if (search_pool == NULL)
+        search_pool = g_thread_pool_new((GFunc)run_job, NULL,
+                                        g_get_num_processors(), FALSE, NULL);
+
+    search->refcount = 2;
+    g_mutex_init(&search->output_mutex);
+    search->output = output;
+    search->data = data;
+    search->root = g_strdup(path);
+    search->since = since;
+
+    push_job(search, NULL);
+    return search;
+}
+
+/* Stops a search, or lets go of it if it's already finished. Once this
+ * returns, the search's output function won't get called anymore.
+ */
+void sqchat_log_search_cancel(struct sqchat_log_search * search) {
+    g_mutex_lock(&search->output_mutex);
+    g_atomic_int_set(&search->cancelled, 1);
+    g_mutex_unlock(&search->output_mutex);
+
+    search_unref(search);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
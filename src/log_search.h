@@ -0,0 +1,49 @@
+/* Searches through log segments in the background, using a thread for each core
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOG_SEARCH_H__
+#define __LOG_SEARCH_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Searches stop once they've found this many matches
+#define SQCHAT_LOG_SEARCH_MAX_RESULTS 1000
+
+// The most words a single search can look for
+#define SQCHAT_LOG_SEARCH_MAX_WORDS 32
+
+struct sqchat_log_search;
+
+/* Gets called with results as they're found, and once more with a summary when
+ * the search is finished. This is called from the search threads, but never
+ * from more then one at a time.
+ */
+typedef void (*sqchat_log_search_output)(const char * output, void * data);
+
+extern struct sqchat_log_search * sqchat_log_search_start(
+    const char * path,
+    gint64 since,
+    const char * query,
+    sqchat_log_search_output output,
+    void * data)
+    _attr_nonnull(1, 3, 4);
+extern void sqchat_log_search_cancel(struct sqchat_log_search * search)
+    _attr_nonnull(1);
+
+#endif // __LOG_SEARCH_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
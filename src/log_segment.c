@@ -0,0 +1,378 @@
+/* The binary format logs are kept in for searching through them
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_segment.h"
+#include "text_style.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nicknames and channel names count as words too, so anything that can be in
+ * one of those is part of a word. Bytes over 0x7f are part of UTF-8 sequences,
+ * so those are as well.
+ */
+static inline bool is_word_char(unsigned char c) {
+    return g_ascii_isalnum(c) || c >= 0x80 || strchr("[]\\`_^{|}-#&", c);
+}
+
+// Skips the "fg,bg" after a color code, each of which is up to two digits
+static const char * skip_color_numbers(const char * c, const char * end) {
+    for (int i = 0; i < 2 && c < end && g_ascii_isdigit(*c); i++, c++);
+    if (c + 1 < end && *c == ',' && g_ascii_isdigit(c[1])) {
+        c++;
+        for (int i = 0; i < 2 && c < end && g_ascii_isdigit(*c); i++, c++);
+    }
+
+    return c;
+}
+
+/* Finds the next word between *pos and end, and moves *pos past it. Returns
+ * NULL once there aren't any words left.
+ */
+const char * sqchat_log_next_word(const char ** pos,
+                                  const char * end,
+                                  size_t * len) {
+    const char * start = *pos;
+    const char * c;
+
+    while (start < end && (*start == '\0' || !is_word_char(*start))) {
+        /* The numbers after a color code would otherwise get stuck onto the
+         * front of the word that's being colored
+         */
+        if (*start++ == SQCHAT_COLOR_CODE)
+            start = skip_color_numbers(start, end);
+    }
+    for (c = start; c < end && *c != '\0' && is_word_char(*c); c++);
+
+    *pos = c;
+    *len = c - start;
+    return *len ? start : NULL;
+}
+
+// FNV-1a, done case-insensitively so searches don't have to care about case
+static guint64 hash_word(const char * word, size_t len) {
+    guint64 hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (guint8)g_ascii_tolower(word[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* Each of the bloom filter's bits for a word come from combining the two
+ * halves of it's hash
+ */
+static inline guint32 bloom_bit(guint64 hash, int i) {
+    guint32 a = hash;
+    guint32 b = (hash >> 32) | 1;
+
+    return (a + i * b) % SQCHAT_LOG_BLOOM_BITS;
+}
+
+void sqchat_log_record_encode(GString * output,
+                              gint64 time,
+                              const char * text,
+                              size_t len) {
+    struct sqchat_log_record record = {
+        .time = time,
+        .length = len,
+        .reserved = 0
+    };
+    static const char padding[8];
+
+    g_string_append_len(output, (const char*)&record, sizeof(record));
+    g_string_append_len(output, text, len);
+    g_string_append_len(output, padding,
+                        sqchat_log_record_size(len) - sizeof(record) - len);
+}
+
+struct sqchat_log_index * sqchat_log_index_new() {
+    struct sqchat_log_index * index =
+        calloc(1, sizeof(struct sqchat_log_index));
+
+    index->entries = g_array_new(FALSE, FALSE,
+                                 sizeof(struct sqchat_log_index_entry));
+    return index;
+}
+
+void sqchat_log_index_free(struct sqchat_log_index * index) {
+    g_array_free(index->entries, TRUE);
+    free(index);
+}
+
+/* Adds a record that starts at offset in the segment to the time index, but
+ * leaves it's words out of the bloom filter
+ */
+void sqchat_log_index_add_time(struct sqchat_log_index * index,
+                               const struct sqchat_log_record * record,
+                               guint64 offset) {
+    if (index->record_count == 0 ||
+        offset - index->last_indexed_offset >= SQCHAT_LOG_INDEX_INTERVAL) {
+        struct sqchat_log_index_entry entry = {
+            .time = record->time,
+            .offset = offset
+        };
+
+        g_array_append_val(index->entries, entry);
+        index->last_indexed_offset = offset;
+    }
+
+    if (index->record_count == 0)
+        index->first_time = record->time;
+    index->last_time = record->time;
+    index->record_count++;
+}
+
+// Adds a record that starts at offset in the segment to the index
+void sqchat_log_index_add(struct sqchat_log_index * index,
+                          const struct sqchat_log_record * record,
+                          guint64 offset) {
+    const char * pos = record->text;
+    const char * end = record->text + record->length;
+    const char * word;
+    size_t len;
+
+    sqchat_log_index_add_time(index, record, offset);
+
+    while ((word = sqchat_log_next_word(&pos, end, &len))) {
+        guint64 hash = hash_word(word, len);
+
+        for (int i = 0; i < SQCHAT_LOG_BLOOM_HASHES; i++) {
+            guint32 bit = bloom_bit(hash, i);
+            index->bloom[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+// Returns false if the word definitely isn't anywhere in the segment
+bool sqchat_log_index_may_contain(const struct sqchat_log_index * index,
+                                  const char * word,
+                                  size_t len) {
+    guint64 hash = hash_word(word, len);
+
+    for (int i = 0; i < SQCHAT_LOG_BLOOM_HASHES; i++) {
+        guint32 bit = bloom_bit(hash, i);
+
+        if (!(index->bloom[bit / 8] & (1 << (bit % 8))))
+            return false;
+    }
+
+    return true;
+}
+
+/* Finds where to start reading the segment from to get every record from the
+ * given time onwards
+ */
+guint64 sqchat_log_index_find(const struct sqchat_log_index * index,
+                              const struct sqchat_log_segment * segment,
+                              gint64 time) {
+    const struct sqchat_log_index_entry * entries =
+        (struct sqchat_log_index_entry*)index->entries->data;
+    guint low = 0;
+    guint high = index->entries->len;
+
+    // Look for the last entry from before the time we want
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+
+        if (entries[mid].time < time)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0)
+        return segment->records_start;
+    return entries[low - 1].offset;
+}
+
+static char * index_path(const char * segment_path) {
+    return g_strconcat(segment_path, SQCHAT_LOG_INDEX_SUFFIX, NULL);
+}
+
+bool sqchat_log_index_save(const struct sqchat_log_index * index,
+                           const char * segment_path,
+                           guint64 segment_size) {
+    struct sqchat_log_index_header header = {
+        .magic = SQCHAT_LOG_INDEX_MAGIC,
+        .version = SQCHAT_LOG_SEGMENT_VERSION,
+        .entry_count = index->entries->len,
+        .segment_size = segment_size,
+        .record_count = index->record_count,
+        .first_time = index->first_time,
+        .last_time = index->last_time
+    };
+    GString * data = g_string_sized_new(sizeof(header) + sizeof(index->bloom) +
+                                        index->entries->len *
+                                        sizeof(struct sqchat_log_index_entry));
+    char * path = index_path(segment_path);
+    bool success;
+
+    g_string_append_len(data, (const char*)&header, sizeof(header));
+    g_string_append_len(data, (const char*)index->bloom, sizeof(index->bloom));
+    g_string_append_len(data, index->entries->data,
+                        index->entries->len *
+                        sizeof(struct sqchat_log_index_entry));
+
+    success = g_file_set_contents(path, data->str, data->len, NULL);
+
+    g_string_free(data, TRUE);
+    g_free(path);
+    return success;
+}
+
+/* Loads the index for a segment, as long as it's there and matches the size the
+ * segment is now. Returns NULL otherwise.
+ */
+struct sqchat_log_index * sqchat_log_index_load(const char * segment_path,
+                                                guint64 segment_size) {
+    struct sqchat_log_index * index = NULL;
+    struct sqchat_log_index_header header;
+    char * path = index_path(segment_path);
+    char * data;
+    gsize len;
+
+    if (!g_file_get_contents(path, &data, &len, NULL)) {
+        g_free(path);
+        return NULL;
+    }
+
+    if (len < sizeof(header) + sizeof(index->bloom))
+        goto out;
+
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SQCHAT_LOG_INDEX_MAGIC,
+               sizeof(header.magic)) != 0 ||
+        header.version != SQCHAT_LOG_SEGMENT_VERSION ||
+        header.segment_size != segment_size ||
+        len != sizeof(header) + sizeof(index->bloom) +
+               header.entry_count * sizeof(struct sqchat_log_index_entry))
+        goto out;
+
+    index = sqchat_log_index_new();
+    memcpy(index->bloom, data + sizeof(header), sizeof(index->bloom));
+    g_array_append_vals(index->entries,
+                        data + sizeof(header) + sizeof(index->bloom),
+                        header.entry_count);
+
+    index->record_count = header.record_count;
+    index->first_time = header.first_time;
+    index->last_time = header.last_time;
+    if (header.entry_count != 0)
+        index->last_indexed_offset =
+            g_array_index(index->entries, struct sqchat_log_index_entry,
+                          header.entry_count - 1).offset;
+
+out:
+    g_free(data);
+    g_free(path);
+    return index;
+}
+
+struct sqchat_log_segment * sqchat_log_segment_open(const char * path,
+                                                    GError ** error) {
+    struct sqchat_log_segment * segment;
+    GMappedFile * file = g_mapped_file_new(path, FALSE, error);
+    const struct sqchat_log_segment_header * header;
+
+    if (file == NULL)
+        return NULL;
+
+    header = (const struct sqchat_log_segment_header*)
+        g_mapped_file_get_contents(file);
+    if (g_mapped_file_get_length(file) < sizeof(*header) ||
+        memcmp(header->magic, SQCHAT_LOG_SEGMENT_MAGIC,
+               sizeof(header->magic)) != 0 ||
+        header->version != SQCHAT_LOG_SEGMENT_VERSION ||
+        header->header_size < sizeof(*header) ||
+        header->header_size > g_mapped_file_get_length(file) ||
+        header->header_size % 8 != 0) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "%s isn't a log segment", path);
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    segment = malloc(sizeof(struct sqchat_log_segment));
+    segment->file = file;
+    segment->data = (const char*)header;
+    segment->size = g_mapped_file_get_length(file);
+    segment->records_start = header->header_size;
+
+    return segment;
+}
+
+void sqchat_log_segment_close(struct sqchat_log_segment * segment) {
+    g_mapped_file_unref(segment->file);
+    free(segment);
+}
+
+/* Returns the record at *offset and moves *offset to the one after it, or
+ * returns NULL if there aren't any complete records left. Start from
+ * sqchat_log_index_find() to skip everything from before a certain time.
+ */
+const struct sqchat_log_record * sqchat_log_segment_next(
+    const struct sqchat_log_segment * segment,
+    guint64 * offset) {
+    const struct sqchat_log_record * record;
+
+    /* The segment might still be getting written to, so the last record could
+     * be cut off
+     */
+    if (*offset + sizeof(struct sqchat_log_record) > segment->size)
+        return NULL;
+
+    record = (const struct sqchat_log_record*)(segment->data + *offset);
+    if (*offset + sizeof(struct sqchat_log_record) + record->length >
+        segment->size)
+        return NULL;
+
+    *offset += sqchat_log_record_size(record->length);
+    return record;
+}
+
+/* For segments that never got their index written, like after a crash, or that
+ * are still being written to. end is set to where the last complete record in
+ * the segment ends. Hashing every word for the bloom filter is most of the
+ * work, so it's skipped unless with_bloom is set. Without it, the index is only
+ * good for finding records by time and can't be used for searching.
+ */
+struct sqchat_log_index * sqchat_log_segment_build_index(
+    const struct sqchat_log_segment * segment,
+    guint64 * end,
+    bool with_bloom) {
+    struct sqchat_log_index * index = sqchat_log_index_new();
+    const struct sqchat_log_record * record;
+    guint64 offset = segment->records_start;
+    guint64 record_offset = offset;
+
+    while ((record = sqchat_log_segment_next(segment, &offset))) {
+        if (with_bloom)
+            sqchat_log_index_add(index, record, record_offset);
+        else
+            sqchat_log_index_add_time(index, record, record_offset);
+        record_offset = offset;
+    }
+
+    *end = record_offset;
+    return index;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,160 @@
+/* The binary format logs are kept in for searching through them. Each segment
+ * is a stream of timestamped records, and gets a small index file written next
+ * to it once it's finished with a sparse index of record times and a bloom
+ * filter of every word in it. Segments are memory-mapped for reading.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOG_SEGMENT_H__
+#define __LOG_SEGMENT_H__
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SQCHAT_LOG_SEGMENT_MAGIC    "SQLOGSEG"
+#define SQCHAT_LOG_INDEX_MAGIC      "SQLOGIDX"
+#define SQCHAT_LOG_SEGMENT_VERSION  1
+
+#define SQCHAT_LOG_SEGMENT_SUFFIX   ".seg"
+#define SQCHAT_LOG_INDEX_SUFFIX     ".idx"
+
+// How far apart (in bytes) the entries in the time index are, roughly
+#define SQCHAT_LOG_INDEX_INTERVAL   4096
+
+/* The size of each segment's bloom filter in bits, and how many bits get set
+ * for each word
+ */
+#define SQCHAT_LOG_BLOOM_BITS       (128 * 1024)
+#define SQCHAT_LOG_BLOOM_HASHES     4
+
+/* Everything on the disk is in the host's byte order. The records start
+ * header_size bytes into the segment, which leaves room for the header to grow
+ * without bumping the version.
+ */
+struct sqchat_log_segment_header {
+    char magic[8];
+    guint32 version;
+    guint32 header_size;
+};
+
+/* Each record is followed by it's text (which isn't null terminated), and then
+ * padding up to the next multiple of 8 bytes
+ */
+struct sqchat_log_record {
+    gint64 time; // Microseconds since the epoch
+    guint32 length;
+    guint32 reserved;
+    char text[];
+};
+
+struct sqchat_log_index_header {
+    char magic[8];
+    guint32 version;
+    guint32 entry_count;
+
+    // If the segment isn't this big anymore, the index is out of date
+    guint64 segment_size;
+    guint64 record_count;
+    gint64 first_time;
+    gint64 last_time;
+};
+
+struct sqchat_log_index_entry {
+    gint64 time;
+    guint64 offset;
+};
+
+// The index of a segment, either as it's being written or once it's loaded
+struct sqchat_log_index {
+    guint8 bloom[SQCHAT_LOG_BLOOM_BITS / 8];
+    GArray * entries;
+
+    guint64 record_count;
+    gint64 first_time;
+    gint64 last_time;
+    guint64 last_indexed_offset;
+};
+
+struct sqchat_log_segment {
+    GMappedFile * file;
+    const char * data;
+    gsize size;
+
+    // Where the first record is, from the header
+    guint64 records_start;
+};
+
+static inline gsize sqchat_log_record_size(guint32 length) {
+    return (sizeof(struct sqchat_log_record) + length + 7) & ~(gsize)7;
+}
+
+extern const char * sqchat_log_next_word(const char ** pos,
+                                         const char * end,
+                                         size_t * len)
+    _attr_nonnull(1, 2, 3);
+
+extern void sqchat_log_record_encode(GString * output,
+                                     gint64 time,
+                                     const char * text,
+                                     size_t len)
+    _attr_nonnull(1, 3);
+
+extern struct sqchat_log_index * sqchat_log_index_new();
+extern void sqchat_log_index_free(struct sqchat_log_index * index)
+    _attr_nonnull(1);
+extern void sqchat_log_index_add_time(struct sqchat_log_index * index,
+                                      const struct sqchat_log_record * record,
+                                      guint64 offset)
+    _attr_nonnull(1, 2);
+extern void sqchat_log_index_add(struct sqchat_log_index * index,
+                                 const struct sqchat_log_record * record,
+                                 guint64 offset)
+    _attr_nonnull(1, 2);
+extern bool sqchat_log_index_may_contain(const struct sqchat_log_index * index,
+                                         const char * word,
+                                         size_t len)
+    _attr_nonnull(1, 2);
+extern guint64 sqchat_log_index_find(const struct sqchat_log_index * index,
+                                     const struct sqchat_log_segment * segment,
+                                     gint64 time)
+    _attr_nonnull(1, 2);
+extern bool sqchat_log_index_save(const struct sqchat_log_index * index,
+                                  const char * segment_path,
+                                  guint64 segment_size)
+    _attr_nonnull(1, 2);
+extern struct sqchat_log_index * sqchat_log_index_load(
+    const char * segment_path,
+    guint64 segment_size)
+    _attr_nonnull(1);
+
+extern struct sqchat_log_segment * sqchat_log_segment_open(const char * path,
+                                                           GError ** error)
+    _attr_nonnull(1);
+extern void sqchat_log_segment_close(struct sqchat_log_segment * segment)
+    _attr_nonnull(1);
+extern const struct sqchat_log_record * sqchat_log_segment_next(
+    const struct sqchat_log_segment * segment,
+    guint64 * offset)
+    _attr_nonnull(1, 2);
+extern struct sqchat_log_index * sqchat_log_segment_build_index(
+    const struct sqchat_log_segment * segment,
+    guint64 * end,
+    bool with_bloom)
+    _attr_nonnull(1, 2);
+
+#endif // __LOG_SEGMENT_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
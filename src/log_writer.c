@@ -0,0 +1,665 @@
+/* Writes everything printed to a buffer out to log files on the disk. All of
+ * the actual writing is done by a background thread, so logging something
+ * never has to wait on the disk.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_writer.h"
+#include "log_segment.h"
+#include "stats.h"
+#include "text_style.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+struct sqchat_log {
+    // Everything in here is only ever touched by the writer thread
+    char * network;
+    char * name;
+
+    int fd;
+    char date[sizeof("YYYY-MM-DD")];
+    unsigned int part;
+    gint64 size;
+    GList * open_link;
+
+    /* The segment everything gets written to as well, so it can be searched.
+     * seg_fd is -1 if we couldn't open it.
+     */
+    int seg_fd;
+    char * seg_path;
+    guint64 seg_size;
+    struct sqchat_log_index * index;
+
+    // Whatever's been written since the last time the log was fsync'd
+    bool dirty;
+    // So we don't complain about the same log over and over again
+    bool failed;
+    bool at_line_start;
+
+    // Data waiting to be written out at the end of the current batch
+    GString * pending;
+    GString * seg_pending;
+    bool on_pending_list;
+    struct sqchat_log * next_pending;
+};
+
+struct log_record {
+    enum {
+        LOG_WRITE,
+        LOG_SET_NETWORK,
+        LOG_CLOSE
+    } type;
+
+    struct sqchat_log * log;
+    gint64 time;
+    size_t len;
+    struct log_record * next;
+    char msg[];
+};
+
+/* Anything can queue records, the writer thread takes the whole queue at once
+ * and writes it out in one go
+ */
+static GMutex queue_mutex;
+static GCond queue_cond;
+static struct log_record * queue;
+static struct log_record * queue_end;
+static size_t queue_size;
+static bool running;
+static bool quitting;
+
+static GThread * writer_thread;
+static char * log_dir;
+static gint64 log_max_size;
+static int log_fsync_interval;
+
+// Only touched by the writer thread
+static GList * open_logs;
+static bool dirty_logs;
+
+// Directory names aren't allowed to have slashes in them, or start with a dot
+static char * sanitize_name(const char * name) {
+    char * sanitized = g_ascii_strdown(name, -1);
+
+    for (char * c = sanitized; *c != '\0'; c++) {
+        if (*c == '/' || (*c == '.' && c == sanitized))
+            *c = '_';
+    }
+
+    return sanitized;
+}
+
+static void free_log(struct sqchat_log * log) {
+    g_free(log->network);
+    g_free(log->name);
+    g_string_free(log->pending, TRUE);
+    g_string_free(log->seg_pending, TRUE);
+    free(log);
+}
+
+static void write_all(int fd, const char * data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        data += written;
+        len -= written;
+    }
+}
+
+// Closes the log's segment, and writes out the index for it
+static void close_segment(struct sqchat_log * log) {
+    if (log->seg_fd == -1)
+        return;
+
+    if (log->dirty && log_fsync_interval >= 0)
+        fdatasync(log->seg_fd);
+    close(log->seg_fd);
+
+    sqchat_log_index_save(log->index, log->seg_path, log->seg_size);
+    sqchat_log_index_free(log->index);
+    g_free(log->seg_path);
+
+    log->seg_fd = -1;
+    log->seg_path = NULL;
+    log->index = NULL;
+}
+
+static void close_file(struct sqchat_log * log) {
+    if (log->fd == -1)
+        return;
+
+    close_segment(log);
+
+    if (log->dirty && log_fsync_interval >= 0)
+        fdatasync(log->fd);
+    close(log->fd);
+
+    open_logs = g_list_delete_link(open_logs, log->open_link);
+    log->open_link = NULL;
+    log->fd = -1;
+    log->dirty = false;
+}
+
+/* Opens the segment that goes with the log file at path, which is named the
+ * same way. If it's left over from before, we pick up where it left off.
+ */
+static void open_segment(struct sqchat_log * log, const char * path) {
+    char * base = g_strndup(path, strlen(path) - strlen(".log"));
+    struct stat file_stat;
+
+    log->seg_path = g_strconcat(base, SQCHAT_LOG_SEGMENT_SUFFIX, NULL);
+    g_free(base);
+
+    log->seg_fd = open(log->seg_path,
+                       O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (log->seg_fd == -1 || fstat(log->seg_fd, &file_stat) == -1)
+        goto error;
+
+    if (file_stat.st_size == 0) {
+        struct sqchat_log_segment_header header = {
+            .magic = SQCHAT_LOG_SEGMENT_MAGIC,
+            .version = SQCHAT_LOG_SEGMENT_VERSION,
+            .header_size = sizeof(header)
+        };
+
+        write_all(log->seg_fd, (const char*)&header, sizeof(header));
+        log->seg_size = sizeof(header);
+        log->index = sqchat_log_index_new();
+        return;
+    }
+
+    log->seg_size = file_stat.st_size;
+    log->index = sqchat_log_index_load(log->seg_path, log->seg_size);
+
+    // The index is out of date if we never got to close the segment properly
+    if (log->index == NULL) {
+        struct sqchat_log_segment * segment =
+            sqchat_log_segment_open(log->seg_path, NULL);
+        guint64 end;
+
+        if (segment == NULL)
+            goto error;
+
+        log->index = sqchat_log_segment_build_index(segment, &end, true);
+        sqchat_log_segment_close(segment);
+
+        // Get rid of any record that only got partially written
+        if (end != log->seg_size) {
+            if (ftruncate(log->seg_fd, end) == -1)
+                goto error;
+            log->seg_size = end;
+        }
+    }
+
+    return;
+
+error:
+    if (!log->failed)
+        g_warning("Couldn't open log segment %s: %s", log->seg_path,
+                  g_strerror(errno));
+
+    if (log->seg_fd != -1)
+        close(log->seg_fd);
+    if (log->index)
+        sqchat_log_index_free(log->index);
+    g_free(log->seg_path);
+
+    log->seg_fd = -1;
+    log->seg_path = NULL;
+    log->index = NULL;
+}
+
+/* Opens the file for the log's current date, moving on to the next part if the
+ * current one is already full
+ */
+static bool open_file(struct sqchat_log * log) {
+    char * dir = g_build_filename(log_dir,
+                                  log->network ? log->network : "unknown",
+                                  log->name, NULL);
+    char * path = NULL;
+    struct stat file_stat;
+
+    if (g_mkdir_with_parents(dir, 0700) == -1)
+        goto error;
+
+    while (true) {
+        char * file_name = log->part == 0 ?
+            g_strdup_printf("%s.log", log->date) :
+            g_strdup_printf("%s.%u.log", log->date, log->part);
+
+        g_free(path);
+        path = g_build_filename(dir, file_name, NULL);
+        g_free(file_name);
+
+        log->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (log->fd == -1 || fstat(log->fd, &file_stat) == -1)
+            goto error;
+
+        if (log_max_size == 0 || file_stat.st_size < log_max_size)
+            break;
+
+        close(log->fd);
+        log->part++;
+    }
+
+    log->size = file_stat.st_size;
+    open_logs = g_list_prepend(open_logs, log);
+    log->open_link = open_logs;
+
+    open_segment(log, path);
+
+    g_free(dir);
+    g_free(path);
+    return true;
+
+error:
+    if (!log->failed)
+        g_warning("Couldn't open log file %s: %s", path ? path : dir,
+                  g_strerror(errno));
+    log->failed = true;
+
+    if (log->fd != -1)
+        close(log->fd);
+    log->fd = -1;
+
+    g_free(dir);
+    g_free(path);
+    return false;
+}
+
+// Adds everything waiting to be written to the segment to it's index
+static void index_pending(struct sqchat_log * log) {
+    gsize pos = 0;
+
+    while (pos < log->seg_pending->len) {
+        const struct sqchat_log_record * record =
+            (struct sqchat_log_record*)(log->seg_pending->str + pos);
+
+        sqchat_log_index_add(log->index, record, log->seg_size + pos);
+        pos += sqchat_log_record_size(record->length);
+    }
+}
+
+static void flush_log(struct sqchat_log * log) {
+    if (log->pending->len == 0)
+        return;
+
+    if (log->fd == -1 && !open_file(log))
+        goto out;
+
+    // Start a new part if this would push the current one over the limit
+    if (log_max_size != 0 && log->size != 0 &&
+        log->size + log->pending->len > log_max_size) {
+        close_file(log);
+        log->part++;
+
+        if (!open_file(log))
+            goto out;
+    }
+
+    write_all(log->fd, log->pending->str, log->pending->len);
+    g_atomic_pointer_add(&sqchat_stats.log_bytes_written, log->pending->len);
+
+    if (log->seg_fd != -1) {
+        index_pending(log);
+        write_all(log->seg_fd, log->seg_pending->str, log->seg_pending->len);
+        g_atomic_pointer_add(&sqchat_stats.log_bytes_written,
+                             log->seg_pending->len);
+
+        log->seg_size += log->seg_pending->len;
+    }
+
+    log->size += log->pending->len;
+    log->dirty = true;
+    dirty_logs = true;
+
+out:
+    g_string_truncate(log->pending, 0);
+    g_string_truncate(log->seg_pending, 0);
+}
+
+static void sync_logs() {
+    for (GList * l = open_logs; l != NULL; l = l->next) {
+        struct sqchat_log * log = l->data;
+
+        if (log->dirty) {
+            fdatasync(log->fd);
+            if (log->seg_fd != -1)
+                fdatasync(log->seg_fd);
+            log->dirty = false;
+        }
+    }
+
+    dirty_logs = false;
+}
+
+static void append_plain_span(const char * text,
+                              size_t len,
+                              const struct sqchat_text_style * style,
+                              void * data) {
+    g_string_append_len(data, text, len);
+}
+
+/* Adds a record to the data waiting to be written to it's log, and timestamps
+ * the start of every line in it. The text logs are meant to be read by hand, so
+ * they get the formatting codes (nickname colors included) stripped out. The
+ * segments keep them, so the backlog looks the same as it did when printed.
+ */
+static void append_record(struct log_record * record,
+                          struct sqchat_log ** pending) {
+    struct sqchat_log * log = record->log;
+    time_t time = record->time / G_USEC_PER_SEC;
+    char date[sizeof(log->date)];
+    struct tm tm;
+    const char * line = record->msg;
+    const char * end = record->msg + record->len;
+
+    if (record->len == 0)
+        return;
+
+    localtime_r(&time, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+
+    // Rotate the log when the day changes
+    if (strcmp(date, log->date) != 0) {
+        flush_log(log);
+        close_file(log);
+
+        strcpy(log->date, date);
+        log->part = 0;
+        log->failed = false;
+    }
+
+    if (!log->on_pending_list) {
+        log->on_pending_list = true;
+        log->next_pending = *pending;
+        *pending = log;
+    }
+
+    while (line < end) {
+        const char * line_end = memchr(line, '\n', end - line);
+
+        line_end = line_end ? line_end + 1 : end;
+
+        if (log->at_line_start)
+            g_string_append_printf(log->pending, "[%02d:%02d:%02d] ",
+                                   tm.tm_hour, tm.tm_min, tm.tm_sec);
+        sqchat_text_style_parse(line, line_end - line, append_plain_span,
+                                log->pending);
+
+        log->at_line_start = line_end[-1] == '\n';
+        line = line_end;
+    }
+
+    // Segments get each message as it's own record, minus the last newline
+    sqchat_log_record_encode(log->seg_pending, record->time, record->msg,
+                             end[-1] == '\n' ? record->len - 1 : record->len);
+}
+
+static void write_batch(struct log_record * batch) {
+    struct sqchat_log * pending = NULL;
+    GSList * closed = NULL;
+    struct log_record * next;
+
+    for (struct log_record * r = batch; r != NULL; r = next) {
+        next = r->next;
+
+        switch (r->type) {
+            case LOG_WRITE:
+                append_record(r, &pending);
+                break;
+            case LOG_SET_NETWORK:
+                flush_log(r->log);
+                close_file(r->log);
+
+                g_free(r->log->network);
+                r->log->network = sanitize_name(r->msg);
+                r->log->failed = false;
+                break;
+            case LOG_CLOSE:
+                flush_log(r->log);
+                close_file(r->log);
+
+                // It might still be on the pending list, so free it later
+                closed = g_slist_prepend(closed, r->log);
+                break;
+        }
+
+        free(r);
+    }
+
+    // Write everything out, one write per log
+    for (struct sqchat_log * log = pending; log != NULL;
+         log = log->next_pending) {
+        flush_log(log);
+        log->on_pending_list = false;
+    }
+
+    g_slist_free_full(closed, (GDestroyNotify)free_log);
+}
+
+static gpointer writer_main(gpointer data) {
+    struct log_record * batch;
+    gint64 next_sync = -1;
+    bool quit;
+
+    while (true) {
+        g_mutex_lock(&queue_mutex);
+        while (queue == NULL && !quitting) {
+            if (next_sync == -1)
+                g_cond_wait(&queue_cond, &queue_mutex);
+            else if (!g_cond_wait_until(&queue_cond, &queue_mutex, next_sync))
+                break;
+        }
+
+        batch = queue;
+        queue = NULL;
+        queue_end = NULL;
+        queue_size = 0;
+        quit = quitting;
+        g_mutex_unlock(&queue_mutex);
+
+        if (batch != NULL) {
+            gint64 start = sqchat_stats_now();
+
+            write_batch(batch);
+            sqchat_histogram_add(&sqchat_stats.log_write_time,
+                                 sqchat_stats_now() - start);
+        }
+
+        // fsync everything that's been written in one go, instead of per-file
+        if (log_fsync_interval == 0 || (quit && log_fsync_interval > 0)) {
+            if (dirty_logs)
+                sync_logs();
+        }
+        else if (log_fsync_interval > 0 && dirty_logs) {
+            gint64 now = g_get_monotonic_time();
+
+            if (next_sync == -1)
+                next_sync = now + log_fsync_interval * G_TIME_SPAN_SECOND;
+            else if (now >= next_sync) {
+                sync_logs();
+                next_sync = -1;
+            }
+        }
+
+        if (quit)
+            break;
+    }
+
+    // Close any logs that are still open, the buffers keep the handles
+    while (open_logs != NULL)
+        close_file(open_logs->data);
+
+    return NULL;
+}
+
+void sqchat_log_writer_init(const char * directory,
+                            gint64 max_size,
+                            int fsync_interval) {
+    log_dir = g_strdup(directory);
+    log_max_size = max_size;
+    log_fsync_interval = fsync_interval;
+
+    running = true;
+    writer_thread = g_thread_new("Log writer", writer_main, NULL);
+}
+
+// Writes out whatever's still queued and stops the writer thread
+void sqchat_log_writer_shutdown() {
+    if (writer_thread == NULL)
+        return;
+
+    g_mutex_lock(&queue_mutex);
+    running = false;
+    quitting = true;
+    g_cond_signal(&queue_cond);
+    g_mutex_unlock(&queue_mutex);
+
+    g_thread_join(writer_thread);
+    writer_thread = NULL;
+}
+
+static void queue_record(struct log_record * record) {
+    g_mutex_lock(&queue_mutex);
+
+    if (!running) {
+        g_mutex_unlock(&queue_mutex);
+
+        // The writer's gone, so nothing else is going to free the log
+        if (record->type == LOG_CLOSE)
+            free_log(record->log);
+        free(record);
+        return;
+    }
+
+    // Never make the caller wait on the disk, just drop the line if we have to
+    if (record->type == LOG_WRITE &&
+        queue_size + record->len > SQCHAT_LOG_QUEUE_MAX) {
+        g_mutex_unlock(&queue_mutex);
+
+        g_atomic_pointer_add(&sqchat_stats.log_lines_dropped, 1);
+        free(record);
+        return;
+    }
+
+    if (queue == NULL)
+        queue = record;
+    else
+        queue_end->next = record;
+    queue_end = record;
+    queue_size += record->len;
+
+    g_cond_signal(&queue_cond);
+    g_mutex_unlock(&queue_mutex);
+}
+
+static struct log_record * new_record(int type,
+                                      struct sqchat_log * log,
+                                      const char * msg,
+                                      size_t len) {
+    struct log_record * record = malloc(sizeof(struct log_record) + len + 1);
+
+    record->type = type;
+    record->log = log;
+    record->time = g_get_real_time();
+    record->len = len;
+    record->next = NULL;
+    memcpy(record->msg, msg, len);
+    record->msg[len] = '\0';
+
+    return record;
+}
+
+/* Returns the directory the logs for a buffer are kept in, or the directory for
+ * the whole network if name is NULL, or the directory for every network if
+ * network is NULL as well. Returns NULL if logging isn't turned on. The result
+ * should be freed with g_free().
+ */
+char * sqchat_log_path(const char * network, const char * name) {
+    char * network_dir;
+    char * name_dir;
+    char * path;
+
+    if (!running)
+        return NULL;
+    else if (network == NULL)
+        return g_strdup(log_dir);
+
+    network_dir = sanitize_name(network);
+    name_dir = name ? sanitize_name(name) : NULL;
+    path = g_build_filename(log_dir, network_dir, name_dir, NULL);
+
+    g_free(network_dir);
+    g_free(name_dir);
+    return path;
+}
+
+/* Makes a new log for a buffer. network can be NULL if we don't know what the
+ * network is called yet, and name should be NULL for the network's own buffer.
+ * Returns NULL if logging isn't turned on.
+ */
+struct sqchat_log * sqchat_log_open(const char * network, const char * name) {
+    struct sqchat_log * log;
+
+    if (!running)
+        return NULL;
+
+    log = calloc(1, sizeof(struct sqchat_log));
+    log->network = network ? sanitize_name(network) : NULL;
+    log->name = sanitize_name(name ? name : SQCHAT_LOG_SERVER_NAME);
+    log->fd = -1;
+    log->seg_fd = -1;
+    log->at_line_start = true;
+    log->pending = g_string_new(NULL);
+    log->seg_pending = g_string_new(NULL);
+
+    return log;
+}
+
+void sqchat_log_write(struct sqchat_log * log, const char * msg, size_t len) {
+    queue_record(new_record(LOG_WRITE, log, msg, len));
+}
+
+/* Moves the log to a different network's directory, for when we find out what
+ * the network is actually called
+ */
+void sqchat_log_set_network(struct sqchat_log * log, const char * network) {
+    queue_record(new_record(LOG_SET_NETWORK, log, network, strlen(network)));
+}
+
+/* Writes out anything left in the log and closes it. The log can't be used
+ * again after this.
+ */
+void sqchat_log_close(struct sqchat_log * log) {
+    queue_record(new_record(LOG_CLOSE, log, "", 0));
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,66 @@
+/* Writes everything printed to a buffer out to log files on the disk. All of
+ * the actual writing is done by a background thread, so logging something
+ * never has to wait on the disk.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOG_WRITER_H__
+#define __LOG_WRITER_H__
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* If the writer falls this far behind (in bytes), new lines get dropped
+ * instead of letting the queue grow forever
+ */
+#define SQCHAT_LOG_QUEUE_MAX (8 * 1024 * 1024)
+
+// What the log for a network's own buffer is called
+#define SQCHAT_LOG_SERVER_NAME "(server)"
+
+// Handles are only ever freed by the writer thread, after sqchat_log_close()
+struct sqchat_log;
+
+/* Starts the writer thread. Logs end up in
+ * <directory>/<network>/<buffer>/<date>.log as plain text, without any
+ * formatting codes. Once a log goes over max_size bytes it gets continued in
+ * <date>.1.log, <date>.2.log, and so on (a max_size of 0 means there's no
+ * limit). Logs are fsync'd every fsync_interval seconds, after every batch of
+ * writes if it's 0, or never if it's negative.
+ */
+extern void sqchat_log_writer_init(const char * directory,
+                                   gint64 max_size,
+                                   int fsync_interval)
+    _attr_nonnull(1);
+extern void sqchat_log_writer_shutdown();
+
+extern char * sqchat_log_path(const char * network, const char * name);
+
+extern struct sqchat_log * sqchat_log_open(const char * network,
+                                           const char * name);
+extern void sqchat_log_write(struct sqchat_log * log,
+                             const char * msg,
+                             size_t len)
+    _attr_nonnull(1, 2);
+extern void sqchat_log_set_network(struct sqchat_log * log,
+                                   const char * network)
+    _attr_nonnull(1);
+extern void sqchat_log_close(struct sqchat_log * log)
+    _attr_nonnull(1);
+
+#endif // __LOG_WRITER_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
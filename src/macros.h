@@ -20,5 +20,12 @@
 #define SQCHAT_IRC_MSG_LEN 512
 #define SQCHAT_MSG_BUF_LEN 513
 
+/* A single TLS record can carry up to 16KiB of data. The receive buffer is big
+ * enough to hold an entire record on top of a partially received message, so
+ * records never have to be read out in pieces
+ */
+#define SQCHAT_TLS_RECORD_LEN 16384
+#define SQCHAT_RECV_BUF_LEN (SQCHAT_TLS_RECORD_LEN + SQCHAT_MSG_BUF_LEN)
+
 #endif /* __SQCHAT_MACROS_H__ */
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
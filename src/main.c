@@ -22,6 +22,7 @@
 
 #ifdef WITH_SSL
 #include <gnutls/gnutls.h>
+#include "ssl.h"
 #endif
 
 #include "commands.h"
@@ -30,11 +31,18 @@
 #include "numerics.h"
 #include "errors.h"
 #include "settings.h"
+#include "addr_res.h"
+#include "net_io_thread.h"
+#include "trace.h"
+#include "watchdog.h"
+#include "log_writer.h"
 
 int main(int argc, char *argv[]) {
     sqchat_init_irc_commands();
     sqchat_init_msg_parser();
     sqchat_init_numerics();
+    sqchat_addr_res_init();
+    sqchat_net_io_thread_init();
 #ifdef WITH_SSL
     gnutls_global_init();
 
@@ -48,10 +56,23 @@ int main(int argc, char *argv[]) {
     gtk_init(&argc, &argv);
     sqchat_init_settings();
 
+    if (sqchat_logging_enabled)
+        sqchat_log_writer_init(sqchat_log_directory,
+                               (gint64)sqchat_log_max_size * 1024,
+                               sqchat_log_fsync_interval);
+
     struct sqchat_chat_window * window = sqchat_chat_window_new(NULL);
 
+    sqchat_watchdog_init();
     gtk_main();
 
+    // Make sure a trace that's still being recorded ends up readable
+    sqchat_trace_stop();
+    sqchat_log_writer_shutdown();
+#ifdef WITH_SSL
+    sqchat_ssl_free_credentials();
+#endif
+
     return 0;
 }
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -26,6 +26,9 @@
 #include "errors.h"
 #include "ctcp.h"
 #include "cmd_responses.h"
+#include "stats.h"
+#include "trace.h"
+#include "watchdog.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -33,29 +36,10 @@
 
 #include <stdio.h>
 
-#define MAX_POSSIBLE_PARAMS ((SQCHAT_IRC_MSG_LEN - sizeof(":X X ")) / sizeof("X "))
-
 sqchat_trie * message_types;
 
 sqchat_msg_cb * numerics;
 
-/* A function to convert strings to shorts, optimized specifically for IRC
- * numerics
- */
-short numeric_to_short(char * numeric) {
-    short result = 0;
-    short i;
-    for (i = 0; i < 3; i++) {
-        if (numeric[i] < '0' || numeric[i] > '9')
-            return -1;
-        result = (result * 10) + (numeric[i] - '0');
-    }
-    if (numeric[i] != '\0')
-        return -1;
-    else
-        return result;
-}
-
 void sqchat_init_msg_parser() {
     message_types = sqchat_trie_new(sqchat_trie_strtoupper);
     numerics = calloc(IRC_NUMERIC_MAX, sizeof(sqchat_msg_cb*));
@@ -208,53 +192,16 @@ void sqchat_init_msg_parser() {
     numerics[IRC_ERR_NOPRIVILEGES] = sqchat_generic_error;
 }
 
-void sqchat_process_msg(struct sqchat_network * network, char * msg) {
-    char * cursor;
-    char * hostmask;
-    char * command;
+static void run_msg_callbacks(struct sqchat_network * network,
+                              struct sqchat_msg * msg) {
+    char * hostmask = msg->hostmask;
+    char * command = msg->command;
+    short argc = msg->argc;
+    char ** argv = msg->argv;
     short numeric;
     sqchat_msg_cb callback;
 
-    /* TODO: Maybe figure out a better behavior for when bad messages are
-     * received...
-     */
-    // Check to see if the message has a sender
-    if (msg[0] == ':') {
-        if ((hostmask = strtok_r(msg+1, " ", &cursor)) == NULL)
-            return;
-        if ((command = strtok_r(NULL, " ", &cursor)) == NULL)
-            return;
-    }
-    else {
-        hostmask = NULL;
-        if ((command = strtok_r(msg, " ", &cursor)) == NULL)
-            return;
-    }
-
-    char * argv[MAX_POSSIBLE_PARAMS];
-    short argc;
-    for (argc = 0; ; argc++) {
-        char * param_end;
-
-        /* If there's a ':' at the beginning of the message we need to stop
-         * processing spaces
-         */
-        if (*cursor == ':') {
-            argv[argc++] = cursor + 1;
-            break;
-        }
-
-        else if ((param_end = strchr(cursor, ' ')) == NULL) {
-            argv[argc] = cursor;
-            argc++;
-            break;
-        }
-        *param_end = '\0';
-        argv[argc] = cursor;
-        for (cursor = param_end + 1; *cursor == ' '; cursor++);
-    }
-
-    if ((numeric = numeric_to_short(command)) != -1) {
+    if ((numeric = sqchat_numeric_to_short(command)) != -1) {
         if (numeric > 0 &&
             numeric <= IRC_NUMERIC_MAX && numerics[numeric] != NULL) {
             switch (numerics[numeric](network, hostmask, argc, argv)) {
@@ -337,9 +284,42 @@ void sqchat_process_msg(struct sqchat_network * network, char * msg) {
     }
 }
 
-void sqchat_split_hostmask(char * hostmask, char ** nickname, char ** address) {
-    char * saveptr;
-    *nickname = strtok_r(hostmask, "!", &saveptr);
-    *address = strtok_r(NULL, "!", &saveptr);
+// Runs the callbacks for a message that's already been parsed
+void sqchat_dispatch_msg(struct sqchat_network * network,
+                         struct sqchat_msg * msg) {
+    gint64 start = sqchat_stats_now();
+    gint64 time;
+    gint64 stall_time;
+
+    sqchat_watchdog_enter("Handling a message", msg->command);
+    run_msg_callbacks(network, msg);
+    stall_time = sqchat_watchdog_leave();
+
+    time = sqchat_stats_now() - start;
+    sqchat_stats_record_handler(msg->command, time);
+
+    if (stall_time != 0)
+        sqchat_buffer_print(network->buffer,
+                            "* The client froze for %.1fms while handling a %s "
+                            "message.\n",
+                            stall_time / 1e6, msg->command);
+
+    if (sqchat_trace_enabled() &&
+        sqchat_trace_event(msg->command, "handler", start, time,
+                           network->name))
+        sqchat_buffer_print(network->buffer,
+                            "Slow handler: %s took %.1fms (%i parameters)\n",
+                            msg->command, time / 1e6, msg->argc);
 }
+
+void sqchat_process_msg(struct sqchat_network * network, char * msg) {
+    struct sqchat_msg * parsed_msg;
+
+    if ((parsed_msg = sqchat_parse_msg(msg)) == NULL)
+        return;
+
+    sqchat_dispatch_msg(network, parsed_msg);
+    free(parsed_msg);
+}
+
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
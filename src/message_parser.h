@@ -16,6 +16,7 @@
 #ifndef __MESSAGE_PARSER_H__
 #define __MESSAGE_PARSER_H__
 #include "irc_network.h"
+#include "irc_message.h"
 
 typedef short (*sqchat_msg_cb)(struct sqchat_network *,
                                char *,     // hostmask
@@ -29,10 +30,11 @@ typedef short (*sqchat_msg_cb)(struct sqchat_network *,
 
 extern void sqchat_init_msg_parser();
 
+extern void sqchat_dispatch_msg(struct sqchat_network * network,
+                                struct sqchat_msg * msg)
+    _attr_nonnull(1, 2);
 extern void sqchat_process_msg(struct sqchat_network * network, char * msg)
     _attr_nonnull(1, 2);
-void sqchat_split_hostmask(char * hostmask, char ** nickname, char ** address)
-    _attr_nonnull(1, 2, 3);
 
 #endif
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
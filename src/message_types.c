@@ -24,6 +24,12 @@
 #include "errors.h"
 #include "trie.h"
 #include "ctcp.h"
+#include "format.h"
+#include "nick_color.h"
+#include "text_style.h"
+#include "filter.h"
+#include "stats.h"
+#include "netsplit.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -33,6 +39,46 @@ sqchat_trie * cap_features;
 #define IRC_CAP_MULTI_PREFIX    1
 #define IRC_CAP_SASL            2
 
+// Templates for everything that gets printed when a message comes in
+static struct sqchat_format join_format =
+    SQCHAT_FORMAT("* $0 ($1) has joined $2\n");
+static struct sqchat_format part_format =
+    SQCHAT_FORMAT("* $0 ($1) has left $2.\n");
+static struct sqchat_format part_reason_format =
+    SQCHAT_FORMAT("* $0 ($1) has left $2 ($3).\n");
+// $0 is the code for the nickname's color
+static struct sqchat_format privmsg_format =
+    SQCHAT_FORMAT("<$0$1\x03> $2\n");
+static struct sqchat_format server_notice_format = SQCHAT_FORMAT("* $0: $1\n");
+static struct sqchat_format notice_format = SQCHAT_FORMAT("-$0- $1\n");
+static struct sqchat_format channel_notice_format =
+    SQCHAT_FORMAT("-$0:$1- $2\n");
+static struct sqchat_format nick_format =
+    SQCHAT_FORMAT("* $0 is now known as $1\n");
+static struct sqchat_format our_nick_format =
+    SQCHAT_FORMAT("* You are now known as $0\n");
+static struct sqchat_format topic_format =
+    SQCHAT_FORMAT("* $0 changed the topic to \"$1\"\n");
+static struct sqchat_format mode_format =
+    SQCHAT_FORMAT("* $0 sets mode $1-\n");
+static struct sqchat_format our_mode_format =
+    SQCHAT_FORMAT("Your mode is $0\n");
+static struct sqchat_format quit_format = SQCHAT_FORMAT("* $0 has quit.\n");
+static struct sqchat_format quit_reason_format =
+    SQCHAT_FORMAT("* $0 has quit ($1).\n");
+static struct sqchat_format kicked_format =
+    SQCHAT_FORMAT("* You were kicked from $0 by $1.\n");
+static struct sqchat_format kicked_reason_format =
+    SQCHAT_FORMAT("* You were kicked from $0 by $1 ($2).\n");
+static struct sqchat_format kick_format =
+    SQCHAT_FORMAT("* $0 has kicked $1 from $2.\n");
+static struct sqchat_format kick_reason_format =
+    SQCHAT_FORMAT("* $0 has kicked $1 from $2 ($3).\n");
+static struct sqchat_format invite_format =
+    SQCHAT_FORMAT("* You have been invited to $0 by $1.\n");
+static struct sqchat_format wallops_format =
+    SQCHAT_FORMAT("-$0/WALLOPS- $1\n");
+
 void sqchat_init_message_types() {
     cap_features = sqchat_trie_new(sqchat_trie_strtolower);
     sqchat_trie_set(cap_features, "multi-prefix",  (void*)IRC_CAP_MULTI_PREFIX);
@@ -45,6 +91,37 @@ void sqchat_init_message_types() {
                     short argc,                         \
                     char * argv[])
 
+/* These have to be checked before the hostmask gets split up, and before
+ * anything gets printed, so a filtered message never costs more then the check
+ */
+static bool message_filtered(struct sqchat_network * network,
+                             const char * hostmask,
+                             const char * text) {
+    if (!sqchat_filter_ignores(network->filter, hostmask, text))
+        return false;
+
+    g_atomic_int_inc(&sqchat_stats.messages_filtered);
+    return true;
+}
+
+/* Whether a join, part, etc. in a channel shouldn't be printed, either because
+ * it's from someone who's ignored or because the channel's big enough that the
+ * user doesn't want to see them
+ */
+static bool event_filtered(struct sqchat_buffer * buffer,
+                           enum sqchat_filter_event event,
+                           bool ignored) {
+    const struct sqchat_filter * filter = buffer->network->filter;
+
+    if (!ignored &&
+        (!sqchat_filter_hides(filter, event) ||
+         sqchat_user_list_user_count(buffer) < filter->large_channel_size))
+        return false;
+
+    g_atomic_int_inc(&sqchat_stats.messages_filtered);
+    return true;
+}
+
 MSG_CB(sqchat_cap_msg_callback) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS_FATAL;
@@ -106,6 +183,7 @@ MSG_CB(sqchat_join_msg_callback) {
 
     char * nickname;
     char * address;
+    bool ignored = sqchat_filter_ignores(network->filter, hostmask, NULL);
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
     // Check if we're the user joining a channel
@@ -129,8 +207,12 @@ MSG_CB(sqchat_join_msg_callback) {
 
         sqchat_user_list_user_add(buffer, nickname, NULL, 0);
 
-        sqchat_buffer_print(buffer, "* %s (%s) has joined %s\n",
-                            nickname, address, argv[0]);
+        if (!event_filtered(buffer, SQCHAT_FILTER_JOIN, ignored)) {
+            if (!sqchat_netsplit_add_join(network, buffer, nickname))
+                sqchat_buffer_format(buffer, &join_format,
+                                     nickname, address, argv[0]);
+            sqchat_network_tree_buffer_activity(buffer, SQCHAT_ACTIVITY_EVENT);
+        }
     }
     return 0;
 }
@@ -142,6 +224,7 @@ MSG_CB(sqchat_part_msg_callback) {
     struct sqchat_buffer * buffer;
     char * nickname;
     char * address;
+    bool ignored = sqchat_filter_ignores(network->filter, hostmask, NULL);
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
     if ((buffer = sqchat_trie_get(network->buffers, argv[0])) == NULL) {
@@ -167,41 +250,49 @@ MSG_CB(sqchat_part_msg_callback) {
                                 nickname, address, argv[0]);
             return SQCHAT_MSG_ERR_MISC_NODUMP;
         }
-        if (argc < 2)
-            sqchat_buffer_print(buffer,
-                                "* %s (%s) has left %s.\n",
-                                nickname, address, argv[0]);
+        if (event_filtered(buffer, SQCHAT_FILTER_PART, ignored))
+            return 0;
+        else if (argc < 2)
+            sqchat_buffer_format(buffer, &part_format,
+                                 nickname, address, argv[0]);
         else
-            sqchat_buffer_print(buffer,
-                                "* %s (%s) has left %s (%s).\n",
-                                nickname, address, argv[0], argv[1]);
+            sqchat_buffer_format(buffer, &part_reason_format,
+                                 nickname, address, argv[0], argv[1]);
+        sqchat_network_tree_buffer_activity(buffer, SQCHAT_ACTIVITY_EVENT);
     }
     return 0;
 }
 
 MSG_CB(sqchat_privmsg_msg_callback) {
+    if (message_filtered(network, hostmask, argv[1]))
+        return 0;
+
     // Check if the message being sent is a CTCP
     if ((argv[1])[0] == SQCHAT_CTCP_DELIM)
         sqchat_process_ctcp(network, REQUEST, hostmask, argv[0], argv[1]);
     else {
         char * nickname;
         char * address;
+        struct sqchat_buffer * buffer;
         sqchat_split_hostmask(hostmask, &nickname, &address);
 
         // Check whether or not the message was meant to be sent to a channel
         if (SQCHAT_IS_CHAN(network, argv[0]))
-            sqchat_buffer_print(sqchat_trie_get(network->buffers, argv[0]),
-                                "<%s> %s\n", nickname, argv[1]);
-        else {
-            struct sqchat_buffer * buffer;
+            buffer = sqchat_trie_get(network->buffers, argv[0]);
+        else if ((buffer = sqchat_trie_get(network->buffers, nickname)) == NULL) {
+            buffer = sqchat_buffer_new(nickname, QUERY, network);
+            sqchat_network_tree_buffer_add(buffer, network);
+        }
 
-            if ((buffer = sqchat_trie_get(network->buffers, nickname)) == NULL) {
-                buffer = sqchat_buffer_new(nickname, QUERY, network);
-                sqchat_network_tree_buffer_add(buffer, network);
-            }
+        sqchat_buffer_format(buffer, &privmsg_format,
+                             sqchat_nick_color_code(nickname), nickname,
+                             argv[1]);
 
-            sqchat_buffer_print(buffer, "<%s> %s\n", nickname, argv[1]);
-        }
+        if (sqchat_highlighter_match(network->highlighter, argv[1]))
+            sqchat_chat_window_highlight(network->window, buffer);
+        else
+            sqchat_network_tree_buffer_activity(buffer,
+                                                SQCHAT_ACTIVITY_MESSAGE);
     }
     return 0;
 }
@@ -210,6 +301,9 @@ MSG_CB(sqchat_notice_msg_callback) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
+    if (message_filtered(network, hostmask, argv[1]))
+        return 0;
+
     if ((argv[1])[0] == SQCHAT_CTCP_DELIM)
         sqchat_process_ctcp(network, RESPONSE, hostmask, argv[0], argv[1]);
     else {
@@ -218,16 +312,28 @@ MSG_CB(sqchat_notice_msg_callback) {
         sqchat_split_hostmask(hostmask, &nickname, &address);
 
         if (strcmp(argv[0], "*") == 0)
-            sqchat_buffer_print(network->buffer, "* %s: %s\n", nickname, argv[1]);
+            sqchat_buffer_format(network->buffer, &server_notice_format,
+                                 nickname, argv[1]);
         else if (strcmp(argv[0], network->nickname) == 0)
-            sqchat_buffer_print(network->window->current_buffer,
-                                "-%s- %s\n", nickname, argv[1]);
+            sqchat_buffer_format(network->window->current_buffer,
+                                 &notice_format, nickname, argv[1]);
         else {
             struct sqchat_buffer * output;
             if ((output = sqchat_trie_get(network->buffers, argv[0])) != NULL)
-                sqchat_buffer_print(network->window->current_buffer,
-                                    "-%s:%s- %s\n", nickname, argv[0], argv[1]);
+                sqchat_buffer_format(network->window->current_buffer,
+                                     &channel_notice_format,
+                                     nickname, argv[0], argv[1]);
         }
+
+        /* Everything but server notices gets shown in the current buffer,
+         * so there's nothing new to mark anywhere else
+         */
+        if (sqchat_highlighter_match(network->highlighter, argv[1]))
+            sqchat_chat_window_highlight(network->window,
+                                         network->window->current_buffer);
+        else if (strcmp(argv[0], "*") == 0)
+            sqchat_network_tree_buffer_activity(network->buffer,
+                                                SQCHAT_ACTIVITY_MESSAGE);
     }
     return 0;
 }
@@ -235,6 +341,7 @@ MSG_CB(sqchat_notice_msg_callback) {
 struct announce_nick_change_param {
     char * old_nick;
     char * new_nick;
+    bool ignored;
 };
 
 /* Used by sqchat_trie_each in sqchat_nick_msg_callback to announce the change of a user's
@@ -251,8 +358,11 @@ void announce_nick_change(struct sqchat_buffer * buffer,
     if ((user = sqchat_trie_get(buffer->chan_data->users, params->old_nick)) != NULL) {
         GtkTreeIter user_entry;
 
-        sqchat_buffer_print(buffer, "* %s is now known as %s\n",
-                            params->old_nick, params->new_nick);
+        if (!event_filtered(buffer, SQCHAT_FILTER_NICK, params->ignored)) {
+            sqchat_buffer_format(buffer, &nick_format,
+                                 params->old_nick, params->new_nick);
+            sqchat_network_tree_buffer_activity(buffer, SQCHAT_ACTIVITY_EVENT);
+        }
 
         gtk_tree_model_get_iter(GTK_TREE_MODEL(buffer->chan_data->user_list_store),
                                 &user_entry,
@@ -260,7 +370,9 @@ void announce_nick_change(struct sqchat_buffer * buffer,
 
         // Change the user's name on the user list
         gtk_list_store_set(buffer->chan_data->user_list_store, &user_entry, 1,
-                           params->new_nick, -1);
+                           params->new_nick, 3,
+                           sqchat_text_colors[sqchat_nick_color(
+                               params->new_nick)], -1);
 
         // Remove the old entry in the user sqchat_trie and add a new one
         sqchat_trie_del(buffer->chan_data->users, params->old_nick);
@@ -270,7 +382,7 @@ void announce_nick_change(struct sqchat_buffer * buffer,
 
 void announce_our_nick_change(struct sqchat_buffer * buffer,
                               struct announce_nick_change_param * params) {
-    sqchat_buffer_print(buffer, "* You are now known as %s\n", params->new_nick);
+    sqchat_buffer_format(buffer, &our_nick_format, params->new_nick);
     if (buffer->type == CHANNEL) {
         GtkTreeRowReference * row_ref;
         // Check if our nickname is listed in the channel
@@ -284,7 +396,9 @@ void announce_our_nick_change(struct sqchat_buffer * buffer,
 
             // Change the user's name on the user list
             gtk_list_store_set(buffer->chan_data->user_list_store, &row, 1,
-                               params->new_nick, -1);
+                               params->new_nick, 3,
+                               sqchat_text_colors[sqchat_nick_color(
+                                   params->new_nick)], -1);
 
             // Remove the old entry in the user sqchat_trie and add a new one
             sqchat_trie_del(buffer->chan_data->users, params->old_nick);
@@ -299,19 +413,21 @@ MSG_CB(sqchat_nick_msg_callback) {
 
     char * nickname;
     char * address;
+    bool ignored = sqchat_filter_ignores(network->filter, hostmask, NULL);
 
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
     struct announce_nick_change_param params;
     params.old_nick = nickname;
     params.new_nick = argv[0];
+    params.ignored = ignored;
 
     // Check if we're the one whose nickname is being changed
     if (strcmp(network->nickname, nickname) == 0) {
         free(network->nickname);
         network->nickname = strdup(argv[0]);
-        sqchat_buffer_print(network->buffer, "* You are now known as %s\n",
-                            argv[0]);
+        sqchat_highlighter_set_nickname(network->highlighter, argv[0]);
+        sqchat_buffer_format(network->buffer, &our_nick_format, argv[0]);
         sqchat_trie_each(network->buffers, announce_our_nick_change, &params);
 
         // If the user initiated the nick change, remove their response request
@@ -328,8 +444,7 @@ MSG_CB(sqchat_nick_msg_callback) {
             GtkTreeIter query_row;
             GtkTreeModel * network_tree_model;
 
-            sqchat_buffer_print(query, "* %s is now known as %s\n",
-                                nickname, argv[0]);
+            sqchat_buffer_format(query, &nick_format, nickname, argv[0]);
 
             // Change the name of the buffer
             free(query->buffer_name);
@@ -372,8 +487,8 @@ MSG_CB(sqchat_topic_msg_callback) {
         return SQCHAT_MSG_ERR_MISC_NODUMP;
     }
 
-    sqchat_buffer_print(channel, "* %s changed the topic to \"%s\"\n",
-                        nickname, argv[0]);
+    sqchat_buffer_format(channel, &topic_format, nickname, argv[0]);
+    sqchat_network_tree_buffer_activity(channel, SQCHAT_ACTIVITY_EVENT);
     return 0;
 }
 
@@ -445,14 +560,17 @@ MSG_CB(sqchat_mode_msg_callback) {
                     }
                 }
             }
+        }
+
+        // Print the whole mode change in one go, along with it's arguments
 escape_user_mode_check:
-            sqchat_buffer_print(channel, "* %s sets mode %s", nickname, argv[1]);
-            for (arg_pos = 2; arg_pos < argc; arg_pos++)
-                sqchat_buffer_print(channel, " %s", argv[arg_pos]);
-            sqchat_buffer_print(channel, "\n");
+        {
+            const char * args[argc];
+
+            args[0] = nickname;
+            memcpy(&args[1], &argv[1], sizeof(char *) * (argc - 1));
+            sqchat_buffer_print_format(channel, &mode_format, argc, args);
         }
-        else
-            sqchat_buffer_print(channel, "* %s sets mode %s\n", nickname, argv[1]);
 
         // If the mode response was claimed by another command, remove the claim
         if (network->claimed_responses)
@@ -466,7 +584,7 @@ escape_user_mode_check:
         }
         else
             output = network->buffer;
-        sqchat_buffer_print(output, "Your mode is %s\n", argv[1]);
+        sqchat_buffer_format(output, &our_mode_format, argv[1]);
     }
     return 0;
 }
@@ -474,28 +592,36 @@ escape_user_mode_check:
 struct announce_quit_params {
     char * nickname;
     char * quit_msg;
+    bool ignored;
+    // NULL unless the user quit because of a netsplit
+    struct sqchat_netsplit * netsplit;
 };
 
 static void announce_quit(struct sqchat_buffer * buffer,
                           struct announce_quit_params * params) {
     if (buffer->type == CHANNEL) {
         // Check if the user is in the channel
-        if (sqchat_user_list_user_remove(buffer, params->nickname) != -1) {
-            if (params->quit_msg == NULL)
-                sqchat_buffer_print(buffer, "* %s has quit.\n", params->nickname);
+        if (sqchat_user_list_user_remove(buffer, params->nickname) != -1 &&
+            !event_filtered(buffer, SQCHAT_FILTER_QUIT, params->ignored)) {
+            if (params->netsplit != NULL)
+                sqchat_netsplit_add_quit(params->netsplit, buffer,
+                                         params->nickname);
+            else if (params->quit_msg == NULL)
+                sqchat_buffer_format(buffer, &quit_format, params->nickname);
             else
-                sqchat_buffer_print(buffer, "* %s has quit (%s).\n",
-                                    params->nickname, params->quit_msg);
+                sqchat_buffer_format(buffer, &quit_reason_format,
+                                     params->nickname, params->quit_msg);
+            sqchat_network_tree_buffer_activity(buffer, SQCHAT_ACTIVITY_EVENT);
         }
     }
     else {
         if (buffer->network->casecmp(buffer->network->nickname,
                                             params->nickname) == 0) {
             if (params->quit_msg == NULL)
-                sqchat_buffer_print(buffer, "* %s has quit.\n", params->nickname);
+                sqchat_buffer_format(buffer, &quit_format, params->nickname);
             else
-                sqchat_buffer_print(buffer, "* %s has quit (%s).\n",
-                                    params->nickname, params->quit_msg);
+                sqchat_buffer_format(buffer, &quit_reason_format,
+                                     params->nickname, params->quit_msg);
         }
     }
 } _attr_nonnull(1, 2)
@@ -504,10 +630,15 @@ MSG_CB(sqchat_quit_msg_callback) {
     char * nickname;
     char * address;
     struct announce_quit_params params;
+
+    params.ignored = sqchat_filter_ignores(network->filter, hostmask, NULL);
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
     params.nickname = nickname;
     params.quit_msg = (argc >= 1) ? argv[0] : NULL;
+    params.netsplit =
+        params.quit_msg && sqchat_netsplit_is_split_quit(params.quit_msg)
+        ? sqchat_netsplit_get(network, params.quit_msg) : NULL;
 
     sqchat_trie_each(network->buffers, announce_quit, &params);
     if (network->claimed_responses)
@@ -540,22 +671,21 @@ MSG_CB(sqchat_kick_msg_callback) {
         sqchat_network_tree_buffer_remove(channel);
         sqchat_buffer_destroy(channel);
         if (argc < 3)
-            sqchat_buffer_print(network->buffer,
-                                "* You were kicked from %s by %s.\n",
-                                argv[0], nickname);
+            sqchat_buffer_format(network->buffer, &kicked_format,
+                                 argv[0], nickname);
         else
-            sqchat_buffer_print(network->buffer,
-                                "* You were kicked from %s by %s (%s).\n",
-                                argv[0], nickname, argv[2]);
+            sqchat_buffer_format(network->buffer, &kicked_reason_format,
+                                 argv[0], nickname, argv[2]);
     }
     else {
         sqchat_user_list_user_remove(channel, argv[1]);
         if (argc < 3)
-            sqchat_buffer_print(channel, "* %s has kicked %s from %s.\n",
-                                nickname, argv[1], argv[0]);
+            sqchat_buffer_format(channel, &kick_format,
+                                 nickname, argv[1], argv[0]);
         else
-            sqchat_buffer_print(channel, "* %s has kicked %s from %s (%s).\n",
-                                nickname, argv[1], argv[0], argv[2]);
+            sqchat_buffer_format(channel, &kick_reason_format,
+                                 nickname, argv[1], argv[0], argv[2]);
+        sqchat_network_tree_buffer_activity(channel, SQCHAT_ACTIVITY_EVENT);
         if (network->claimed_responses)
             sqchat_remove_last_response_claim(network);
     }
@@ -570,9 +700,8 @@ MSG_CB(sqchat_invite_msg_callback) {
     char * address;
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
-    sqchat_buffer_print(network->window->current_buffer,
-                        "* You have been invited to %s by %s.\n",
-                        argv[1], nickname);
+    sqchat_buffer_format(network->window->current_buffer, &invite_format,
+                         argv[1], nickname);
     return 0;
 }
 
@@ -592,8 +721,8 @@ MSG_CB(sqchat_wallops_msg_callback) {
     char * address;
     sqchat_split_hostmask(hostmask, &nickname, &address);
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network), "-%s/WALLOPS- %s\n",
-                        nickname, argv[0]);
+    sqchat_buffer_format(sqchat_route_rpl_end(network), &wallops_format,
+                         nickname, argv[0]);
     return 0;
 }
 
@@ -25,257 +25,198 @@
 #include "connection_setup.h"
 #include "settings.h"
 
+#ifdef WITH_SSL
+#include "ssl.h"
+#endif
+
 #include <glib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <gnutls/gnutls.h>
 
 /* When the socket and ssl session is closed for a network, this function is
  * called to mark the network as disconnected, print a message, and/or destroy
- * the network if nessecary
+ * the network if nessecary. Returns false if the network was destroyed.
  */
-static inline void finish_network_disconnect(struct sqchat_network * network) {
+static inline bool finish_network_disconnect(struct sqchat_network * network) {
     network->status = DISCONNECTED;
 
-    if (network->destroy_on_disconnect)
+#ifdef WITH_SSL
+    sqchat_ssl_release_credentials(network);
+#endif
+
+    if (network->destroy_on_disconnect) {
         sqchat_network_destroy(network);
+        return false;
+    }
+
+    sqchat_buffer_print(network->buffer, "* Disconnected.\n");
+    return true;
+}
+
+/* Starts reading from a network, once we've connected to it. Until the network
+ * is done with it's handshake, it's input is handled on the main thread.
+ */
+void sqchat_net_input_start(struct sqchat_network * network) {
+    if (network->status == CONNECTED)
+        sqchat_connection_watch(&network->connection);
+    // The handshake failed before we even got a chance to start reading
+    else if (network->status == DISCONNECTED)
+        finish_network_disconnect(network);
     else
-        sqchat_buffer_print(network->buffer, "* Disconnected.\n");
+        g_io_add_watch_full(network->connection.input_channel,
+                            G_PRIORITY_DEFAULT,
+                            G_IO_IN, (GIOFunc)sqchat_net_input_handler,
+                            network, NULL);
 }
 
-/* Checks for messages waiting in a network's buffer
- * If there is still a message waiting in the network's buffer, it returns it
- * and moves the buffer cursor forward. Otherwise returns null. NULL is returned
- * and errno is set in the event of an error.
+#ifdef WITH_SSL
+/* Does another handshake when the server asks for one in the middle of a
+ * connection. Returns false if the network was destroyed.
  */
-char * check_for_messages(struct sqchat_network * network) {
-    char * next_terminator = strstr(&network->recv_buffer[network->buffer_cursor],
-                                    "\r\n");
-    char * output;
+static bool rehandshake(struct sqchat_network * network) {
+    int result;
 
-    // If a message was found, remove the terminator, set output variable
-    if (next_terminator != NULL) {
-        *next_terminator = '\0';
-        *(next_terminator + 1) = '\0';
-        output = &network->recv_buffer[network->buffer_cursor];
-        network->buffer_cursor = (int)(next_terminator -
-                                      &network->recv_buffer[0]) + 2;
+    // Check if another handshake can be done securely
+    if (gnutls_safe_renegotiation_status(network->connection.ssl_session)) {
+        sqchat_buffer_print(network->buffer,
+                            "Server requested another SSL handshake, please "
+                            "wait...\n");
+        result = gnutls_handshake(network->connection.ssl_session);
+        if (result == GNUTLS_E_SUCCESS)
+            sqchat_buffer_print(network->buffer,
+                                "Handshake complete! Resuming normal "
+                                "operations.\n");
+        else if (result == GNUTLS_E_AGAIN || result == GNUTLS_E_INTERRUPTED) {
+            // Finish the handshake on the main thread
+            network->status = REHANDSHAKE;
+            sqchat_net_input_start(network);
+            return true;
+        }
+        else if (gnutls_error_is_fatal(result)) {
+            sqchat_buffer_print(network->buffer,
+                                "Fatal SSL error: %s\n"
+                                "Closing connection.\n",
+                                gnutls_strerror(result));
+            sqchat_network_disconnect(network, "SSL error");
+            sqchat_connection_close(&network->connection);
 
-        // Check if there's potentially another message in the buffer
-        if (network->buffer_cursor >= network->buffer_fill_len) {
-            network->buffer_cursor = 0;
-            network->buffer_fill_len = 0;
+            return finish_network_disconnect(network);
         }
+        else
+            sqchat_buffer_print(network->buffer,
+                                "SSL warning: %s\n",
+                                gnutls_strerror(result));
     }
     else {
-        /* If no message was found but we're not at the end of the buffer, that
-         * means there's probably a only partially received message waiting
-         * after the position of the cursor. Make sure there is space for the
-         * rest of the message to be received
+        /* Something fishy may be happening, reject the additional
+         * handshake
          */
-        if (network->buffer_cursor <= network->buffer_fill_len) {
-            network->buffer_fill_len -= network->buffer_cursor;
-            memmove(&network->recv_buffer[0],
-                    &network->recv_buffer[network->buffer_cursor],
-                    network->buffer_fill_len);
-        }
-
-        // If the message is longer then the max allowed length, report an error
-        else if (network->buffer_cursor == 0 &&
-                 network->buffer_fill_len >= SQCHAT_IRC_MSG_LEN)
-            errno = EMSGSIZE;
-
-        network->buffer_cursor = 0;
-        return NULL;
-    }
-    // Make sure that the string is encoded in UTF-8 before handing it off
-    if (g_utf8_validate(output, -1, NULL))
-        return strdup(output);
-    else {
-        char * output_utf8;
-        output_utf8 =
-            g_convert_with_fallback(output, -1, "UTF-8",
-                                    sqchat_fallback_encoding,
-                                    "�", NULL, NULL, NULL);
-        return output_utf8;
+        sqchat_buffer_print(network->buffer,
+                            "SSL warning: Server requested another handshake, "
+                            "but our connection does not support safe "
+                            "renegotiation. Denying handshake request.\n");
+        gnutls_alert_send_appropriate(network->connection.ssl_session,
+                                      GNUTLS_A_NO_RENEGOTIATION);
     }
+
+    sqchat_net_input_start(network);
+    return true;
 }
+#endif // WITH_SSL
 
-gboolean sqchat_net_input_handler(GIOChannel *source,
-                                  GIOCondition condition,
-                                  struct sqchat_network * network) {
-    char * msg;
-    int result;
-    sqchat_server * server = network->current_server->data;
+static bool on_message(struct sqchat_connection * connection,
+                       struct sqchat_msg * msg,
+                       void * data) {
+    sqchat_dispatch_msg(data, msg);
+    return true;
+}
 
-    errno = 0;
+static bool on_rehandshake(struct sqchat_connection * connection,
+                           void * data) {
 #ifdef WITH_SSL
-    if (server->ssl) {
-        if (network->status == DISCONNECTED) {
-            finish_network_disconnect(network);
-
-            return false;
-        }
-        else if (network->status == CONNECTED) {
-            do {
-                // Try reading from the network
-                result =
-                    gnutls_read(network->ssl_session,
-                                &network->recv_buffer[network->buffer_fill_len],
-                                SQCHAT_IRC_MSG_LEN - network->buffer_fill_len);
-                if (result == 0) {
-                    gnutls_deinit(network->ssl_session);
-                    close(network->socket);
+    return rehandshake(data);
+#else
+    return true;
+#endif
+}
 
-                    finish_network_disconnect(network);
+static bool on_closed(struct sqchat_connection * connection,
+                      const char * error,
+                      const char * quit_msg,
+                      void * data) {
+    struct sqchat_network * network = data;
 
-                    return FALSE;
-                }
-                else if (result == GNUTLS_E_REHANDSHAKE) {
-                    // Check if another handshake can be done securely
-                    if (gnutls_safe_renegotiation_status(network->ssl_session)) {
-                        sqchat_buffer_print(network->buffer,
-                                            "Server requested another SSL "
-                                            "handshake, please wait...\n");
-                        result = gnutls_handshake(network->ssl_session);
-                        if (result == GNUTLS_E_SUCCESS)
-                            sqchat_buffer_print(network->buffer,
-                                                "Handshake complete! Resuming "
-                                                "normal operations.\n");
-                        else if (result == GNUTLS_E_AGAIN ||
-                                 result == GNUTLS_E_INTERRUPTED)
-                            network->status = REHANDSHAKE;
-                        else if (gnutls_error_is_fatal(result)) {
-                            sqchat_buffer_print(network->buffer,
-                                                "Fatal SSL error: %s\n"
-                                                "Closing connection.\n",
-                                                gnutls_strerror(result));
-                            sqchat_network_disconnect(network, "SSL error");
-                            gnutls_deinit(network->ssl_session);
-                            close(network->socket);
+    if (error) {
+        sqchat_buffer_print(network->buffer, "%s", error);
+        if (quit_msg)
+            sqchat_network_disconnect(network, quit_msg);
+    }
 
-                            finish_network_disconnect(network);
+    sqchat_connection_close(connection);
+    return finish_network_disconnect(network);
+}
 
-                            return FALSE;
-                        }
-                        else
-                            sqchat_buffer_print(network->buffer,
-                                                "SSL warning: %s\n",
-                                                gnutls_strerror(result));
-                    }
-                    else {
-                        /* Something fishy may be happening, reject the
-                         * additional handshake
-                         */
-                        sqchat_buffer_print(network->buffer,
-                                            "SSL warning: Server requested "
-                                            "another handshake, but our "
-                                            "connection does not support safe "
-                                            "renegotiation. Denying handshake "
-                                            "request.\n");
-                        gnutls_alert_send_appropriate(network->ssl_session,
-                                                      GNUTLS_A_NO_RENEGOTIATION);
-                    }
-                }
-                else if (result == GNUTLS_E_INTERRUPTED ||
-                         result == GNUTLS_E_AGAIN)
-                    return TRUE;
-                /* If the receive fails for any reason, close the connection
-                 * We may eventually want to improve on this behavior
-                 */
-                else if (result < 0) {
-                    sqchat_buffer_print(network->buffer,
-                                        "SSL error during record receive: %s\n"
-                                        "* Disconnected.\n",
-                                        gnutls_strerror(result));
-                    sqchat_network_disconnect(network, "SSL error");
-                    gnutls_deinit(network->ssl_session);
-                    close(network->socket);
+// Acts on what happens on a network's connection once it's been handed off
+const struct sqchat_connection_observer sqchat_network_observer = {
+    .message     = on_message,
+    .rehandshake = on_rehandshake,
+    .closed      = on_closed
+};
 
-                    finish_network_disconnect(network);
+/* Handles input for a network on the main thread while it's doing an SSL
+ * handshake. Once the network is connected, the I/O thread takes over.
+ */
+gboolean sqchat_net_input_handler(GIOChannel *source,
+                                  GIOCondition condition,
+                                  struct sqchat_network * network) {
+#ifdef WITH_SSL
+    int result;
 
-                    return FALSE;
-                }
+    if (network->status == DISCONNECTED) {
+        finish_network_disconnect(network);
 
-                network->buffer_fill_len += result;
+        return FALSE;
+    }
 
-                while ((msg = check_for_messages(network)) != NULL) {
-                    sqchat_process_msg(network, msg);
-                    free(msg);
-                }
-            } while (gnutls_record_check_pending(network->ssl_session));
+    // Try to do a handshake
+    result = gnutls_handshake(network->connection.ssl_session);
+    if (result == GNUTLS_E_SUCCESS) {
+        // If this is our first handshake, continue to the CAP phase
+        if (network->status == HANDSHAKE) {
+            sqchat_ssl_handshake_complete(network);
+            sqchat_begin_registration(network);
         }
-        /* If we're not in CONNECTED or CAP mode, we must be (re)initiating a
-         * handshake
-         */
         else {
-            // Try to do a handshake
-            result = gnutls_handshake(network->ssl_session);
-            if (result == GNUTLS_E_SUCCESS) {
-                // If this is our first handshake, continue to the CAP phase
-                if (network->status == HANDSHAKE) {
-                    sqchat_buffer_print(network->buffer,
-                                        "Handshake complete.\n");
-                    sqchat_begin_registration(network);
-                }
-                else {
-                    sqchat_buffer_print(network->buffer,
-                                        "Handshake complete. Resuming "
-                                        "connection.\n");
-                    network->status = CONNECTED;
-                }
-            }
-            else if (result != GNUTLS_E_AGAIN &&
-                     result != GNUTLS_E_INTERRUPTED) {
-                if (gnutls_error_is_fatal(result)) {
-                    sqchat_buffer_print(network->buffer,
-                                        "SSL error during handshake: %s\n",
-                                        gnutls_strerror(result));
-                    sqchat_network_disconnect(network, "SSL error");
-                    finish_network_disconnect(network);
-                }
-                else
-                    sqchat_buffer_print(network->buffer,
-                                        "SSL warning: %s\n",
-                                        gnutls_strerror(result));
-            }
+            sqchat_buffer_print(network->buffer,
+                                "Handshake complete. Resuming connection.\n");
+            network->status = CONNECTED;
         }
-    }
-    else {
-#endif // WITH_SSL
-        result = recv(network->socket,
-                      &network->recv_buffer[network->buffer_fill_len],
-                      SQCHAT_IRC_MSG_LEN - network->buffer_fill_len, 0);
-
-        if (result == 0) {
-            close(network->socket);
-
-            finish_network_disconnect(network);
 
-            return FALSE;
-        }
-        else if (result == -1) {
+        sqchat_net_input_start(network);
+        return FALSE;
+    }
+    else if (result != GNUTLS_E_AGAIN &&
+             result != GNUTLS_E_INTERRUPTED) {
+        if (gnutls_error_is_fatal(result)) {
             sqchat_buffer_print(network->buffer,
-                                "Error: %s\n"
-                                "Closing connection.\n",
-                                strerror(errno));
-            close(network->socket);
+                                "SSL error during handshake: %s\n",
+                                gnutls_strerror(result));
+            sqchat_network_disconnect(network, "SSL error");
+            sqchat_connection_close(&network->connection);
 
             finish_network_disconnect(network);
-
             return FALSE;
         }
-
-        network->buffer_fill_len += result;
-        while ((msg = check_for_messages(network)) != NULL) {
-            sqchat_process_msg(network, msg);
-            free(msg);
-        }
-#ifdef WITH_SSL
+        else
+            sqchat_buffer_print(network->buffer,
+                                "SSL warning: %s\n",
+                                gnutls_strerror(result));
     }
-#endif
+#endif // WITH_SSL
 
     return TRUE;
 }
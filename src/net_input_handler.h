@@ -18,13 +18,20 @@
 #define __NET_INPUT_HANDLER__
 
 #include "irc_network.h"
+#include "irc_connection.h"
 
 #include <glib.h>
+#include <stdbool.h>
 
 extern gboolean sqchat_net_input_handler(GIOChannel *source,
                                          GIOCondition condition,
                                          struct sqchat_network * buffer)
     _attr_nonnull(3);
 
+extern void sqchat_net_input_start(struct sqchat_network * network)
+    _attr_nonnull(1);
+
+extern const struct sqchat_connection_observer sqchat_network_observer;
+
 #endif // __NET_INPUT_HANDLER__
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,185 @@
+/* The thread that does all of the reading from our connections. It takes care
+ * of decrypting, splitting and parsing messages, so all the main thread has to
+ * do is act on them. Nothing here touches the UI, so the same thread boundary
+ * works without one.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "net_io_thread.h"
+#include "irc_connection.h"
+#include "spsc_queue.h"
+#include "stats.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+static GMainContext * io_context;
+
+/* If a connection's queue fills up, the I/O thread waits on this until the main
+ * thread catches up
+ */
+static GMutex queue_full_mutex;
+static GCond queue_full_cond;
+static gint queue_full_waiting;
+
+static gpointer io_thread(gpointer data) {
+    GMainLoop * loop = g_main_loop_new(io_context, FALSE);
+
+    g_main_context_push_thread_default(io_context);
+    g_main_loop_run(loop);
+
+    return NULL;
+}
+
+void sqchat_net_io_thread_init() {
+    g_mutex_init(&queue_full_mutex);
+    g_cond_init(&queue_full_cond);
+
+    io_context = g_main_context_new();
+    g_thread_unref(g_thread_new("Network I/O", io_thread, NULL));
+}
+
+/* Has the I/O thread call func whenever there's data waiting on the
+ * connection's socket, until func returns FALSE
+ */
+void sqchat_net_io_watch(struct sqchat_connection * connection, GIOFunc func) {
+    GSource * source = g_io_create_watch(connection->input_channel, G_IO_IN);
+
+    g_source_set_callback(source, (GSourceFunc)func, connection, NULL);
+    g_source_attach(source, io_context);
+    g_source_unref(source);
+}
+
+// Hands an event to the connection's observer
+static bool deliver_event(struct sqchat_connection * connection,
+                          struct sqchat_net_event * event) {
+    const struct sqchat_connection_observer * observer = connection->observer;
+
+    switch (event->type) {
+        case SQCHAT_NET_EVENT_MSG:
+            return observer->message(connection, event->msg,
+                                     connection->observer_data);
+        case SQCHAT_NET_EVENT_REHANDSHAKE:
+            return observer->rehandshake(connection,
+                                         connection->observer_data);
+        case SQCHAT_NET_EVENT_CLOSED:
+            return observer->closed(connection, event->error, event->quit_msg,
+                                    connection->observer_data);
+        default:
+            return true;
+    }
+}
+
+/* Handles the events waiting for a connection on the main thread, until we run
+ * out of events or budget
+ */
+static gboolean dispatch_events(struct sqchat_connection * connection) {
+    struct sqchat_net_event * event;
+    bool connection_alive;
+    gint64 start = sqchat_stats_now();
+    int budget;
+
+    for (budget = SQCHAT_NET_EVENT_BUDGET; budget > 0; budget--) {
+        if ((event = sqchat_spsc_queue_pop(connection->events)) == NULL) {
+            /* Let the I/O thread know it needs to schedule us again, unless it
+             * managed to squeeze something in before it could see that
+             */
+            g_atomic_int_set(&connection->events_scheduled, 0);
+            if (sqchat_spsc_queue_is_empty(connection->events) ||
+                !g_atomic_int_compare_and_exchange(
+                    &connection->events_scheduled, 0, 1))
+                break;
+
+            continue;
+        }
+
+        if (g_atomic_int_get(&queue_full_waiting)) {
+            g_mutex_lock(&queue_full_mutex);
+            g_cond_signal(&queue_full_cond);
+            g_mutex_unlock(&queue_full_mutex);
+        }
+
+        connection_alive = deliver_event(connection, event);
+        sqchat_net_event_free(event);
+
+        if (!connection_alive)
+            break;
+    }
+
+    sqchat_histogram_add(&sqchat_stats.dispatch_time,
+                         sqchat_stats_now() - start);
+
+    /* If we ran out of budget, there's still more to do. Otherwise the
+     * connection's either out of events or gone
+     */
+    return budget == 0;
+}
+
+/* Hands an event off to the main thread. Should only be called from the I/O
+ * thread. If the main thread is too far behind, this blocks until it catches
+ * up.
+ */
+void sqchat_net_io_post(struct sqchat_connection * connection,
+                        struct sqchat_net_event * event) {
+    if (!sqchat_spsc_queue_push(connection->events, event)) {
+        g_mutex_lock(&queue_full_mutex);
+        g_atomic_int_set(&queue_full_waiting, 1);
+
+        while (!sqchat_spsc_queue_push(connection->events, event))
+            g_cond_wait(&queue_full_cond, &queue_full_mutex);
+
+        g_atomic_int_set(&queue_full_waiting, 0);
+        g_mutex_unlock(&queue_full_mutex);
+    }
+
+    /* Only one dispatch should be scheduled for a connection at a time,
+     * otherwise there could still be one left over after it's been freed
+     */
+    if (g_atomic_int_compare_and_exchange(&connection->events_scheduled, 0, 1))
+        g_idle_add((GSourceFunc)dispatch_events, connection);
+}
+
+struct sqchat_net_event * sqchat_net_event_new(int type) {
+    struct sqchat_net_event * event =
+        calloc(1, sizeof(struct sqchat_net_event));
+
+    event->type = type;
+    return event;
+}
+
+void sqchat_net_event_free(struct sqchat_net_event * event) {
+    free(event->msg);
+    g_free(event->error);
+    free(event);
+}
+
+static gboolean io_free_cb(gpointer data) {
+    return FALSE;
+}
+
+/* Frees something the I/O thread might still be in the middle of using, once
+ * it's done with whatever it's doing
+ */
+void sqchat_net_io_free(gpointer data, GDestroyNotify free_func) {
+    GSource * source = g_idle_source_new();
+
+    // The data gets freed when the source is destroyed
+    g_source_set_callback(source, io_free_cb, data, free_func);
+    g_source_attach(source, io_context);
+    g_source_unref(source);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,75 @@
+/* The thread that does all of the reading from our connections, and the queue
+ * it uses to hand what it reads back to the main thread
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NET_IO_THREAD_H__
+#define __NET_IO_THREAD_H__
+
+#include "irc_connection.h"
+#include "irc_message.h"
+
+#include <glib.h>
+#include <stdbool.h>
+
+// How many events can be waiting on the main thread for a single connection
+#define SQCHAT_NET_EVENT_QUEUE_LEN 1024
+
+/* The most events we'll handle for a single connection before giving the rest
+ * of the main loop a chance to run
+ */
+#define SQCHAT_NET_EVENT_BUDGET 256
+
+struct sqchat_net_event {
+    enum {
+        SQCHAT_NET_EVENT_MSG,
+        /* The server wants another handshake. The I/O thread stops reading
+         * from the connection until it's told to watch it again
+         */
+        SQCHAT_NET_EVENT_REHANDSHAKE,
+        /* The connection was closed or failed. This is always the last event
+         * for a connection
+         */
+        SQCHAT_NET_EVENT_CLOSED
+    } type;
+
+    struct sqchat_msg * msg;
+
+    /* If the connection failed, what went wrong, and the quit message to send
+     * to the server if we should still send one
+     */
+    char * error;
+    const char * quit_msg;
+};
+
+extern void sqchat_net_io_thread_init();
+
+extern void sqchat_net_io_watch(struct sqchat_connection * connection,
+                                GIOFunc func)
+    _attr_nonnull(1, 2);
+extern void sqchat_net_io_post(struct sqchat_connection * connection,
+                               struct sqchat_net_event * event)
+    _attr_nonnull(1, 2);
+
+extern void sqchat_net_io_free(gpointer data, GDestroyNotify free_func)
+    _attr_nonnull(1, 2);
+
+extern struct sqchat_net_event * sqchat_net_event_new(int type);
+extern void sqchat_net_event_free(struct sqchat_net_event * event)
+    _attr_nonnull(1);
+
+#endif // __NET_IO_THREAD_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,288 @@
+/* Folds the flood of quits from a netsplit, and the joins once it's over, into
+ * a single line for each channel
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "netsplit.h"
+#include "format.h"
+#include "trie.h"
+#include "ui/buffer.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The quits or joins in a channel that haven't been printed yet
+struct pending {
+    GString * nicknames;
+    unsigned int count;
+};
+
+struct sqchat_netsplit {
+    struct sqchat_network * network;
+
+    // The two servers that split from each other
+    char * server1;
+    char * server2;
+
+    /* Everyone who quit in the split, so we can tell when they come back. Each
+     * one maps to how many channels they still haven't rejoined.
+     */
+    sqchat_trie * users;
+
+    // Pending quits and joins, keyed by the channel they happened in
+    GHashTable * quits;
+    GHashTable * joins;
+
+    gint64 last_event;
+    guint print_timer;
+    guint forget_timer;
+};
+
+static struct sqchat_format quit_format =
+    SQCHAT_FORMAT("* Netsplit between $0 and $1, $2 quit: $3\n");
+static struct sqchat_format join_format =
+    SQCHAT_FORMAT("* Netsplit between $0 and $1 is over, $2 rejoined: $3\n");
+
+static bool is_server_name(const char * start, const char * end) {
+    if (start == end || *start == '.' || end[-1] == '.' ||
+        memchr(start, '.', end - start) == NULL)
+        return false;
+
+    for (const char * c = start; c < end; c++) {
+        if (!g_ascii_isalnum(*c) && strchr(".-_*", *c) == NULL)
+            return false;
+    }
+
+    return true;
+}
+
+/* When servers split, the quit message for everyone on the other side is just
+ * the names of the two servers, like "hub.example.net leaf.example.net". Users
+ * can't fake this, since servers put "Quit: " in front of quit messages that
+ * come from users.
+ */
+bool sqchat_netsplit_is_split_quit(const char * quit_msg) {
+    const char * space = strchr(quit_msg, ' ');
+
+    return space != NULL && strchr(space + 1, ' ') == NULL &&
+           is_server_name(quit_msg, space) &&
+           is_server_name(space + 1, space + 1 + strlen(space + 1));
+}
+
+static void free_pending(struct pending * pending) {
+    g_string_free(pending->nicknames, TRUE);
+    free(pending);
+}
+
+static void print_pending(struct sqchat_netsplit * netsplit,
+                          GHashTable * pending_events,
+                          struct sqchat_format * format) {
+    GHashTableIter iter;
+    struct sqchat_buffer * channel;
+    struct pending * pending;
+
+    g_hash_table_iter_init(&iter, pending_events);
+    while (g_hash_table_iter_next(&iter, (gpointer*)&channel,
+                                  (gpointer*)&pending)) {
+        char count[sizeof("4294967295 users")];
+
+        snprintf(count, sizeof(count), "%u %s", pending->count,
+                 pending->count == 1 ? "user" : "users");
+        if (pending->count > SQCHAT_NETSPLIT_LIST_MAX)
+            g_string_append_printf(pending->nicknames, " and %u more",
+                                   pending->count - SQCHAT_NETSPLIT_LIST_MAX);
+
+        sqchat_buffer_format(channel, format, netsplit->server1,
+                             netsplit->server2, count,
+                             pending->nicknames->str);
+    }
+
+    g_hash_table_remove_all(pending_events);
+}
+
+static void free_netsplit(struct sqchat_netsplit * netsplit) {
+    if (netsplit->print_timer)
+        g_source_remove(netsplit->print_timer);
+    if (netsplit->forget_timer)
+        g_source_remove(netsplit->forget_timer);
+
+    // Don't lose anything that hasn't been printed yet
+    print_pending(netsplit, netsplit->quits, &quit_format);
+    print_pending(netsplit, netsplit->joins, &join_format);
+
+    g_hash_table_destroy(netsplit->quits);
+    g_hash_table_destroy(netsplit->joins);
+    sqchat_trie_free(netsplit->users, NULL, NULL);
+    free(netsplit->server1);
+    free(netsplit->server2);
+    free(netsplit);
+}
+
+// Gives up on waiting for anyone else from the split to come back
+static gboolean forget_cb(struct sqchat_netsplit * netsplit) {
+    struct sqchat_network * network = netsplit->network;
+
+    netsplit->forget_timer = 0;
+    network->netsplits = g_slist_remove(network->netsplits, netsplit);
+    free_netsplit(netsplit);
+
+    return G_SOURCE_REMOVE;
+}
+
+// Only prints anything once the quits or joins stop coming in
+static gboolean print_cb(struct sqchat_netsplit * netsplit) {
+    if (g_get_monotonic_time() - netsplit->last_event <
+        SQCHAT_NETSPLIT_WAIT * 1000)
+        return G_SOURCE_CONTINUE;
+
+    print_pending(netsplit, netsplit->quits, &quit_format);
+    print_pending(netsplit, netsplit->joins, &join_format);
+
+    netsplit->print_timer = 0;
+    netsplit->forget_timer =
+        g_timeout_add_seconds(SQCHAT_NETSPLIT_FORGET, (GSourceFunc)forget_cb,
+                              netsplit);
+    return G_SOURCE_REMOVE;
+}
+
+static void add_pending(struct sqchat_netsplit * netsplit,
+                        GHashTable * pending_events,
+                        struct sqchat_buffer * channel,
+                        const char * nickname) {
+    struct pending * pending = g_hash_table_lookup(pending_events, channel);
+
+    if (pending == NULL) {
+        pending = malloc(sizeof(struct pending));
+        pending->nicknames = g_string_new(NULL);
+        pending->count = 0;
+        g_hash_table_insert(pending_events, channel, pending);
+    }
+
+    if (pending->count++ < SQCHAT_NETSPLIT_LIST_MAX) {
+        if (pending->nicknames->len != 0)
+            g_string_append(pending->nicknames, ", ");
+        g_string_append(pending->nicknames, nickname);
+    }
+
+    netsplit->last_event = g_get_monotonic_time();
+    if (netsplit->print_timer == 0)
+        netsplit->print_timer = g_timeout_add(SQCHAT_NETSPLIT_WAIT,
+                                              (GSourceFunc)print_cb, netsplit);
+    if (netsplit->forget_timer != 0) {
+        g_source_remove(netsplit->forget_timer);
+        netsplit->forget_timer = 0;
+    }
+}
+
+/* Finds the netsplit a quit message belongs to, and starts keeping track of a
+ * new one if it's the first we've heard of it
+ */
+struct sqchat_netsplit * sqchat_netsplit_get(struct sqchat_network * network,
+                                             const char * quit_msg) {
+    const char * space = strchr(quit_msg, ' ');
+    size_t server1_len = space - quit_msg;
+    struct sqchat_netsplit * netsplit;
+
+    for (GSList * l = network->netsplits; l != NULL; l = l->next) {
+        netsplit = l->data;
+
+        if (strncmp(netsplit->server1, quit_msg, server1_len) == 0 &&
+            netsplit->server1[server1_len] == '\0' &&
+            strcmp(netsplit->server2, space + 1) == 0)
+            return netsplit;
+    }
+
+    netsplit = calloc(1, sizeof(struct sqchat_netsplit));
+    netsplit->network = network;
+    netsplit->server1 = strndup(quit_msg, server1_len);
+    netsplit->server2 = strdup(space + 1);
+    netsplit->users = sqchat_trie_new(network->casemap_lower ?
+                                      network->casemap_lower :
+                                      sqchat_trie_rfc1459_strtolower);
+    netsplit->quits = g_hash_table_new_full(NULL, NULL, NULL,
+                                            (GDestroyNotify)free_pending);
+    netsplit->joins = g_hash_table_new_full(NULL, NULL, NULL,
+                                            (GDestroyNotify)free_pending);
+
+    /* If all of the quits end up getting filtered, nothing else would ever
+     * get rid of it
+     */
+    netsplit->forget_timer =
+        g_timeout_add_seconds(SQCHAT_NETSPLIT_FORGET, (GSourceFunc)forget_cb,
+                              netsplit);
+
+    network->netsplits = g_slist_prepend(network->netsplits, netsplit);
+    return netsplit;
+}
+
+void sqchat_netsplit_add_quit(struct sqchat_netsplit * netsplit,
+                              struct sqchat_buffer * channel,
+                              const char * nickname) {
+    guint channels = GPOINTER_TO_UINT(sqchat_trie_get(netsplit->users,
+                                                      nickname));
+
+    sqchat_trie_set(netsplit->users, nickname, GUINT_TO_POINTER(channels + 1));
+    add_pending(netsplit, netsplit->quits, channel, nickname);
+}
+
+/* Returns true if the user joining is coming back from a netsplit, in which
+ * case the join gets folded in with the others instead of being printed. Once
+ * they're back in every channel they quit from, any joins after that are just
+ * normal joins. This is called for every join, so it's important that it's
+ * cheap when there's no netsplit going on.
+ */
+bool sqchat_netsplit_add_join(struct sqchat_network * network,
+                              struct sqchat_buffer * channel,
+                              const char * nickname) {
+    for (GSList * l = network->netsplits; l != NULL; l = l->next) {
+        struct sqchat_netsplit * netsplit = l->data;
+        guint channels = GPOINTER_TO_UINT(sqchat_trie_get(netsplit->users,
+                                                          nickname));
+
+        if (channels == 0)
+            continue;
+
+        if (channels == 1)
+            sqchat_trie_del(netsplit->users, nickname);
+        else
+            sqchat_trie_set(netsplit->users, nickname,
+                            GUINT_TO_POINTER(channels - 1));
+
+        add_pending(netsplit, netsplit->joins, channel, nickname);
+        return true;
+    }
+
+    return false;
+}
+
+// Makes sure nothing gets printed to a buffer after it's been freed
+void sqchat_netsplit_forget_buffer(struct sqchat_buffer * buffer) {
+    for (GSList * l = buffer->network->netsplits; l != NULL; l = l->next) {
+        struct sqchat_netsplit * netsplit = l->data;
+
+        g_hash_table_remove(netsplit->quits, buffer);
+        g_hash_table_remove(netsplit->joins, buffer);
+    }
+}
+
+void sqchat_netsplit_free_all(struct sqchat_network * network) {
+    g_slist_free_full(network->netsplits, (GDestroyNotify)free_netsplit);
+    network->netsplits = NULL;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,62 @@
+/* Folds the flood of quits from a netsplit, and the joins once it's over, into
+ * a single line for each channel
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NETSPLIT_H__
+#define __NETSPLIT_H__
+
+#include "irc_network.h"
+
+#include <stdbool.h>
+
+/* How long things have to stay quiet (in milliseconds) before the quits or
+ * joins that have piled up get printed
+ */
+#define SQCHAT_NETSPLIT_WAIT 1500
+/* How long after the last sign of a netsplit (in seconds) we stop waiting for
+ * the users in it to come back
+ */
+#define SQCHAT_NETSPLIT_FORGET (15 * 60)
+// How many nicknames get listed in each line before the rest are just counted
+#define SQCHAT_NETSPLIT_LIST_MAX 20
+
+struct sqchat_netsplit;
+struct sqchat_buffer;
+
+extern bool sqchat_netsplit_is_split_quit(const char * quit_msg)
+    _attr_nonnull(1);
+
+extern struct sqchat_netsplit * sqchat_netsplit_get(
+    struct sqchat_network * network,
+    const char * quit_msg)
+    _attr_nonnull(1, 2);
+extern void sqchat_netsplit_add_quit(struct sqchat_netsplit * netsplit,
+                                     struct sqchat_buffer * channel,
+                                     const char * nickname)
+    _attr_nonnull(1, 2, 3);
+extern bool sqchat_netsplit_add_join(struct sqchat_network * network,
+                                     struct sqchat_buffer * channel,
+                                     const char * nickname)
+    _attr_nonnull(1, 2, 3);
+
+extern void sqchat_netsplit_forget_buffer(struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+extern void sqchat_netsplit_free_all(struct sqchat_network * network)
+    _attr_nonnull(1);
+
+#endif // __NETSPLIT_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,69 @@
+/* Picks a color for each nickname, so the same person always shows up in the
+ * same color
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nick_color.h"
+#include "casemap.h"
+
+#include <glib.h>
+
+/* Only the colors that can be read on both light and dark backgrounds get
+ * used. The codes are written out ahead of time so printing a nickname's color
+ * never has to format anything.
+ */
+#define PALETTE_COLOR(_color, _code) { _color, "\x03" _code }
+
+static const struct {
+    int color;
+    const char * code;
+} palette[] = {
+    PALETTE_COLOR(2, "02"),  // Blue
+    PALETTE_COLOR(3, "03"),  // Green
+    PALETTE_COLOR(4, "04"),  // Red
+    PALETTE_COLOR(5, "05"),  // Brown
+    PALETTE_COLOR(6, "06"),  // Purple
+    PALETTE_COLOR(7, "07"),  // Orange
+    PALETTE_COLOR(9, "09"),  // Light green
+    PALETTE_COLOR(10, "10"), // Cyan
+    PALETTE_COLOR(11, "11"), // Light cyan
+    PALETTE_COLOR(12, "12"), // Light blue
+    PALETTE_COLOR(13, "13")  // Pink
+};
+
+#define PALETTE_SIZE (sizeof(palette) / sizeof(palette[0]))
+
+// FNV-1a over the casefolded nickname
+static unsigned int palette_entry(const char * nickname) {
+    guint32 hash = 2166136261U;
+
+    for (const char * c = nickname; *c != '\0'; c++) {
+        hash ^= (guint8)sqchat_rfc1459_tolower(*c);
+        hash *= 16777619U;
+    }
+
+    return hash % PALETTE_SIZE;
+}
+
+int sqchat_nick_color(const char * nickname) {
+    return palette[palette_entry(nickname)].color;
+}
+
+const char * sqchat_nick_color_code(const char * nickname) {
+    return palette[palette_entry(nickname)].code;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,35 @@
+/* Picks a color for each nickname, so the same person always shows up in the
+ * same color
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NICK_COLOR_H__
+#define __NICK_COLOR_H__
+
+/* Returns the mIRC color number for a nickname. Nicknames that only differ in
+ * case get the same color.
+ */
+extern int sqchat_nick_color(const char * nickname)
+    _attr_nonnull(1);
+
+/* Returns the formatting code that turns text the nickname's color, which is
+ * meant to be printed right before the nickname
+ */
+extern const char * sqchat_nick_color_code(const char * nickname)
+    _attr_nonnull(1);
+
+#endif // __NICK_COLOR_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
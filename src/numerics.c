@@ -24,6 +24,7 @@
 #include "net_io.h"
 #include "ui/user_list.h"
 #include "ui/network_tree.h"
+#include "format.h"
 
 #include <errno.h>
 #include <string.h>
@@ -62,9 +63,16 @@ void sqchat_init_numerics() {
                     short argc,                             \
                     char * argv[])
 
+// Prints a template, using the numeric's parameters as it's arguments
+#define PRINT_PARAMS(_buffer, _format)                                      \
+    sqchat_buffer_print_format((_buffer), (_format), argc,                  \
+                               (const char * const *)argv)
+
+static struct sqchat_format echo_argv_1_format = SQCHAT_FORMAT("$1\n");
+
 // Used for numerics that just give us a message requiring no special handling
 NUMERIC_CB(sqchat_echo_argv_1) {
-    sqchat_buffer_print(network->buffer, "%s\n", argv[1]);
+    PRINT_PARAMS(network->buffer, &echo_argv_1_format);
     return 0;
 }
 
@@ -121,6 +129,7 @@ NUMERIC_CB(sqchat_rpl_isupport) {
             case ISUPPORT_NETWORK:
                 free(network->name);
                 network->name = strdup(value);
+                sqchat_network_update_logs(network);
 
                 // Update the network name in the network tree
                 {
@@ -158,6 +167,8 @@ NUMERIC_CB(sqchat_rpl_isupport) {
                     network->casemap_upper = sqchat_trie_rfc1459_strtoupper;
                     network->casemap_lower = sqchat_trie_rfc1459_strtolower;
                 }
+                sqchat_highlighter_set_casemap(network->highlighter,
+                                               network->casemap_lower);
                 break;
         }
     }
@@ -222,11 +233,13 @@ NUMERIC_CB(sqchat_rpl_motdstart) {
     return 0;
 }
 
+static struct sqchat_format rpl_motd_format = SQCHAT_FORMAT("$1\n");
+
 NUMERIC_CB(sqchat_rpl_motd) {
-    sqchat_buffer_print((network->claimed_responses) ?
-                        network->claimed_responses->buffer :
-                        network->buffer,
-                        "%s\n", argv[1]);
+    PRINT_PARAMS((network->claimed_responses) ?
+                 network->claimed_responses->buffer :
+                 network->buffer,
+                 &rpl_motd_format);
     return 0;
 }
 
@@ -241,6 +254,9 @@ NUMERIC_CB(sqchat_rpl_endofmotd) {
     return 0;
 }
 
+static struct sqchat_format rpl_topic_format =
+    SQCHAT_FORMAT("* Topic for $1 is \"$2\"\n");
+
 NUMERIC_CB(sqchat_rpl_topic) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
@@ -253,10 +269,13 @@ NUMERIC_CB(sqchat_rpl_topic) {
     else if ((output = sqchat_trie_get(network->buffers, argv[1])) == NULL)
         output = network->buffer;
 
-    sqchat_buffer_print(output, "* Topic for %s is \"%s\"\n", argv[1], argv[2]);
+    PRINT_PARAMS(output, &rpl_topic_format);
     return 0;
 }
 
+static struct sqchat_format rpl_notopic_format =
+    SQCHAT_FORMAT("* No topic set for $1\n");
+
 NUMERIC_CB(sqchat_rpl_notopic) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
@@ -269,10 +288,13 @@ NUMERIC_CB(sqchat_rpl_notopic) {
     else if ((output = sqchat_trie_get(network->buffers, argv[1])) == NULL)
         output = network->buffer;
 
-    sqchat_buffer_print(output, "* No topic set for %s\n", argv[1]);
+    PRINT_PARAMS(output, &rpl_notopic_format);
     return 0;
 }
 
+static struct sqchat_format rpl_topicwhotime_format =
+    SQCHAT_FORMAT("* Set by $0 ($1)\n");
+
 NUMERIC_CB(sqchat_rpl_topicwhotime) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
@@ -292,10 +314,13 @@ NUMERIC_CB(sqchat_rpl_topicwhotime) {
 
     sqchat_split_hostmask(argv[2], &nickname, &address);
 
-    sqchat_buffer_print(output, "* Set by %s (%s)\n", nickname, address);
+    sqchat_buffer_format(output, &rpl_topicwhotime_format, nickname, address);
     return 0;
 }
 
+static struct sqchat_format rpl_channelmodeis_format =
+    SQCHAT_FORMAT("The modes for $1 are: $2\r\n");
+
 NUMERIC_CB(sqchat_rpl_channelmodeis) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
@@ -310,8 +335,7 @@ NUMERIC_CB(sqchat_rpl_channelmodeis) {
     else if ((output = sqchat_trie_get(network->buffers, argv[1])) == NULL)
         output = network->buffer;
 
-    sqchat_buffer_print(output, "The modes for %s are: %s\r\n",
-                        argv[1], argv[2]);
+    PRINT_PARAMS(output, &rpl_channelmodeis_format);
     return 0;
 }
 
@@ -345,17 +369,22 @@ NUMERIC_CB(sqchat_rpl_creationtime) {
     return 0;
 }
 
+static struct sqchat_format rpl_whoisuser_format =
+    SQCHAT_FORMAT("[$1] address is: $2@$3\n[$1] real name is: $5\n");
+
 NUMERIC_CB(sqchat_rpl_whoisuser) {
     if (argc < 6)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "[%s] address is: %s@%s\n"
-                        "[%s] real name is: %s\n",
-                        argv[1], argv[2], argv[3], argv[1], argv[5]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoisuser_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoisserver_format =
+    SQCHAT_FORMAT("[$1] connected to $2\n");
+static struct sqchat_format rpl_whoisserver_info_format =
+    SQCHAT_FORMAT("[$1] connected to $2: $3\n");
+
 NUMERIC_CB(sqchat_rpl_whoisserver) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
@@ -363,118 +392,141 @@ NUMERIC_CB(sqchat_rpl_whoisserver) {
     struct sqchat_buffer * output = sqchat_route_rpl(network);
 
     if (argc == 3)
-        sqchat_buffer_print(output, "[%s] connected to %s\n", argv[1],
-                            argv[2]);
+        PRINT_PARAMS(output, &rpl_whoisserver_format);
     else
-        sqchat_buffer_print(output, "[%s] connected to %s: %s\n", argv[1],
-                            argv[2], argv[3]);
+        PRINT_PARAMS(output, &rpl_whoisserver_info_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoisoperator_format =
+    SQCHAT_FORMAT("[$1] $2\n");
+
 NUMERIC_CB(sqchat_rpl_whoisoperator) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "[%s] %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoisoperator_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoisidle_format =
+    SQCHAT_FORMAT("[$1] has been idle for $2 seconds\n");
+
 NUMERIC_CB(sqchat_rpl_whoisidle) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "[%s] has been idle for %s seconds\n",
-                        argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoisidle_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoischannels_format =
+    SQCHAT_FORMAT("[$1] channels: $2\n");
+
 NUMERIC_CB(sqchat_rpl_whoischannels) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "[%s] channels: %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoischannels_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoissecure_format = SQCHAT_FORMAT("[$1] $2\n");
+
 NUMERIC_CB(sqchat_rpl_whoissecure) {
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "[%s] %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoissecure_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoisaccount_format =
+    SQCHAT_FORMAT("[$1] $3 $2\n");
+
 NUMERIC_CB(sqchat_rpl_whoisaccount) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "[%s] %s %s\n",
-                        argv[1], argv[3], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoisaccount_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whoisactually_format =
+    SQCHAT_FORMAT("[$1] $3 $2\n");
+
 NUMERIC_CB(sqchat_rpl_whoisactually) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "[%s] %s %s\n",
-                        argv[1], argv[3], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whoisactually_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whois_generic_format =
+    SQCHAT_FORMAT("[$1] $2\n");
+
 // Used for all whois replies that pretty much just echo back their arguments
 NUMERIC_CB(sqchat_rpl_whois_generic) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "[%s] %s\n",
-                        argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whois_generic_format);
     return 0;
 }
 
+static struct sqchat_format rpl_endofwhois_format =
+    SQCHAT_FORMAT("[$1] End of WHOIS.\n");
+
 NUMERIC_CB(sqchat_rpl_endofwhois) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "[%s] End of WHOIS.\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_endofwhois_format);
     return 0;
 }
 
+static struct sqchat_format rpl_whowasuser_format =
+    SQCHAT_FORMAT("[$1] address was: $2@$3\n[$1] real name was: $5\n");
+
 NUMERIC_CB(sqchat_rpl_whowasuser) {
     if (argc < 6)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "[%s] address was: %s@%s\n"
-                        "[%s] real name was: %s\n",
-                        argv[1], argv[2], argv[3], argv[1], argv[5]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_whowasuser_format);
     return 0;
 }
 
+static struct sqchat_format rpl_endofwhowas_format =
+    SQCHAT_FORMAT("[$1] End of WHOWAS.\n");
+
 NUMERIC_CB(sqchat_rpl_endofwhowas) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "[%s] End of WHOWAS.\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_endofwhowas_format);
     return 0;
 }
 
+static struct sqchat_format generic_error_format = SQCHAT_FORMAT("Error: $1\n");
+
 // Used for generic errors with only an error message
 NUMERIC_CB(sqchat_generic_error) {
     struct sqchat_buffer * output = sqchat_route_rpl_end(network);
 
-    sqchat_buffer_print(output, "Error: %s\n", argv[1]);
+    PRINT_PARAMS(output, &generic_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_network_error_format =
+    SQCHAT_FORMAT("Error: $1\n");
+
 // Used for errors that can potentially affect the status of the connection
 NUMERIC_CB(sqchat_generic_network_error) {
-    sqchat_buffer_print(network->buffer, "Error: %s\n", argv[1]);
+    PRINT_PARAMS(network->buffer, &generic_network_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_channel_error_format =
+    SQCHAT_FORMAT("Error: $1: $2\n");
+
 // Used for generic errors that come with a channel argument
 NUMERIC_CB(sqchat_generic_channel_error) {
     if (argc < 3)
@@ -488,10 +540,13 @@ NUMERIC_CB(sqchat_generic_channel_error) {
     else if ((output = sqchat_trie_get(network->buffers, argv[1])) == NULL)
         output = network->buffer;
 
-    sqchat_buffer_print(output, "Error: %s: %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(output, &generic_channel_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_command_error_format =
+    SQCHAT_FORMAT("Error: $1: $2\n");
+
 // Used for generic errors that come with a command argument
 NUMERIC_CB(sqchat_generic_command_error) {
     if (argc < 3)
@@ -499,10 +554,13 @@ NUMERIC_CB(sqchat_generic_command_error) {
 
     struct sqchat_buffer * output = sqchat_route_rpl_end(network);
 
-    sqchat_buffer_print(output, "Error: %s: %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(output, &generic_command_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_target_error_format =
+    SQCHAT_FORMAT("Error: $1: $2\n");
+
 // Used for errors with a single non-channel argument
 NUMERIC_CB(sqchat_generic_target_error) {
     if (argc < 3)
@@ -510,10 +568,13 @@ NUMERIC_CB(sqchat_generic_target_error) {
 
     struct sqchat_buffer * output = sqchat_route_rpl_end(network);
 
-    sqchat_buffer_print(output, "Error: %s: %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(output, &generic_target_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_user_channel_error_format =
+    SQCHAT_FORMAT("Error: $1 with $0: $2\n");
+
 // Used for errors with a user argument and a channel argument
 NUMERIC_CB(sqchat_generic_user_channel_error) {
     if (argc < 4)
@@ -521,16 +582,18 @@ NUMERIC_CB(sqchat_generic_user_channel_error) {
 
     struct sqchat_buffer * output = sqchat_route_rpl_end(network);
 
-    sqchat_buffer_print(output, "Error: %s with %s: %s\n",
-                        argv[1], argv[0], argv[2]);
+    PRINT_PARAMS(output, &generic_user_channel_error_format);
     return 0;
 }
 
+static struct sqchat_format generic_lusers_rpl_format =
+    SQCHAT_FORMAT("$1 $2\n");
+
 NUMERIC_CB(sqchat_generic_lusers_rpl) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "%s %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &generic_lusers_rpl_format);
     return 0;
 }
 
@@ -542,40 +605,46 @@ NUMERIC_CB(sqchat_rpl_localglobalusers) {
     return 0;
 }
 
+static struct sqchat_format rpl_inviting_format =
+    SQCHAT_FORMAT("* Invitation for $1 to join $2 was successfully sent.\n");
+
 NUMERIC_CB(sqchat_rpl_inviting) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "* Invitation for %s to join %s was successfully sent.\n",
-                        argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_inviting_format);
     return 0;
 }
 
+static struct sqchat_format rpl_time_format =
+    SQCHAT_FORMAT("The local time for $1 is: $2\n");
+
 NUMERIC_CB(sqchat_rpl_time) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "The local time for %s is: %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_time_format);
     return 0;
 }
 
+static struct sqchat_format rpl_version_format =
+    SQCHAT_FORMAT("The server $2 is running $1: $3\n");
+
 NUMERIC_CB(sqchat_rpl_version) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "The server %s is running %s: %s\n",
-                        argv[2], argv[1], argv[3]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_version_format);
     return 0;
 }
 
+static struct sqchat_format rpl_info_format = SQCHAT_FORMAT("* $1\n");
+
 NUMERIC_CB(sqchat_rpl_info) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "* %s\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_info_format);
     return 0;
 }
 
@@ -584,24 +653,31 @@ NUMERIC_CB(sqchat_rpl_endofinfo) {
     return 0;
 }
 
+static struct sqchat_format rpl_nowaway_format = SQCHAT_FORMAT("* $1\n");
+
 NUMERIC_CB(sqchat_rpl_nowaway) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network), "* %s\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_nowaway_format);
     network->away = true;
     return 0;
 }
 
+static struct sqchat_format rpl_unaway_format = SQCHAT_FORMAT("* $1\n");
+
 NUMERIC_CB(sqchat_rpl_unaway) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network), "* %s\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_unaway_format);
     network->away = false;
     return 0;
 }
 
+static struct sqchat_format rpl_away_format =
+    SQCHAT_FORMAT("[$1 is away: $2]\n");
+
 // TODO: Add polling and all that good stuff for when a user becomes away
 NUMERIC_CB(sqchat_rpl_away) {
     if (argc < 3)
@@ -613,83 +689,93 @@ NUMERIC_CB(sqchat_rpl_away) {
         buffer = sqchat_buffer_new(argv[1], QUERY, network);
         sqchat_network_tree_buffer_add(buffer, network);
         buffer->query_data->away_msg = strdup(argv[2]);
-        sqchat_buffer_print(buffer, "[%s is away: %s]\n", argv[1], argv[2]);
+        PRINT_PARAMS(buffer, &rpl_away_format);
     }
     else if (strcmp(buffer->query_data->away_msg, argv[2]) != 0) {
         free(buffer->query_data->away_msg);
         buffer->query_data->away_msg = strdup(argv[2]);
-        sqchat_buffer_print(buffer, "[%s is away: %s]\n", argv[1], argv[2]);
+        PRINT_PARAMS(buffer, &rpl_away_format);
     }
     return 0;
 }
 
+static struct sqchat_format rpl_whoreply_format =
+    SQCHAT_FORMAT("[WHO $0] $1: $2$3 ($4@$5) on $6: $7\n");
+
 NUMERIC_CB(sqchat_rpl_whoreply) {
     if (argc < 8)
         return SQCHAT_MSG_ERR_ARGS;
 
     // TODO: Check if the claim was made by the client, or the user
     if (network->claimed_responses)
-        sqchat_buffer_print(network->claimed_responses->buffer,
-                            "[WHO %s] %s: %s%s (%s@%s) on %s: %s\n",
-                            argv[1], (argv[6][0] == 'H') ? "Here" : "Gone",
-                            (argv[6][1]) ? &argv[6][1] : "",
-                            argv[5], argv[2], argv[3], argv[4], argv[7]);
+        sqchat_buffer_format(network->claimed_responses->buffer,
+                             &rpl_whoreply_format,
+                             argv[1], (argv[6][0] == 'H') ? "Here" : "Gone",
+                             (argv[6][1]) ? &argv[6][1] : "",
+                             argv[5], argv[2], argv[3], argv[4], argv[7]);
     // TODO:Add an else here.
     return 0;
 }
 
+static struct sqchat_format rpl_endofwho_format =
+    SQCHAT_FORMAT("--- End of WHO for $1 ---\n");
+
 NUMERIC_CB(sqchat_rpl_endofwho) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
     if (SQCHAT_IS_CHAN(network, argv[1]))
-            sqchat_buffer_print(sqchat_route_rpl_end(network),
-                                "--- End of WHO for %s ---\n", argv[1]);
+            PRINT_PARAMS(sqchat_route_rpl_end(network), &rpl_endofwho_format);
     return 0;
 }
 
+static struct sqchat_format rpl_links_format = SQCHAT_FORMAT("* $1 $2 :$3\n");
+
 // TODO: Convert the RPL_LINKS input into a tree
 NUMERIC_CB(sqchat_rpl_links) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
     
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "* %s %s :%s\n", argv[1], argv[2], argv[3]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_links_format);
     return 0;
 }
 
+static struct sqchat_format rpl_endoflinks_format =
+    SQCHAT_FORMAT("--- End of LINKS for $0 ---\n");
+
 NUMERIC_CB(sqchat_rpl_endoflinks) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network),
-                        "--- End of LINKS for %s ---\n",
-                        (argv[1][0] == '*') ? network->server_name : argv[1]);
+    sqchat_buffer_format(sqchat_route_rpl_end(network), &rpl_endoflinks_format,
+                         (argv[1][0] == '*') ? network->server_name : argv[1]);
     return 0;
 }
 
+static struct sqchat_format rpl_liststart_format = SQCHAT_FORMAT("* $1 $2\n");
+
 NUMERIC_CB(sqchat_rpl_liststart) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "* %s %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_liststart_format);
     return 0;
 }
 
+static struct sqchat_format rpl_list_private_format =
+    SQCHAT_FORMAT("* <Private> $2\n");
+static struct sqchat_format rpl_list_format = SQCHAT_FORMAT("* $1 $2 \"$3\"\n");
+
 NUMERIC_CB(sqchat_rpl_list) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
     if (strcmp(argv[1], "Prv") == 0)
-        sqchat_buffer_print(sqchat_route_rpl(network),
-                            "* <Private> %s\n", argv[2]);
+        PRINT_PARAMS(sqchat_route_rpl(network), &rpl_list_private_format);
     else {
         if (argc < 4)
             return SQCHAT_MSG_ERR_ARGS;
-        sqchat_buffer_print(sqchat_route_rpl(network),
-                            "* %s %s \"%s\"\n",
-                            argv[1], argv[2], argv[3]);
+        PRINT_PARAMS(sqchat_route_rpl(network), &rpl_list_format);
     }
     return 0;
 }
@@ -700,69 +786,79 @@ NUMERIC_CB(sqchat_rpl_listend) {
     return 0;
 }
 
+static struct sqchat_format rpl_hosthidden_format = SQCHAT_FORMAT("$1 $2\n");
+
 NUMERIC_CB(sqchat_rpl_hosthidden) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
-    sqchat_buffer_print(network->buffer, "%s %s\n", argv[1], argv[2]);
+    PRINT_PARAMS(network->buffer, &rpl_hosthidden_format);
     return 0;
 }
 
+static struct sqchat_format generic_rpl_trace_format =
+    SQCHAT_FORMAT("$1 $2 $3\n");
+
 NUMERIC_CB(sqchat_generic_rpl_trace) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "%s %s %s\n",
-                        argv[1], argv[2], argv[3]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &generic_rpl_trace_format);
     return 0;
 }
 
+static struct sqchat_format rpl_traceoperator_format =
+    SQCHAT_FORMAT("$3 is logged in as an operator\n");
+
 NUMERIC_CB(sqchat_rpl_traceoperator) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "%s is logged in as an operator\n",
-                        argv[3]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_traceoperator_format);
     return 0;
 }
 
+static struct sqchat_format rpl_traceuser_format =
+    SQCHAT_FORMAT("$3 is logged in as a normal user\n");
+
 NUMERIC_CB(sqchat_rpl_traceuser) {
     if (argc < 4)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network),
-                        "%s is logged in as a normal "
-                        "user\n",
-                        argv[3]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_traceuser_format);
     return 0;
 }
 
+static struct sqchat_format rpl_tracelink_format =
+    SQCHAT_FORMAT("$1 $2 $3 $4\n");
+
 NUMERIC_CB(sqchat_rpl_tracelink) {
     if (argc < 5)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "%s %s %s %s\n",
-                        argv[1], argv[2], argv[3], argv[4]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_tracelink_format);
     return 0;
 }
 
+static struct sqchat_format rpl_traceserver_format =
+    SQCHAT_FORMAT("$1 $2 $3 $4 $5 $6\n");
+
 NUMERIC_CB(sqchat_rpl_traceserver) {
     if (argc < 7)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "%s %s %s %s %s %s\n",
-                        argv[1], argv[2], argv[3], argv[4], argv[5], argv[6]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_traceserver_format);
 
     return 0;
 }
 
+static struct sqchat_format rpl_traceservice_format =
+    SQCHAT_FORMAT("$1 $2 $3 $4\n");
+
 NUMERIC_CB(sqchat_rpl_traceservice) {
     if (argc < 5)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "%s %s %s %s\n",
-                        argv[1], argv[2], argv[3], argv[4]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &rpl_traceservice_format);
     return 0;
 }
 
@@ -772,27 +868,33 @@ NUMERIC_CB(sqchat_rpl_traceend) {
     return 0;
 }
 
+static struct sqchat_format rpl_snomask_format = SQCHAT_FORMAT("$2 $1\r\n");
+
 NUMERIC_CB(sqchat_rpl_snomask) {
     if (argc < 3)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(network->buffer, "%s %s\r\n", argv[2], argv[1]);
+    PRINT_PARAMS(network->buffer, &rpl_snomask_format);
     return 0;
 }
 
+static struct sqchat_format generic_echo_rpl_format = SQCHAT_FORMAT("$1\n");
+
 NUMERIC_CB(sqchat_generic_echo_rpl) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl(network), "%s\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl(network), &generic_echo_rpl_format);
     return 0;
 }
 
+static struct sqchat_format generic_echo_rpl_end_format = SQCHAT_FORMAT("$1\n");
+
 NUMERIC_CB(sqchat_generic_echo_rpl_end) {
     if (argc < 2)
         return SQCHAT_MSG_ERR_ARGS;
 
-    sqchat_buffer_print(sqchat_route_rpl_end(network), "%s\n", argv[1]);
+    PRINT_PARAMS(sqchat_route_rpl_end(network), &generic_echo_rpl_end_format);
     return 0;
 }
 
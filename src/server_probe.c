@@ -0,0 +1,215 @@
+/* Functions for racing connections to several of a network's servers at once in
+ * order to figure out which one is the fastest to connect to
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "server_probe.h"
+#include "irc_network.h"
+#include "addr_res.h"
+#include "ui/buffer.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+struct probe_candidate {
+    GSList * link;
+    sqchat_server * server;
+    int socket;
+    gint64 start_time;
+    gint64 rtt;
+};
+
+/* Adds a new latency sample to a server's history. Only the connection setup
+ * thread writes these, the main thread just reads them to show in /server.
+ */
+void sqchat_server_record_rtt(sqchat_server * server, gint64 rtt) {
+    gint64 avg;
+
+    rtt = MIN(rtt, G_MAXINT);
+    if (g_atomic_int_get(&server->rtt_samples) == 0)
+        avg = rtt;
+    else
+        avg = ((gint64)g_atomic_int_get(&server->rtt_avg) * 3 + rtt) / 4;
+
+    g_atomic_int_set(&server->rtt_last, rtt);
+    g_atomic_int_set(&server->rtt_avg, avg);
+    g_atomic_int_inc(&server->rtt_samples);
+    server->probe_failures = 0;
+}
+
+/* Servers we've connected to before come first, sorted by how fast they've been
+ * in the past, followed by the ones we don't know anything about yet. Servers
+ * that keep failing get pushed towards the back.
+ */
+static int compare_candidates(const void * a, const void * b) {
+    sqchat_server * server_a = ((struct probe_candidate*)a)->server;
+    sqchat_server * server_b = ((struct probe_candidate*)b)->server;
+    gint samples_a = g_atomic_int_get(&server_a->rtt_samples);
+    gint samples_b = g_atomic_int_get(&server_b->rtt_samples);
+    gint avg_a = g_atomic_int_get(&server_a->rtt_avg);
+    gint avg_b = g_atomic_int_get(&server_b->rtt_avg);
+
+    if (server_a->probe_failures != server_b->probe_failures)
+        return server_a->probe_failures < server_b->probe_failures ? -1 : 1;
+    else if (samples_a == 0 || samples_b == 0)
+        return (samples_b == 0) - (samples_a == 0);
+    else if (avg_a != avg_b)
+        return avg_a < avg_b ? -1 : 1;
+    else
+        return 0;
+}
+
+// Starts a non-blocking connection attempt to a server
+static int start_probe(struct probe_candidate * candidate) {
+    struct addrinfo * results;
+    struct addrinfo * rp;
+    int sock = -1;
+
+    if (sqchat_addr_res_lookup(candidate->server->address,
+                               candidate->server->port, &results) != 0)
+        return -1;
+
+    for (rp = results; rp != NULL; rp = rp->ai_next) {
+        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (sock == -1)
+            continue;
+
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+        candidate->start_time = g_get_monotonic_time();
+        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0 ||
+            errno == EINPROGRESS)
+            break;
+
+        close(sock);
+        sock = -1;
+    }
+
+    sqchat_addr_res_free(results);
+    return sock;
+}
+
+/* Races TCP connections to the first SQCHAT_SERVER_PROBE_COUNT servers for a
+ * network, and sets the network's current server to the one that answered
+ * first. Returns a connected socket for the winning server, or -1 if none of
+ * them could be reached. Once we have a winner, the rest of the servers get
+ * about as long again to finish so we can still record how fast they are. This
+ * blocks, so it should only be called from the connection setup thread.
+ */
+int sqchat_server_probe(struct sqchat_network * network) {
+    struct probe_candidate candidates[g_slist_length(network->servers)];
+    struct pollfd fds[SQCHAT_SERVER_PROBE_COUNT];
+    int candidate_count = 0;
+    int pending = 0;
+    int winner = -1;
+    gint64 deadline;
+
+    for (GSList * l = network->servers; l != NULL; l = g_slist_next(l)) {
+        candidates[candidate_count].link = l;
+        candidates[candidate_count].server = l->data;
+        candidate_count++;
+    }
+    qsort(candidates, candidate_count, sizeof(struct probe_candidate),
+          compare_candidates);
+    candidate_count = MIN(candidate_count, SQCHAT_SERVER_PROBE_COUNT);
+
+    sqchat_buffer_print(network->buffer,
+                        _("Probing %i servers for the fastest connection...\n"),
+                        candidate_count);
+
+    for (int i = 0; i < candidate_count; i++) {
+        candidates[i].rtt = 0;
+        fds[i].fd = candidates[i].socket = start_probe(&candidates[i]);
+        fds[i].events = POLLOUT;
+        if (fds[i].fd != -1)
+            pending++;
+        else
+            candidates[i].server->probe_failures++;
+    }
+
+    deadline = g_get_monotonic_time() + SQCHAT_SERVER_PROBE_TIMEOUT * 1000;
+    while (pending > 0) {
+        gint64 now = g_get_monotonic_time();
+        int err;
+        socklen_t err_len = sizeof(err);
+
+        if (now >= deadline ||
+            poll(fds, candidate_count, (deadline - now) / 1000 + 1) == -1)
+            break;
+
+        now = g_get_monotonic_time();
+        for (int i = 0; i < candidate_count; i++) {
+            if (fds[i].fd == -1 || fds[i].revents == 0)
+                continue;
+
+            pending--;
+            getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+            if (err != 0) {
+                candidates[i].server->probe_failures++;
+                close(fds[i].fd);
+                candidates[i].socket = -1;
+            }
+            else {
+                candidates[i].rtt = now - candidates[i].start_time;
+                sqchat_server_record_rtt(candidates[i].server,
+                                         candidates[i].rtt);
+
+                if (winner == -1) {
+                    winner = i;
+                    deadline = MIN(deadline, now + candidates[i].rtt);
+                }
+            }
+
+            // Stop polling this socket, we've heard all we need from it
+            fds[i].fd = -1;
+        }
+    }
+
+    // Close everything but the winner
+    for (int i = 0; i < candidate_count; i++) {
+        if (i != winner && candidates[i].socket != -1)
+            close(candidates[i].socket);
+        if (candidates[i].rtt != 0)
+            sqchat_buffer_print(network->buffer,
+                                _("\t%s:%s\t%.1f ms%s\n"),
+                                candidates[i].server->address,
+                                candidates[i].server->port,
+                                candidates[i].rtt / 1000.0,
+                                i == winner ? " *" : "");
+    }
+
+    if (winner == -1) {
+        sqchat_buffer_print(network->buffer,
+                            _("None of the servers responded in time.\n"));
+        return -1;
+    }
+
+    // The rest of the connection setup expects a blocking socket
+    fcntl(candidates[winner].socket, F_SETFL,
+          fcntl(candidates[winner].socket, F_GETFL) & ~O_NONBLOCK);
+    network->current_server = candidates[winner].link;
+
+    return candidates[winner].socket;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,38 @@
+/* Functions for racing connections to several of a network's servers at once in
+ * order to figure out which one is the fastest to connect to
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVER_PROBE_H__
+#define __SERVER_PROBE_H__
+
+#include "irc_network.h"
+
+#include <glib.h>
+
+// The maximum number of servers we'll try connecting to at once
+#define SQCHAT_SERVER_PROBE_COUNT       4
+// How long to wait for any of the servers to respond, in milliseconds
+#define SQCHAT_SERVER_PROBE_TIMEOUT     5000
+
+extern int sqchat_server_probe(struct sqchat_network * network)
+    _attr_nonnull(1);
+
+extern void sqchat_server_record_rtt(sqchat_server * server, gint64 rtt)
+    _attr_nonnull(1);
+
+#endif // __SERVER_PROBE_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
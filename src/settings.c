@@ -42,6 +42,20 @@ char * sqchat_default_username;
 char * sqchat_default_real_name;
 char * sqchat_fallback_encoding;
 
+bool sqchat_logging_enabled;
+char * sqchat_log_directory;
+int sqchat_log_max_size;
+int sqchat_log_fsync_interval;
+
+int sqchat_buffer_hibernate_after;
+
+char ** sqchat_highlight_keywords;
+
+char ** sqchat_ignore_masks;
+char ** sqchat_ignore_patterns;
+char ** sqchat_filter_hide_events;
+int sqchat_filter_large_channel_size;
+
 static void config_file_error(const char * file, GError * error);
 static void parse_settings(const char * filename, GKeyFile ** out);
 static void cache_settings(const char * filename);
@@ -52,6 +66,23 @@ static void try_to_load_setting_string(const char * filename,
                                        const char * setting,
                                        const char * default_value,
                                        char ** out);
+static void try_to_load_setting_integer(const char * filename,
+                                        GKeyFile * keyfile,
+                                        const char * group,
+                                        const char * setting,
+                                        int default_value,
+                                        int * out);
+static void try_to_load_setting_boolean(const char * filename,
+                                        GKeyFile * keyfile,
+                                        const char * group,
+                                        const char * setting,
+                                        bool default_value,
+                                        bool * out);
+static void try_to_load_setting_string_list(const char * filename,
+                                            GKeyFile * keyfile,
+                                            const char * group,
+                                            const char * setting,
+                                            char *** out);
 
 void sqchat_init_settings() {
     // Setup the quarks
@@ -165,6 +196,10 @@ void parse_settings(const char * filename, GKeyFile ** out) {
  */
 void cache_settings(const char * filename) {
     if (g_quark_from_static_string(filename) == main_settings_quark) {
+        char * default_log_dir = g_build_filename(g_get_user_data_dir(),
+                                                  "squirrelchat", "logs",
+                                                  NULL);
+
         try_to_load_setting_string("settings.conf", sqchat_main_settings,
                                    "main", "default_nickname",
                                    g_get_user_name(), &sqchat_default_nickname);
@@ -177,6 +212,46 @@ void cache_settings(const char * filename) {
         try_to_load_setting_string("settings.conf", sqchat_main_settings,
                                    "main", "fallback_encoding",
                                    "WINDOWS 1252", &sqchat_fallback_encoding);
+
+        try_to_load_setting_boolean("settings.conf", sqchat_main_settings,
+                                    "logging", "enabled", true,
+                                    &sqchat_logging_enabled);
+        try_to_load_setting_string("settings.conf", sqchat_main_settings,
+                                   "logging", "directory", default_log_dir,
+                                   &sqchat_log_directory);
+        try_to_load_setting_integer("settings.conf", sqchat_main_settings,
+                                    "logging", "max_size",
+                                    SQCHAT_DEFAULT_LOG_MAX_SIZE,
+                                    &sqchat_log_max_size);
+        try_to_load_setting_integer("settings.conf", sqchat_main_settings,
+                                    "logging", "fsync_interval",
+                                    SQCHAT_DEFAULT_LOG_FSYNC_INTERVAL,
+                                    &sqchat_log_fsync_interval);
+
+        try_to_load_setting_integer("settings.conf", sqchat_main_settings,
+                                    "buffers", "hibernate_after",
+                                    SQCHAT_DEFAULT_HIBERNATE_AFTER,
+                                    &sqchat_buffer_hibernate_after);
+
+        try_to_load_setting_string_list("settings.conf", sqchat_main_settings,
+                                        "highlights", "keywords",
+                                        &sqchat_highlight_keywords);
+
+        try_to_load_setting_string_list("settings.conf", sqchat_main_settings,
+                                        "ignore", "masks",
+                                        &sqchat_ignore_masks);
+        try_to_load_setting_string_list("settings.conf", sqchat_main_settings,
+                                        "ignore", "patterns",
+                                        &sqchat_ignore_patterns);
+        try_to_load_setting_string_list("settings.conf", sqchat_main_settings,
+                                        "filters", "hide_events",
+                                        &sqchat_filter_hide_events);
+        try_to_load_setting_integer("settings.conf", sqchat_main_settings,
+                                    "filters", "large_channel_size",
+                                    SQCHAT_DEFAULT_LARGE_CHANNEL_SIZE,
+                                    &sqchat_filter_large_channel_size);
+
+        g_free(default_log_dir);
     }
 }
 
@@ -197,6 +272,23 @@ void create_file(const char * filename) {
                               g_get_real_name());
         g_key_file_set_string(out, "main", "fallback_encoding",
                               "WINDOWS-1252");
+
+        g_key_file_set_boolean(out, "logging", "enabled", true);
+        g_key_file_set_integer(out, "logging", "max_size",
+                               SQCHAT_DEFAULT_LOG_MAX_SIZE);
+        g_key_file_set_integer(out, "logging", "fsync_interval",
+                               SQCHAT_DEFAULT_LOG_FSYNC_INTERVAL);
+
+        g_key_file_set_integer(out, "buffers", "hibernate_after",
+                               SQCHAT_DEFAULT_HIBERNATE_AFTER);
+
+        g_key_file_set_string_list(out, "highlights", "keywords", NULL, 0);
+
+        g_key_file_set_string_list(out, "ignore", "masks", NULL, 0);
+        g_key_file_set_string_list(out, "ignore", "patterns", NULL, 0);
+        g_key_file_set_string_list(out, "filters", "hide_events", NULL, 0);
+        g_key_file_set_integer(out, "filters", "large_channel_size",
+                               SQCHAT_DEFAULT_LARGE_CHANNEL_SIZE);
     }
     // placeholder, we should never reach this anyway
     else 
@@ -241,6 +333,77 @@ void try_to_load_setting_string(const char * filename,
     }
 }
 
+// Same as above, but for integers
+void try_to_load_setting_integer(const char * filename,
+                                 GKeyFile * keyfile,
+                                 const char * group,
+                                 const char * setting,
+                                 int default_value,
+                                 int * out) {
+    GError * error = NULL;
+    *out = g_key_file_get_integer(keyfile, group, setting, &error);
+    if (error != NULL) {
+        if (g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_GROUP_NOT_FOUND) ||
+            g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+            g_key_file_set_integer(keyfile, group, setting, default_value);
+            *out = default_value;
+            g_error_free(error);
+        }
+        else
+            config_file_error(filename, error);
+    }
+}
+
+// Same as above, but for booleans
+void try_to_load_setting_boolean(const char * filename,
+                                 GKeyFile * keyfile,
+                                 const char * group,
+                                 const char * setting,
+                                 bool default_value,
+                                 bool * out) {
+    GError * error = NULL;
+    *out = g_key_file_get_boolean(keyfile, group, setting, &error);
+    if (error != NULL) {
+        if (g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_GROUP_NOT_FOUND) ||
+            g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+            g_key_file_set_boolean(keyfile, group, setting, default_value);
+            *out = default_value;
+            g_error_free(error);
+        }
+        else
+            config_file_error(filename, error);
+    }
+}
+
+/* Same as above, but for lists of strings, which are separated by semicolons.
+ * Lists default to being empty.
+ */
+void try_to_load_setting_string_list(const char * filename,
+                                     GKeyFile * keyfile,
+                                     const char * group,
+                                     const char * setting,
+                                     char *** out) {
+    GError * error = NULL;
+    g_strfreev(*out);
+    *out = g_key_file_get_string_list(keyfile, group, setting, NULL, &error);
+    if (error != NULL) {
+        if (g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_GROUP_NOT_FOUND) ||
+            g_error_matches(error, G_KEY_FILE_ERROR,
+                            G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+            g_key_file_set_string_list(keyfile, group, setting, NULL, 0);
+            *out = g_new0(char *, 1);
+            g_error_free(error);
+        }
+        else
+            config_file_error(filename, error);
+    }
+}
+
 /* Error reporting function used internally by this file, since configuration
  * file errors need to be handled differently then most of the errors in
  * SquirrelChat
@@ -18,6 +18,18 @@
 
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <stdbool.h>
+
+// Log files are split once they get this big, in kilobytes
+#define SQCHAT_DEFAULT_LOG_MAX_SIZE         (16 * 1024)
+// How often logs are fsync'd, in seconds
+#define SQCHAT_DEFAULT_LOG_FSYNC_INTERVAL   5
+// How long a buffer goes unseen before it drops it's widgets, in minutes
+#define SQCHAT_DEFAULT_HIBERNATE_AFTER      10
+/* How many users a channel needs before the events in [filters] hide_events
+ * stop being shown in it
+ */
+#define SQCHAT_DEFAULT_LARGE_CHANNEL_SIZE   100
 
 extern char * sqchat_config_dir;
 extern char * sqchat_config_main_file_path;
@@ -35,5 +47,19 @@ extern char * sqchat_default_username;
 extern char * sqchat_default_real_name;
 extern char * sqchat_fallback_encoding;
 
+extern bool sqchat_logging_enabled;
+extern char * sqchat_log_directory;
+extern int sqchat_log_max_size;
+extern int sqchat_log_fsync_interval;
+
+extern int sqchat_buffer_hibernate_after;
+
+extern char ** sqchat_highlight_keywords;
+
+extern char ** sqchat_ignore_masks;
+extern char ** sqchat_ignore_patterns;
+extern char ** sqchat_filter_hide_events;
+extern int sqchat_filter_large_channel_size;
+
 #endif // __SETTINGS_H__
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,87 @@
+/* A fixed-size, lock-free queue for handing data from one thread to another
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spsc_queue.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+// Creates a new queue that can hold up to size items at once
+sqchat_spsc_queue * sqchat_spsc_queue_new(unsigned int size) {
+    sqchat_spsc_queue * queue = malloc(sizeof(sqchat_spsc_queue) +
+                                       (size + 1) * sizeof(void*));
+
+    queue->slot_count = size + 1;
+    queue->head = 0;
+    queue->tail = 0;
+
+    return queue;
+}
+
+/* Frees a queue, calling free_func on anything that was still left in it. This
+ * must not be called while either thread is still using the queue.
+ */
+void sqchat_spsc_queue_free(sqchat_spsc_queue * queue, void (*free_func)()) {
+    void * data;
+
+    while ((data = sqchat_spsc_queue_pop(queue)) != NULL)
+        if (free_func)
+            free_func(data);
+
+    free(queue);
+}
+
+/* Adds an item to the end of the queue. Returns false if the queue is full.
+ * Only the producer thread may call this.
+ */
+bool sqchat_spsc_queue_push(sqchat_spsc_queue * queue, void * data) {
+    unsigned int tail = g_atomic_int_get(&queue->tail);
+    unsigned int next = (tail + 1) % queue->slot_count;
+
+    if (next == (unsigned int)g_atomic_int_get(&queue->head))
+        return false;
+
+    /* The item has to be in place before the consumer can see the new tail,
+     * g_atomic_int_set() gives us the barrier we need for that
+     */
+    queue->slots[tail] = data;
+    g_atomic_int_set(&queue->tail, next);
+
+    return true;
+}
+
+/* Removes the item at the front of the queue and returns it, or NULL if the
+ * queue is empty. Only the consumer thread may call this.
+ */
+void * sqchat_spsc_queue_pop(sqchat_spsc_queue * queue) {
+    unsigned int head = g_atomic_int_get(&queue->head);
+    void * data;
+
+    if (head == (unsigned int)g_atomic_int_get(&queue->tail))
+        return NULL;
+
+    data = queue->slots[head];
+    g_atomic_int_set(&queue->head, (head + 1) % queue->slot_count);
+
+    return data;
+}
+
+bool sqchat_spsc_queue_is_empty(sqchat_spsc_queue * queue) {
+    return g_atomic_int_get(&queue->head) == g_atomic_int_get(&queue->tail);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
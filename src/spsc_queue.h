@@ -0,0 +1,54 @@
+/* A fixed-size, lock-free queue for handing data from one thread to another.
+ * It is only safe with exactly one thread pushing and one thread popping.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+typedef struct sqchat_spsc_queue sqchat_spsc_queue;
+
+struct sqchat_spsc_queue {
+    /* One slot is always left empty, so a queue holds one less item than it
+     * has slots
+     */
+    unsigned int slot_count;
+
+    // Only ever written to by the consumer
+    gint head;
+    // Only ever written to by the producer
+    gint tail;
+
+    void * slots[];
+};
+
+extern sqchat_spsc_queue * sqchat_spsc_queue_new(unsigned int size);
+extern void sqchat_spsc_queue_free(sqchat_spsc_queue * queue,
+                                   void (*free_func)())
+    _attr_nonnull(1);
+
+extern bool sqchat_spsc_queue_push(sqchat_spsc_queue * queue, void * data)
+    _attr_nonnull(1, 2);
+extern void * sqchat_spsc_queue_pop(sqchat_spsc_queue * queue)
+    _attr_nonnull(1);
+extern bool sqchat_spsc_queue_is_empty(sqchat_spsc_queue * queue)
+    _attr_nonnull(1);
+
+#endif // __SPSC_QUEUE_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
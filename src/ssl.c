@@ -19,38 +19,110 @@
 #include "irc_network.h"
 #include "connection_setup.h"
 #include "ui/buffer.h"
+#include "trie.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <gnutls/gnutls.h>
+#include <gnutls/crypto.h>
 #include <gnutls/x509.h>
 
 static int verify_certificate_cb(gnutls_session_t session);
 
+/* The trust store is the same for every connection, so it's only loaded when
+ * the first SSL connection needs it and then shared between all of the
+ * networks. Each network using it holds a reference, and so do we, until
+ * sqchat_ssl_free_credentials() is called at exit. That way reconnecting never
+ * has to parse the whole thing again, even when nothing else is using it.
+ */
+static gnutls_certificate_credentials_t shared_cred = NULL;
+static unsigned int shared_cred_refcount = 0;
+
+static void credentials_unref() {
+    if (--shared_cred_refcount != 0)
+        return;
+
+    gnutls_certificate_free_credentials(shared_cred);
+    shared_cred = NULL;
+}
+
+static gnutls_certificate_credentials_t
+credentials_ref(struct sqchat_network * network) {
+    if (shared_cred == NULL) {
+        int ret;
+
+        gnutls_certificate_allocate_credentials(&shared_cred);
+#ifdef USE_SYSTEM_TRUST
+        ret = gnutls_certificate_set_x509_system_trust(shared_cred);
+#else
+        ret = gnutls_certificate_set_x509_trust_file(shared_cred,
+                                                     CAFILE_PATH,
+                                                     GNUTLS_X509_FMT_PEM);
+#endif
+        if (ret < 0)
+            sqchat_buffer_print(network->buffer,
+                                "Warning: Could not load the list of trusted "
+                                "CAs: %s\n",
+                                gnutls_strerror(ret));
+        else
+            sqchat_buffer_print(network->buffer,
+                                "Loaded %i trusted CA certificates.\n", ret);
+
+        gnutls_certificate_set_verify_function(shared_cred,
+                                               verify_certificate_cb);
+
+        // Our own reference, which keeps them loaded until exit
+        shared_cred_refcount = 1;
+    }
+
+    shared_cred_refcount++;
+    return shared_cred;
+}
+
+/* Releases a network's reference to the shared credentials. This must only be
+ * called once the network's SSL session is no longer going to be used.
+ */
+void sqchat_ssl_release_credentials(struct sqchat_network * network) {
+    if (network->ssl_cred == NULL)
+        return;
+
+    network->ssl_cred = NULL;
+    credentials_unref();
+}
+
+/* Drops our own reference to the shared credentials at exit. They're freed
+ * once the last network using them lets go too.
+ */
+void sqchat_ssl_free_credentials() {
+    if (shared_cred == NULL)
+        return;
+
+    credentials_unref();
+}
+
 void sqchat_begin_ssl_handshake(struct sqchat_network * network) {
     int ret;
     const char * err;
     sqchat_server * server = network->current_server->data;
+    struct sqchat_connection * connection = &network->connection;
 
-    int gtls = gnutls_init(&network->ssl_session, GNUTLS_CLIENT);
-    gnutls_certificate_allocate_credentials(&network->ssl_cred);
+    int gtls = gnutls_init(&connection->ssl_session, GNUTLS_CLIENT);
+    // Don't leak the reference from a previous session if we still hold it
+    sqchat_ssl_release_credentials(network);
+    network->ssl_cred = credentials_ref(network);
+    connection->ssl_session_store = &server->ssl_session_data;
 
-    gnutls_session_set_ptr(network->ssl_session, network);
-    gnutls_server_name_set(network->ssl_session, GNUTLS_NAME_DNS,
+    gnutls_session_set_ptr(connection->ssl_session, network);
+    gnutls_server_name_set(connection->ssl_session, GNUTLS_NAME_DNS,
                            server->address, strlen(server->address));
 
-    // Setup the trusted CAS file
-    gnutls_certificate_set_x509_trust_file(network->ssl_cred,
-                                           CAFILE_PATH,
-                                           GNUTLS_X509_FMT_PEM);
-    gnutls_certificate_set_verify_function(network->ssl_cred,
-                                           verify_certificate_cb);
-
-    gnutls_credentials_set(network->ssl_session, GNUTLS_CRD_CERTIFICATE,
+    gnutls_credentials_set(connection->ssl_session, GNUTLS_CRD_CERTIFICATE,
                            network->ssl_cred);
 
     // TODO: Add stuff for client certificate here
 
-    ret = gnutls_priority_set_direct(network->ssl_session, "NORMAL", &err);
+    ret = gnutls_priority_set_direct(connection->ssl_session, "NORMAL", &err);
     if (ret < 0) {
         sqchat_buffer_print(network->buffer,
                             "GnuTLS error: %s\n"
@@ -58,13 +130,18 @@ void sqchat_begin_ssl_handshake(struct sqchat_network * network) {
         goto ssl_handshake_error;
     }
 
-    gnutls_transport_set_ptr(network->ssl_session,
-                             (gnutls_transport_ptr_t)network->socket);
+    // Try to resume our last session with this server if we have one
+    if (server->ssl_session_data.data != NULL)
+        gnutls_session_set_data(connection->ssl_session,
+                                server->ssl_session_data.data,
+                                server->ssl_session_data.size);
+
+    gnutls_transport_set_ptr(connection->ssl_session,
+                             (gnutls_transport_ptr_t)connection->socket);
     sqchat_buffer_print(network->buffer,
                         "Performing SSL handshake...\n");
-    if ((ret = gnutls_handshake(network->ssl_session)) == GNUTLS_E_SUCCESS) {
-        sqchat_buffer_print(network->buffer,
-                            "Handshake complete!\n");
+    if ((ret = gnutls_handshake(connection->ssl_session)) == GNUTLS_E_SUCCESS) {
+        sqchat_ssl_handshake_complete(network);
         sqchat_begin_registration(network);
     }
     else if (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN)
@@ -79,100 +156,209 @@ void sqchat_begin_ssl_handshake(struct sqchat_network * network) {
     return;
 
 ssl_handshake_error:
-    gnutls_deinit(network->ssl_session);
-    gnutls_certificate_free_credentials(network->ssl_cred);
-    close(network->socket);
+    sqchat_connection_close(connection);
+    sqchat_ssl_release_credentials(network);
     network->status = DISCONNECTED;
 }
 
+// Called once the initial handshake for a connection has finished
+void sqchat_ssl_handshake_complete(struct sqchat_network * network) {
+    bool resumed = gnutls_session_is_resumed(network->connection.ssl_session);
+
+    network->ssl_handshakes++;
+    if (resumed)
+        network->ssl_resumed_handshakes++;
+
+    sqchat_buffer_print(network->buffer,
+                        "Handshake complete%s! (%u handshakes, %u resumed, "
+                        "%.0f%% resume ratio)\n",
+                        resumed ? ", resumed previous session" : "",
+                        network->ssl_handshakes,
+                        network->ssl_resumed_handshakes,
+                        network->ssl_resumed_handshakes * 100.0 /
+                        network->ssl_handshakes);
+
+    sqchat_connection_save_session(&network->connection);
+}
+
+/* Chains that have already been verified, keyed by a hash of the chain and the
+ * hostname it was verified against. This lets us skip verifying the same chain
+ * over and over again every time we reconnect to a server.
+ */
+struct verified_chain {
+    time_t expires;
+};
+
+static sqchat_trie * verified_chains = NULL;
+
+static void get_chain_fingerprint(const gnutls_datum_t * chain,
+                                  unsigned int chain_size,
+                                  const char * hostname,
+                                  char * fingerprint) {
+    gnutls_hash_hd_t hash;
+    unsigned char digest[SQCHAT_SSL_CHAIN_DIGEST_LEN];
+
+    gnutls_hash_init(&hash, GNUTLS_DIG_SHA256);
+    for (unsigned int i = 0; i < chain_size; i++)
+        gnutls_hash(hash, chain[i].data, chain[i].size);
+    gnutls_hash(hash, hostname, strlen(hostname));
+    gnutls_hash_deinit(hash, digest);
+
+    for (int i = 0; i < SQCHAT_SSL_CHAIN_DIGEST_LEN; i++)
+        sprintf(&fingerprint[i * 2], "%02x", digest[i]);
+}
+
+// Keeps a copy of the peer's certificate around in case the user asks for it
+static void save_peer_certificate(struct sqchat_network * network,
+                                  const gnutls_datum_t * cert) {
+    free(network->ssl_peer_cert.data);
+    network->ssl_peer_cert.data = malloc(cert->size);
+    network->ssl_peer_cert.size = cert->size;
+    memcpy(network->ssl_peer_cert.data, cert->data, cert->size);
+}
+
+static void print_certificate_info(struct sqchat_buffer * buffer,
+                                   gnutls_x509_crt_t cert) {
+    char * dn_subject_buf;
+    size_t dn_subject_buf_size = 0;
+    char * dn_issuer_buf;
+    size_t dn_issuer_buf_size = 0;
+    char * dn_strptr;
+    time_t expiration_time;
+
+    /* Figure out how large the buffer for holding DN information needs to
+     * be
+     */
+    gnutls_x509_crt_get_dn(cert, NULL, &dn_subject_buf_size);
+    dn_subject_buf = alloca(dn_subject_buf_size);
+    gnutls_x509_crt_get_issuer_dn(cert, NULL, &dn_issuer_buf_size);
+    dn_issuer_buf = alloca(dn_issuer_buf_size);
+
+    sqchat_buffer_print(buffer, "--- Certificate info ---\n");
+
+    // Print the name of the peer's certificate
+    gnutls_x509_crt_get_dn(cert, dn_subject_buf, &dn_subject_buf_size);
+    sqchat_buffer_print(buffer, "Subject:\n");
+    for (char * c = strtok_r(dn_subject_buf, ",", &dn_strptr);
+         c != NULL;
+         c = strtok_r(NULL, ",", &dn_strptr))
+        sqchat_buffer_print(buffer, "\t%s\n", c);
+
+    // Print the issuer information
+    gnutls_x509_crt_get_issuer_dn(cert, dn_issuer_buf, &dn_issuer_buf_size);
+    sqchat_buffer_print(buffer, "Issuer:\n");
+    for (char * c = strtok_r(dn_issuer_buf, ",", &dn_strptr);
+         c != NULL;
+         c = strtok_r(NULL, ",", &dn_strptr))
+        sqchat_buffer_print(buffer, "\t%s\n", c);
+
+    // Get the rest of the information
+    expiration_time = gnutls_x509_crt_get_expiration_time(cert);
+    sqchat_buffer_print(buffer,
+                        "Subject's certificate expires on %s",
+                        ctime(&expiration_time));
+}
+
+/* Prints the information for the certificate the network's server gave us the
+ * last time we connected to it
+ */
+void sqchat_ssl_print_peer_certificate(struct sqchat_buffer * buffer,
+                                       struct sqchat_network * network) {
+    gnutls_x509_crt_t cert;
+
+    if (network->ssl_peer_cert.data == NULL) {
+        sqchat_buffer_print(buffer,
+                            "No certificate has been received for this "
+                            "network.\n");
+        return;
+    }
+
+    gnutls_x509_crt_init(&cert);
+    if (gnutls_x509_crt_import(cert, &network->ssl_peer_cert,
+                               GNUTLS_X509_FMT_DER) == GNUTLS_E_SUCCESS)
+        print_certificate_info(buffer, cert);
+    else
+        sqchat_buffer_print(buffer, "Error: Could not read certificate.\n");
+    gnutls_x509_crt_deinit(cert);
+}
+
 static int verify_certificate_cb(gnutls_session_t session) {
-    unsigned int status;
+    unsigned int status = 0;
     int ret;
     time_t expiration_time;
+    time_t now = time(NULL);
     struct sqchat_network * network = gnutls_session_get_ptr(session);
     sqchat_server * server = network->current_server->data;
     unsigned int chain_size;
     const gnutls_datum_t * chain;
-    gnutls_x509_crt_t * cert;
+    gnutls_x509_crt_t cert;
+    char fingerprint[SQCHAT_SSL_CHAIN_DIGEST_LEN * 2 + 1];
+    struct verified_chain * verified;
 
-    // Retreive the peer's certificate chain and import it
+    // Retreive the peer's certificate chain
     chain = gnutls_certificate_get_peers(session, &chain_size);
-    cert = calloc(sizeof(*chain), chain_size);
-    for (unsigned int i = 0; i < chain_size; i++) {
-        gnutls_x509_crt_init(&cert[i]);
-        gnutls_x509_crt_import(cert[i], &chain[i], GNUTLS_X509_FMT_DER);
+    if (chain == NULL || chain_size == 0) {
+        sqchat_buffer_print(network->buffer,
+                            "The server did not provide a certificate.\n");
+        return GNUTLS_E_CERTIFICATE_ERROR;
     }
+    save_peer_certificate(network, &chain[0]);
+
+    // Check if we've already verified this exact chain
+    if (verified_chains == NULL)
+        verified_chains = sqchat_trie_new(NULL);
+
+    get_chain_fingerprint(chain, chain_size, server->address, fingerprint);
+    if ((verified = sqchat_trie_get(verified_chains, fingerprint)) != NULL) {
+        if (now < verified->expires)
+            return 0;
+
+        free(sqchat_trie_del(verified_chains, fingerprint));
+    }
+
+    // We only need to look at the peer's own certificate
+    gnutls_x509_crt_init(&cert);
+    gnutls_x509_crt_import(cert, &chain[0], GNUTLS_X509_FMT_DER);
 
     // Make sure the certificate checks out
 #if GNUTLS_VERSION_NUMBER >= 0x030104
     ret = gnutls_certificate_verify_peers3(session, server->address, &status);
     if (ret < 0)
-        goto verification_error;
+        goto verification_failed;
 #else
     ret = gnutls_certificate_verify_peers2(session, &status);
     if (ret < 0)
-        goto verification_error;
+        goto verification_failed;
 
     // Pre GnuTLS version 3.1.4, hostname checking was done seperately
     // Check the subject
-    ret = gnutls_x509_crt_check_hostname(cert[0], server->address);
+    ret = gnutls_x509_crt_check_hostname(cert, server->address);
     if (ret < 0)
-        goto verification_error;
+        goto verification_failed;
     // TODO: Check to see if we have to check the rest of the chain
 #endif
 
     // Make sure the certificate is not expired
-    expiration_time = gnutls_x509_crt_get_expiration_time(cert[0]);
-    if (expiration_time <= (time_t)g_get_real_time() * 1.0e-6)
+    expiration_time = gnutls_x509_crt_get_expiration_time(cert);
+    if (expiration_time <= now)
         status |= GNUTLS_CERT_EXPIRED;
 
-verification_error:
-
-    // Retrieve and display the certificate information
-    {
-        char * dn_subject_buf;
-        size_t dn_subject_buf_size;
-        char * dn_issuer_buf;
-        size_t dn_issuer_buf_size;
-        char * dn_strptr;
-        time_t expiration_time;
-
-        /* Figure out how large the buffer for holding DN information needs to
-         * be
-         */
-        gnutls_x509_crt_get_dn(cert[0], NULL, &dn_subject_buf_size);
-        dn_subject_buf = alloca(dn_subject_buf_size);
-        gnutls_x509_crt_get_issuer_dn(cert[0], NULL, &dn_issuer_buf_size);
-        dn_issuer_buf = alloca(dn_issuer_buf_size);
-
-        sqchat_buffer_print(network->buffer, "--- Certificate info ---\n");
-
-        // Print the name of the peer's certificate
-        gnutls_x509_crt_get_dn(cert[0], dn_subject_buf, &dn_subject_buf_size);
-        sqchat_buffer_print(network->buffer, "Subject:\n");
-        for (char * c = strtok_r(dn_subject_buf, ",", &dn_strptr);
-             c != NULL;
-             c = strtok_r(NULL, ",", &dn_strptr))
-            sqchat_buffer_print(network->buffer, "\t%s\n", c);
-
-        // Print the issuer information
-        gnutls_x509_crt_get_issuer_dn(cert[0], dn_issuer_buf,
-                                      &dn_issuer_buf_size);
-        sqchat_buffer_print(network->buffer, "Issuer:\n");
-        for (char * c = strtok_r(dn_issuer_buf, ",", &dn_strptr);
-             c != NULL;
-             c = strtok_r(NULL, ",", &dn_strptr))
-            sqchat_buffer_print(network->buffer, "\t%s\n", c);
-
-        // Get the rest of the information
-        expiration_time = gnutls_x509_crt_get_expiration_time(cert[0]);
-        sqchat_buffer_print(network->buffer,
-                            "Subject's certificate expires on %s",
-                            ctime(&expiration_time));
+    /* Remember that the chain checked out, at least until the certificate
+     * expires or SQCHAT_SSL_VERIFY_CACHE_TTL passes, whichever comes first
+     */
+    if (status == 0) {
+        verified = malloc(sizeof(struct verified_chain));
+        verified->expires = MIN(expiration_time,
+                                now + SQCHAT_SSL_VERIFY_CACHE_TTL);
+        sqchat_trie_set(verified_chains, fingerprint, verified);
     }
 
     if (status != 0) {
         bool fatal = false;
+
+        // Show the user what they're dealing with before asking them anything
+        print_certificate_info(network->buffer, cert);
+
         if (status & GNUTLS_CERT_SIGNER_NOT_FOUND ||
             status & GNUTLS_CERT_SIGNER_NOT_CA) {
             gnutls_x509_crt_t subject, issuer;
@@ -264,16 +450,24 @@ verification_error:
         }
 
         if (fatal) {
-            for (unsigned int i = 0; i < chain_size; i++)
-                gnutls_x509_crt_deinit(cert[i]);
+            gnutls_x509_crt_deinit(cert);
             sqchat_network_disconnect(network, "SSL error");
             return GNUTLS_E_CERTIFICATE_ERROR;
         }
     }
 
-    for (unsigned int i = 0; i < chain_size; i++)
-        gnutls_x509_crt_deinit(cert[i]);
+    gnutls_x509_crt_deinit(cert);
     return 0;
+
+    /* GnuTLS couldn't check the certificate at all, so we have no idea whether
+     * or not it's any good. Refuse it instead of treating it as verified.
+     */
+verification_failed:
+    sqchat_buffer_print(network->buffer,
+                        "Could not verify the server's certificate: %s\n",
+                        gnutls_strerror(ret));
+    gnutls_x509_crt_deinit(cert);
+    return GNUTLS_E_CERTIFICATE_ERROR;
 }
 
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
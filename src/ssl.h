@@ -19,9 +19,25 @@
 #define __SQ_SSL_H__
 
 #include "irc_network.h"
+#include "ui/buffer.h"
+
+// The length of the SHA-256 digests we use to identify certificate chains
+#define SQCHAT_SSL_CHAIN_DIGEST_LEN     32
+/* How long we trust a chain we've already verified before checking it again,
+ * in seconds
+ */
+#define SQCHAT_SSL_VERIFY_CACHE_TTL     (24 * 60 * 60)
 
 extern void sqchat_begin_ssl_handshake(struct sqchat_network * network)
     _attr_nonnull(1);
+extern void sqchat_ssl_handshake_complete(struct sqchat_network * network)
+    _attr_nonnull(1);
+extern void sqchat_ssl_release_credentials(struct sqchat_network * network)
+    _attr_nonnull(1);
+extern void sqchat_ssl_free_credentials();
+extern void sqchat_ssl_print_peer_certificate(struct sqchat_buffer * buffer,
+                                              struct sqchat_network * network)
+    _attr_nonnull(1, 2);
 
 #endif // __SQ_SSL_H__
 
@@ -0,0 +1,286 @@
+/* Counters for keeping track of how fast the client is doing things
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+#include "trie.h"
+#include "watchdog.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+struct handler_stats {
+    char * command;
+    unsigned long count;
+    gint64 total_time;
+    gint64 max_time;
+    struct sqchat_histogram time;
+};
+
+struct sqchat_stats sqchat_stats;
+
+// Only ever touched from the main thread
+static sqchat_trie * handler_stats;
+
+void sqchat_histogram_add(struct sqchat_histogram * histogram, gint64 value) {
+    int bucket = 0;
+
+    while (value > 1 && bucket < SQCHAT_HISTOGRAM_BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+
+    g_atomic_int_inc(&histogram->buckets[bucket]);
+}
+
+void sqchat_stats_record_handler(const char * command, gint64 time) {
+    struct handler_stats * stats;
+
+    if (handler_stats == NULL)
+        handler_stats = sqchat_trie_new(sqchat_trie_strtoupper);
+
+    if ((stats = sqchat_trie_get(handler_stats, command)) == NULL) {
+        stats = calloc(1, sizeof(struct handler_stats));
+        stats->command = strdup(command);
+        sqchat_trie_set(handler_stats, command, stats);
+    }
+
+    stats->count++;
+    stats->total_time += time;
+    if (time > stats->max_time)
+        stats->max_time = time;
+    sqchat_histogram_add(&stats->time, time);
+}
+
+void sqchat_stats_record_flush(unsigned int queue_depth, gint64 time) {
+    gint max;
+
+    sqchat_histogram_add(&sqchat_stats.flush_time, time);
+    sqchat_histogram_add(&sqchat_stats.print_queue_depth, queue_depth);
+
+    do {
+        max = g_atomic_int_get(&sqchat_stats.print_queue_max);
+    } while ((gint)queue_depth > max &&
+             !g_atomic_int_compare_and_exchange(&sqchat_stats.print_queue_max,
+                                                max, queue_depth));
+}
+
+static void format_time(GString * output, gint64 ns) {
+    if (ns < 1000)
+        g_string_append_printf(output, "%" G_GINT64_FORMAT "ns", ns);
+    else if (ns < 1000000)
+        g_string_append_printf(output, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000)
+        g_string_append_printf(output, "%.1fms", ns / 1e6);
+    else
+        g_string_append_printf(output, "%.2fs", ns / 1e9);
+}
+
+/* Finds the bucket that the given percentile falls in, and returns the largest
+ * value that bucket could hold
+ */
+static gint64 histogram_percentile(const gint * buckets,
+                                   guint64 count,
+                                   int percentile) {
+    guint64 target = (count * percentile + 99) / 100;
+    guint64 seen = 0;
+
+    for (int i = 0; i < SQCHAT_HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target)
+            return ((gint64)1 << (i + 1)) - 1;
+    }
+
+    return G_MAXINT64;
+}
+
+static void format_percentiles(GString * output,
+                               struct sqchat_histogram * histogram,
+                               bool is_time) {
+    static const int percentiles[] = { 50, 90, 99 };
+    gint buckets[SQCHAT_HISTOGRAM_BUCKETS];
+    guint64 count = 0;
+
+    for (int i = 0; i < SQCHAT_HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = g_atomic_int_get(&histogram->buckets[i]);
+        count += buckets[i];
+    }
+
+    if (count == 0)
+        return;
+
+    for (int i = 0; i < G_N_ELEMENTS(percentiles); i++) {
+        gint64 value = histogram_percentile(buckets, count, percentiles[i]);
+
+        g_string_append_printf(output, ", p%d <= ", percentiles[i]);
+        if (is_time)
+            format_time(output, value);
+        else
+            g_string_append_printf(output, "%" G_GINT64_FORMAT, value);
+    }
+}
+
+static void format_histogram(GString * output,
+                             const char * name,
+                             struct sqchat_histogram * histogram,
+                             bool is_time) {
+    guint64 count = 0;
+
+    for (int i = 0; i < SQCHAT_HISTOGRAM_BUCKETS; i++)
+        count += g_atomic_int_get(&histogram->buckets[i]);
+
+    g_string_append_printf(output, "\t%s:\t%" G_GUINT64_FORMAT " samples",
+                           name, count);
+    format_percentiles(output, histogram, is_time);
+    g_string_append_c(output, '\n');
+}
+
+static void collect_handler(struct handler_stats * stats, GPtrArray * array) {
+    g_ptr_array_add(array, stats);
+}
+
+static int compare_handlers(const void * a, const void * b) {
+    const struct handler_stats * x = *(struct handler_stats **)a;
+    const struct handler_stats * y = *(struct handler_stats **)b;
+
+    return (y->total_time > x->total_time) - (y->total_time < x->total_time);
+}
+
+// Lists how long the handler for each type of message takes, slowest first
+static void format_handlers(GString * output) {
+    GPtrArray * array = g_ptr_array_new();
+
+    if (handler_stats != NULL)
+        sqchat_trie_each(handler_stats, collect_handler, array);
+    qsort(array->pdata, array->len, sizeof(gpointer), compare_handlers);
+
+    g_string_append(output, "\tHandler time per message type:\n");
+    for (int i = 0; i < array->len; i++) {
+        struct handler_stats * stats = g_ptr_array_index(array, i);
+
+        g_string_append_printf(output, "\t\t%s:\t%lu messages, ",
+                               stats->command, stats->count);
+        format_time(output, stats->total_time);
+        g_string_append(output, " total");
+        format_percentiles(output, &stats->time, true);
+        g_string_append(output, ", max ");
+        format_time(output, stats->max_time);
+        g_string_append_c(output, '\n');
+    }
+
+    g_ptr_array_free(array, TRUE);
+}
+
+// How much memory we're actually using, in KiB
+static long resident_memory() {
+    FILE * statm = fopen("/proc/self/statm", "r");
+    long pages = 0;
+
+    if (statm == NULL)
+        return 0;
+
+    if (fscanf(statm, "%*s %ld", &pages) != 1)
+        pages = 0;
+    fclose(statm);
+
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Writes out all of the global counters in a human-readable form
+void sqchat_stats_format(GString * output) {
+    struct sqchat_trie_stats trie_stats;
+    struct sqchat_watchdog_stats watchdog_stats;
+
+    sqchat_trie_get_stats(&trie_stats);
+    sqchat_watchdog_get_stats(&watchdog_stats);
+
+    g_string_append_printf(output,
+                           "--- Client Stats ---\n"
+                           "\tBytes received:\t%" G_GSIZE_FORMAT "\n"
+                           "\tLines received:\t%" G_GSIZE_FORMAT "\n",
+                           (gsize)g_atomic_pointer_get(
+                               &sqchat_stats.bytes_received),
+                           (gsize)g_atomic_pointer_get(
+                               &sqchat_stats.lines_received));
+    format_histogram(output, "Parse time", &sqchat_stats.parse_time, true);
+    format_histogram(output, "Send time", &sqchat_stats.send_time, true);
+    format_histogram(output, "Print queue depth",
+                     &sqchat_stats.print_queue_depth, false);
+    g_string_append_printf(output, "\tLargest print queue:\t%d\n",
+                           g_atomic_int_get(&sqchat_stats.print_queue_max));
+    format_histogram(output, "Flush time", &sqchat_stats.flush_time, true);
+    format_histogram(output, "Event dispatch time",
+                     &sqchat_stats.dispatch_time, true);
+    format_histogram(output, "Main loop latency", &sqchat_stats.loop_latency,
+                     true);
+
+    g_string_append_printf(output, "\tMain loop stalls:\t%lu",
+                           watchdog_stats.stalls);
+    if (watchdog_stats.stalls != 0) {
+        g_string_append(output, ", ");
+        format_time(output, watchdog_stats.total_time);
+        g_string_append(output, " total, worst ");
+        format_time(output, watchdog_stats.max_time);
+        g_string_append_printf(output, ", last one during %s",
+                               watchdog_stats.last_context);
+    }
+    g_string_append_c(output, '\n');
+
+    g_string_append_printf(output,
+                           "\tLog bytes written:\t%" G_GSIZE_FORMAT "\n"
+                           "\tLines dropped from logs:\t%" G_GSIZE_FORMAT "\n",
+                           (gsize)g_atomic_pointer_get(
+                               &sqchat_stats.log_bytes_written),
+                           (gsize)g_atomic_pointer_get(
+                               &sqchat_stats.log_lines_dropped));
+    format_histogram(output, "Log write time", &sqchat_stats.log_write_time,
+                     true);
+
+    g_string_append_printf(output,
+                           "\tBuffers:\t%d (%d hibernating)\n"
+                           "\tMessages filtered:\t%d\n"
+                           "\tResident memory:\t%ld KiB\n",
+                           g_atomic_int_get(&sqchat_stats.buffers),
+                           g_atomic_int_get(&sqchat_stats.buffers_hibernating),
+                           g_atomic_int_get(&sqchat_stats.messages_filtered),
+                           resident_memory());
+
+    format_handlers(output);
+    g_string_append_printf(output,
+                           "\tTries:\t%lu (%lu nodes, %zu KiB)\n"
+                           "--- End of Client Stats ---\n",
+                           trie_stats.tries, trie_stats.nodes,
+                           trie_stats.memory / 1024);
+}
+
+void sqchat_connection_stats_format(
+    GString * output,
+    const struct sqchat_connection_stats * stats) {
+    g_string_append_printf(output,
+                           "\tBytes received:\t%" G_GSIZE_FORMAT "\n"
+                           "\tLines received:\t%" G_GSIZE_FORMAT "\n"
+                           "\tBytes sent:\t%" G_GSIZE_FORMAT "\n"
+                           "\tLines sent:\t%" G_GSIZE_FORMAT "\n",
+                           (gsize)g_atomic_pointer_get(&stats->bytes_received),
+                           (gsize)g_atomic_pointer_get(&stats->lines_received),
+                           (gsize)g_atomic_pointer_get(&stats->bytes_sent),
+                           (gsize)g_atomic_pointer_get(&stats->lines_sent));
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,105 @@
+/* Counters for keeping track of how fast the client is doing things
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <glib.h>
+#include <stdbool.h>
+#include <time.h>
+
+/* Histograms have a bucket for every power of two, so the last one holds
+ * anything over about a second when measuring nanoseconds
+ */
+#define SQCHAT_HISTOGRAM_BUCKETS 32
+
+struct sqchat_histogram {
+    gint buckets[SQCHAT_HISTOGRAM_BUCKETS];
+};
+
+/* Counters for a single connection. The receive counters are written by the I/O
+ * thread and read by the main thread for /stats, so just like the ones in
+ * struct sqchat_stats, these only get touched atomically.
+ */
+struct sqchat_connection_stats {
+    gsize bytes_received;
+    gsize lines_received;
+    gsize bytes_sent;
+    gsize lines_sent;
+};
+
+/* Everything else. These can be updated from any thread, so everything in here
+ * only gets touched atomically
+ */
+struct sqchat_stats {
+    gsize bytes_received;
+    gsize lines_received;
+
+    struct sqchat_histogram parse_time;
+    struct sqchat_histogram send_time;
+
+    // How many messages were waiting in a buffer each time it was flushed
+    struct sqchat_histogram print_queue_depth;
+    gint print_queue_max;
+    struct sqchat_histogram flush_time;
+
+    /* How late the main loop was in getting around to the watchdog's timer,
+     * and how long each run of a connection's event dispatcher took
+     */
+    struct sqchat_histogram loop_latency;
+    struct sqchat_histogram dispatch_time;
+
+    // How much the log writer has written, and how long each batch took
+    gsize log_bytes_written;
+    gsize log_lines_dropped;
+    struct sqchat_histogram log_write_time;
+
+    // How many buffers there are, and how many of them have no widgets
+    gint buffers;
+    gint buffers_hibernating;
+
+    // Messages that were never printed because of an ignore or a filter
+    gint messages_filtered;
+};
+
+extern struct sqchat_stats sqchat_stats;
+
+// Gets the current time for measuring with, in nanoseconds
+static inline gint64 sqchat_stats_now() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (gint64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+extern void sqchat_histogram_add(struct sqchat_histogram * histogram,
+                                 gint64 value)
+    _attr_nonnull(1);
+
+extern void sqchat_stats_record_handler(const char * command, gint64 time)
+    _attr_nonnull(1);
+extern void sqchat_stats_record_flush(unsigned int queue_depth, gint64 time);
+
+extern void sqchat_stats_format(GString * output)
+    _attr_nonnull(1);
+extern void sqchat_connection_stats_format(
+    GString * output,
+    const struct sqchat_connection_stats * stats)
+    _attr_nonnull(1, 2);
+
+#endif // __STATS_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,256 @@
+/* Parses the mIRC formatting codes (bold, colors, etc.) out of text
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "text_style.h"
+
+#include <glib.h>
+#include <string.h>
+
+const char * const sqchat_text_colors[SQCHAT_TEXT_COLORS] = {
+    "#FFFFFF", // White
+    "#000000", // Black
+    "#00007F", // Blue
+    "#009300", // Green
+    "#FF0000", // Red
+    "#7F0000", // Brown
+    "#9C009C", // Purple
+    "#FC7F00", // Orange
+    "#FFFF00", // Yellow
+    "#00FC00", // Light green
+    "#009393", // Cyan
+    "#00FFFF", // Light cyan
+    "#0000FC", // Light blue
+    "#FF00FF", // Pink
+    "#7F7F7F", // Grey
+    "#D2D2D2"  // Light grey
+};
+
+bool sqchat_text_style_is_default(const struct sqchat_text_style * style) {
+    return style->fg == SQCHAT_DEFAULT_COLOR &&
+           style->bg == SQCHAT_DEFAULT_COLOR &&
+           !style->bold && !style->italic && !style->underline &&
+           !style->strikethrough;
+}
+
+static bool same_style(const struct sqchat_text_style * a,
+                       const struct sqchat_text_style * b) {
+    return a->fg == b->fg && a->bg == b->bg && a->bold == b->bold &&
+           a->italic == b->italic && a->underline == b->underline &&
+           a->strikethrough == b->strikethrough;
+}
+
+/* Reads a color number of up to two digits. Returns false if there wasn't
+ * one.
+ */
+static bool parse_color(const char ** pos, const char * end, int * color) {
+    const char * start = *pos;
+
+    *color = 0;
+    while (*pos < end && *pos - start < 2 && g_ascii_isdigit(**pos)) {
+        *color = *color * 10 + (**pos - '0');
+        (*pos)++;
+    }
+
+    if (*pos == start)
+        return false;
+
+    // 99 means the default color, and we don't do the extended colors
+    if (*color >= SQCHAT_TEXT_COLORS)
+        *color = SQCHAT_DEFAULT_COLOR;
+    return true;
+}
+
+static void skip_hex_color(const char ** pos, const char * end) {
+    for (int i = 0; i < 6 && *pos < end && g_ascii_isxdigit(**pos); i++)
+        (*pos)++;
+}
+
+// Applies the code at pos to the style, and returns where the text after it is
+static const char * apply_code(const char * pos,
+                               const char * end,
+                               struct sqchat_text_style * style,
+                               bool * reverse) {
+    int color;
+
+    switch (*pos++) {
+        case SQCHAT_BOLD_CODE:
+            style->bold = !style->bold;
+            break;
+        case SQCHAT_ITALIC_CODE:
+            style->italic = !style->italic;
+            break;
+        case SQCHAT_UNDERLINE_CODE:
+            style->underline = !style->underline;
+            break;
+        case SQCHAT_STRIKETHROUGH_CODE:
+            style->strikethrough = !style->strikethrough;
+            break;
+        case SQCHAT_REVERSE_CODE:
+            *reverse = !*reverse;
+            break;
+        case SQCHAT_RESET_CODE:
+            *style = SQCHAT_TEXT_STYLE_DEFAULT;
+            *reverse = false;
+            break;
+        case SQCHAT_COLOR_CODE:
+            // A color code on it's own resets the colors
+            if (!parse_color(&pos, end, &color)) {
+                style->fg = SQCHAT_DEFAULT_COLOR;
+                style->bg = SQCHAT_DEFAULT_COLOR;
+                break;
+            }
+            style->fg = color;
+
+            // The comma only counts if there's a background color after it
+            if (pos + 1 < end && *pos == ',' && g_ascii_isdigit(pos[1])) {
+                pos++;
+                parse_color(&pos, end, &color);
+                style->bg = color;
+            }
+            break;
+        case SQCHAT_HEX_COLOR_CODE:
+            // We don't do hex colors, so just leave them out
+            skip_hex_color(&pos, end);
+            if (pos + 1 < end && *pos == ',' && g_ascii_isxdigit(pos[1])) {
+                pos++;
+                skip_hex_color(&pos, end);
+            }
+            break;
+        // Monospace text is all we ever show anyway
+        case SQCHAT_MONOSPACE_CODE:
+            break;
+    }
+
+    return pos;
+}
+
+static bool is_code(char c) {
+    switch (c) {
+        case SQCHAT_BOLD_CODE:
+        case SQCHAT_COLOR_CODE:
+        case SQCHAT_HEX_COLOR_CODE:
+        case SQCHAT_RESET_CODE:
+        case SQCHAT_MONOSPACE_CODE:
+        case SQCHAT_REVERSE_CODE:
+        case SQCHAT_ITALIC_CODE:
+        case SQCHAT_STRIKETHROUGH_CODE:
+        case SQCHAT_UNDERLINE_CODE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void emit_span(const char * start,
+                      const char * end,
+                      const struct sqchat_text_style * style,
+                      bool reverse,
+                      sqchat_text_span_cb span_cb,
+                      void * data) {
+    struct sqchat_text_style shown = *style;
+
+    if (start == end)
+        return;
+
+    /* Reversing text with the default colors needs some real colors to swap,
+     * so use black on white like mIRC does
+     */
+    if (reverse) {
+        shown.fg = style->bg != SQCHAT_DEFAULT_COLOR ? style->bg : 0;
+        shown.bg = style->fg != SQCHAT_DEFAULT_COLOR ? style->fg : 1;
+    }
+
+    span_cb(start, end - start, &shown, data);
+}
+
+/* Splits the text up into runs that all have the same style, leaving out the
+ * formatting codes. Just like every other client, formatting only lasts until
+ * the end of the line it's on.
+ */
+void sqchat_text_style_parse(const char * text,
+                             size_t len,
+                             sqchat_text_span_cb span_cb,
+                             void * data) {
+    struct sqchat_text_style style = SQCHAT_TEXT_STYLE_DEFAULT;
+    bool reverse = false;
+    const char * end = text + len;
+    const char * span_start = text;
+    const char * pos = text;
+
+    while (pos < end) {
+        if (*pos == '\n') {
+            // The newline itself never gets styled
+            if (!sqchat_text_style_is_default(&style) || reverse) {
+                emit_span(span_start, pos, &style, reverse, span_cb, data);
+                span_start = pos;
+                style = SQCHAT_TEXT_STYLE_DEFAULT;
+                reverse = false;
+            }
+            pos++;
+        }
+        else if (is_code(*pos)) {
+            emit_span(span_start, pos, &style, reverse, span_cb, data);
+            pos = apply_code(pos, end, &style, &reverse);
+            span_start = pos;
+        }
+        else
+            pos++;
+    }
+
+    emit_span(span_start, end, &style, reverse, span_cb, data);
+}
+
+/* Appends the codes needed to change from one style to another. Colors are
+ * always written out with two digits, so they can't run into any numbers in
+ * the text that comes after them.
+ */
+void sqchat_text_style_append_codes(GString * output,
+                                    const struct sqchat_text_style * from,
+                                    const struct sqchat_text_style * to) {
+    struct sqchat_text_style current = *from;
+
+    if (same_style(from, to))
+        return;
+
+    /* There's no way to turn the colors back to their defaults without
+     * resetting everything else too
+     */
+    if ((from->fg != SQCHAT_DEFAULT_COLOR && to->fg == SQCHAT_DEFAULT_COLOR) ||
+        (from->bg != SQCHAT_DEFAULT_COLOR && to->bg == SQCHAT_DEFAULT_COLOR)) {
+        g_string_append_c(output, SQCHAT_RESET_CODE);
+        current = SQCHAT_TEXT_STYLE_DEFAULT;
+    }
+
+    if (current.bold != to->bold)
+        g_string_append_c(output, SQCHAT_BOLD_CODE);
+    if (current.italic != to->italic)
+        g_string_append_c(output, SQCHAT_ITALIC_CODE);
+    if (current.underline != to->underline)
+        g_string_append_c(output, SQCHAT_UNDERLINE_CODE);
+    if (current.strikethrough != to->strikethrough)
+        g_string_append_c(output, SQCHAT_STRIKETHROUGH_CODE);
+
+    if (current.fg != to->fg || current.bg != to->bg) {
+        g_string_append_printf(output, "%c%02d", SQCHAT_COLOR_CODE,
+                               to->fg != SQCHAT_DEFAULT_COLOR ? to->fg : 99);
+        if (to->bg != SQCHAT_DEFAULT_COLOR)
+            g_string_append_printf(output, ",%02d", to->bg);
+    }
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,81 @@
+/* Parses the mIRC formatting codes (bold, colors, etc.) out of text
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEXT_STYLE_H__
+#define __TEXT_STYLE_H__
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SQCHAT_BOLD_CODE            '\x02'
+#define SQCHAT_COLOR_CODE           '\x03'
+#define SQCHAT_HEX_COLOR_CODE       '\x04'
+#define SQCHAT_RESET_CODE           '\x0f'
+#define SQCHAT_MONOSPACE_CODE       '\x11'
+#define SQCHAT_REVERSE_CODE         '\x16'
+#define SQCHAT_ITALIC_CODE          '\x1d'
+#define SQCHAT_STRIKETHROUGH_CODE   '\x1e'
+#define SQCHAT_UNDERLINE_CODE       '\x1f'
+
+// Only the standard 16 mIRC colors get used, anything else is the default
+#define SQCHAT_TEXT_COLORS 16
+#define SQCHAT_DEFAULT_COLOR -1
+
+extern const char * const sqchat_text_colors[SQCHAT_TEXT_COLORS];
+
+/* Reversed text doesn't have a flag of it's own, it's colors just get swapped
+ * when it's parsed
+ */
+struct sqchat_text_style {
+    gint8 fg;
+    gint8 bg;
+
+    bool bold           : 1;
+    bool italic         : 1;
+    bool underline      : 1;
+    bool strikethrough  : 1;
+};
+
+#define SQCHAT_TEXT_STYLE_DEFAULT \
+    ((struct sqchat_text_style) { SQCHAT_DEFAULT_COLOR, SQCHAT_DEFAULT_COLOR })
+
+/* Gets called for each run of text that has the same style, with the
+ * formatting codes left out
+ */
+typedef void (*sqchat_text_span_cb)(const char * text,
+                                    size_t len,
+                                    const struct sqchat_text_style * style,
+                                    void * data);
+
+extern bool sqchat_text_style_is_default(
+    const struct sqchat_text_style * style)
+    _attr_nonnull(1);
+
+extern void sqchat_text_style_parse(const char * text,
+                                    size_t len,
+                                    sqchat_text_span_cb span_cb,
+                                    void * data)
+    _attr_nonnull(1, 3);
+extern void sqchat_text_style_append_codes(
+    GString * output,
+    const struct sqchat_text_style * from,
+    const struct sqchat_text_style * to)
+    _attr_nonnull(1, 2, 3);
+
+#endif // __TEXT_STYLE_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,113 @@
+/* Optional tracing for finding out where the main thread spends it's time
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+bool sqchat_trace_active;
+gint64 sqchat_trace_slow_threshold =
+    (gint64)SQCHAT_TRACE_SLOW_THRESHOLD * 1000000;
+
+static FILE * trace_file;
+static bool first_event;
+
+/* Starts writing a new trace to the file at path, replacing whatever trace was
+ * going before
+ */
+bool sqchat_trace_start(const char * path, GError ** error) {
+    FILE * file = g_fopen(path, "w");
+
+    if (file == NULL) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "%s", g_strerror(errno));
+        return false;
+    }
+
+    sqchat_trace_stop();
+
+    trace_file = file;
+    first_event = true;
+    sqchat_trace_active = true;
+
+    fprintf(trace_file, "{\"traceEvents\": [");
+    return true;
+}
+
+void sqchat_trace_stop() {
+    if (!sqchat_trace_active)
+        return;
+
+    fprintf(trace_file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+    fclose(trace_file);
+
+    trace_file = NULL;
+    sqchat_trace_active = false;
+}
+
+static void write_json_string(const char * str) {
+    fputc('"', trace_file);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fprintf(trace_file, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(trace_file, "\\u%04x", *str);
+        else
+            fputc(*str, trace_file);
+    }
+    fputc('"', trace_file);
+}
+
+/* Adds a complete event to the trace. start and duration are in nanoseconds,
+ * taken from sqchat_stats_now(). detail is shown with the event in the trace
+ * viewer, and can be NULL. Returns true if the event took longer than the slow
+ * threshold.
+ */
+bool sqchat_trace_event(const char * name,
+                        const char * category,
+                        gint64 start,
+                        gint64 duration,
+                        const char * detail) {
+    bool slow = duration > sqchat_trace_slow_threshold;
+
+    if (!sqchat_trace_active)
+        return false;
+
+    fprintf(trace_file, "%s\n{\"name\": ", first_event ? "" : ",");
+    write_json_string(name);
+    fprintf(trace_file, ", \"cat\": ");
+    write_json_string(category);
+    fprintf(trace_file,
+            ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, "
+            "\"tid\": 1, \"args\": {\"slow\": %s",
+            start / 1e3, duration / 1e3, getpid(), slow ? "true" : "false");
+    if (detail) {
+        fprintf(trace_file, ", \"detail\": ");
+        write_json_string(detail);
+    }
+    fprintf(trace_file, "}}");
+
+    first_event = false;
+    return slow;
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
@@ -0,0 +1,54 @@
+/* Optional tracing for finding out where the main thread spends it's time. The
+ * trace is written in Chrome's trace event format, so it can be opened in
+ * chrome://tracing or any other viewer that understands it.
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+/* While tracing, anything that takes longer than this (in milliseconds) gets
+ * pointed out to the user as well
+ */
+#define SQCHAT_TRACE_SLOW_THRESHOLD 50
+
+/* Only the main thread should be tracing things, so none of this is locked.
+ * Check sqchat_trace_enabled() before going through the trouble of timing
+ * anything.
+ */
+extern bool sqchat_trace_active;
+extern gint64 sqchat_trace_slow_threshold;
+
+static inline bool sqchat_trace_enabled() {
+    return sqchat_trace_active;
+}
+
+extern bool sqchat_trace_start(const char * path, GError ** error)
+    _attr_nonnull(1);
+extern void sqchat_trace_stop();
+
+extern bool sqchat_trace_event(const char * name,
+                               const char * category,
+                               gint64 start,
+                               gint64 duration,
+                               const char * detail)
+    _attr_nonnull(1, 2);
+
+#endif // __TRACE_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
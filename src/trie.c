@@ -36,9 +36,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <glib.h>
 #include "trie.h"
 #include "casemap.h"
 
+/* How many tries and nodes are around. These get touched from more than one
+ * thread, so they're only ever updated atomically
+ */
+static gint trie_count;
+static gint node_count;
+
 static void __null_canonize(char * s) { }
 
 static sqchat_trie_e *sqchat_trie_e_new(sqchat_trie_e * up)
@@ -47,6 +54,7 @@ static sqchat_trie_e *sqchat_trie_e_new(sqchat_trie_e * up)
     int i;
 
     e = malloc(sizeof(*e));
+    g_atomic_int_inc(&node_count);
     e->val = NULL;
     e->up = up;
     for (i=0; i<16; i++)
@@ -57,6 +65,7 @@ static sqchat_trie_e *sqchat_trie_e_new(sqchat_trie_e * up)
 
 static void sqchat_trie_e_del(sqchat_trie_e *e)
 {
+    g_atomic_int_add(&node_count, -1);
     free(e);
 }
 
@@ -66,6 +75,7 @@ sqchat_trie *sqchat_trie_new(void (*canonize)())
     int i;
 
     sqchat_trie = malloc(sizeof(*sqchat_trie));
+    g_atomic_int_inc(&trie_count);
     sqchat_trie->canonize = canonize ? canonize : __null_canonize;
 
     sqchat_trie->n.val = NULL;
@@ -93,9 +103,18 @@ static void free_real(sqchat_trie_e * e, void (*cb)(), void * priv)
 void sqchat_trie_free(sqchat_trie * sqchat_trie, void (*cb)(), void * priv)
 {
     free_real(&sqchat_trie->n, cb, priv);
+    g_atomic_int_add(&trie_count, -1);
     free(sqchat_trie);
 }
 
+void sqchat_trie_get_stats(struct sqchat_trie_stats * stats)
+{
+    stats->tries = g_atomic_int_get(&trie_count);
+    stats->nodes = g_atomic_int_get(&node_count);
+    stats->memory = stats->tries * sizeof(sqchat_trie) +
+                    stats->nodes * sizeof(sqchat_trie_e);
+}
+
 static char nibble(char * s, int i)
 {
     return (i%2==0) ? s[i/2]>>4 : s[i/2]&0xf;
@@ -36,6 +36,8 @@
 #ifndef __INC_TRIE_H__
 #define __INC_TRIE_H__
 
+#include <stddef.h>
+
 /* This is used for some internal buffers in the sqchat_trie functions. Since these
  * bytes are allocated on the stack, you can set this pretty high. Think of
  * the longest key you might need to insert, then multiply by 4x
@@ -56,6 +58,15 @@ struct sqchat_trie {
 	sqchat_trie_e n;
 };
 
+/* How many tries and nodes exist across the whole program, and roughly how much
+ * memory they take up
+ */
+struct sqchat_trie_stats {
+    unsigned long tries;
+    unsigned long nodes;
+    size_t memory;
+};
+
 extern sqchat_trie *sqchat_trie_new(void (*canonize)());
 extern void sqchat_trie_free(sqchat_trie * sqchat_trie, void (*cb)(), void * priv)
     _attr_nonnull(1);
@@ -68,6 +79,9 @@ extern void sqchat_trie_each(sqchat_trie * sqchat_trie, void(*cb)(), void * priv
     _attr_nonnull(1, 2);
 extern void *sqchat_trie_del(sqchat_trie * sqchat_trie, const char * key);
 
+extern void sqchat_trie_get_stats(struct sqchat_trie_stats * stats)
+    _attr_nonnull(1);
+
 extern void sqchat_trie_strtolower(char * s)
     _attr_nonnull(1);
 extern void sqchat_trie_strtoupper(char * s)
@@ -19,15 +19,53 @@
 #include "chat_window.h"
 #include "../commands.h"
 #include "user_list.h"
+#include "network_tree.h"
 #include "buffer_view.h"
 #include "command_box.h"
+#include "../stats.h"
+#include "../watchdog.h"
+#include "../settings.h"
+#include "../text_style.h"
+#include "../netsplit.h"
 
 #include <gtk/gtk.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 
-static gboolean flush_buffer_output(struct sqchat_buffer * buffer);
+/* Buffers with output waiting to be flushed. Instead of every buffer flushing
+ * on it's own, they all get flushed together once per frame.
+ */
+static GMutex dirty_mutex;
+static GSList * dirty_buffers;
+static bool flush_scheduled;
+
+// Only touched from the main thread
+static GtkWidget * tick_widget;
+static guint tick_id;
+static guint fallback_id;
+
+/* Every buffer shares the same tag table, and the tags for the mIRC formatting
+ * codes only get created the first time some text needs them
+ */
+static GtkTextTagTable * tag_table;
+static GtkTextTag * fg_tags[SQCHAT_TEXT_COLORS];
+static GtkTextTag * bg_tags[SQCHAT_TEXT_COLORS];
+static GtkTextTag * bold_tag;
+static GtkTextTag * italic_tag;
+static GtkTextTag * underline_tag;
+static GtkTextTag * strikethrough_tag;
+
+struct styled_insert {
+    GtkTextBuffer * text_buffer;
+    GtkTextIter * iter;
+};
+
+static void flush_buffer_output(struct sqchat_buffer * buffer);
+static void create_widgets(struct sqchat_buffer * buffer);
+static void destroy_widgets(struct sqchat_buffer * buffer);
+static void backlog_scroll_cb(GtkAdjustment * adjustment,
+                              struct sqchat_buffer * buffer);
 
 struct sqchat_buffer * sqchat_buffer_new(const char * buffer_name,
                                          enum sqchat_buffer_type type,
@@ -37,35 +75,49 @@ struct sqchat_buffer * sqchat_buffer_new(const char * buffer_name,
     buffer->buffer_name = (type != NETWORK) ? strdup(buffer_name) : NULL;
 
     buffer->row = NULL;
+    buffer->activity = SQCHAT_ACTIVITY_NONE;
+    buffer->unread = 0;
+    buffer->highlights = 0;
+    buffer->tree_dirty = false;
     buffer->network = network;
     buffer->window = network->window;
-    
-    buffer->buffer = gtk_text_buffer_new(NULL);
-    buffer->command_box_buffer = gtk_entry_buffer_new(NULL, -1);
-    
-    buffer->buffer_view = sqchat_buffer_view_new(buffer->buffer);
-    buffer->command_box_entry =
-        sqchat_command_box_new(buffer->command_box_buffer, buffer);
 
-    buffer->scrolled_container = gtk_scrolled_window_new(NULL, NULL);
-    gtk_container_add(GTK_CONTAINER(buffer->scrolled_container),
-                      buffer->buffer_view);
+    buffer->hibernated_text = NULL;
+    buffer->hibernated_input = NULL;
+    buffer->hibernate_timer = 0;
 
-    g_object_ref(buffer->command_box_entry);
-    g_object_ref(buffer->scrolled_container);
-    /* The textview for the buffer is already referenced by the scrolled
-     * container, so we don't need to reference that
+    /* Nothing needs a buffer's widgets until it's shown, so unless hibernation
+     * is turned off buffers start out hibernating
      */
+    if (sqchat_buffer_hibernate_after > 0) {
+        buffer->hibernating = true;
+        buffer->hibernated_text = g_string_new(NULL);
+        g_atomic_int_inc(&sqchat_stats.buffers_hibernating);
+    }
+    else {
+        buffer->hibernating = false;
+        create_widgets(buffer);
+    }
+    g_atomic_int_inc(&sqchat_stats.buffers);
 
-    buffer->out_queue_size = 0;
-    buffer->out_queue = NULL;
+    buffer->out_queue = g_string_new(NULL);
+    buffer->out_queue_len = 0;
     g_mutex_init(&buffer->output_mutex);
 
+    buffer->log = sqchat_log_open(sqchat_network_log_name(network),
+                                  buffer->buffer_name);
+    buffer->search = NULL;
+
+    buffer->created = g_get_real_time();
+    buffer->backlog_started = false;
+    buffer->backlog = NULL;
+
     // Add a userlist if the buffer is a channel buffer
     if (type == CHANNEL) {
         buffer->chan_data = malloc(sizeof(struct __sqchat_channel_data));
         buffer->chan_data->user_list_store =
-            gtk_list_store_new(3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER);
+            gtk_list_store_new(4, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER,
+                               G_TYPE_STRING);
         buffer->chan_data->users = sqchat_trie_new(sqchat_trie_strtolower);
     }
     else if (type == QUERY) {
@@ -81,6 +133,268 @@ struct sqchat_buffer * sqchat_buffer_new(const char * buffer_name,
     return buffer;
 }
 
+// Gets one of the shared tags, creating it with the given properties if needed
+static GtkTextTag * get_tag(GtkTextTag ** tag, const char * property, ...) {
+    va_list args;
+
+    if (*tag != NULL)
+        return *tag;
+
+    *tag = gtk_text_tag_new(NULL);
+    va_start(args, property);
+    g_object_set_valist(G_OBJECT(*tag), property, args);
+    va_end(args);
+    gtk_text_tag_table_add(tag_table, *tag);
+
+    return *tag;
+}
+
+static void insert_span(const char * text,
+                        size_t len,
+                        const struct sqchat_text_style * style,
+                        struct styled_insert * insert) {
+    GtkTextBuffer * text_buffer = insert->text_buffer;
+    GtkTextIter start;
+    gint offset;
+
+    if (sqchat_text_style_is_default(style)) {
+        gtk_text_buffer_insert(text_buffer, insert->iter, text, len);
+        return;
+    }
+
+    offset = gtk_text_iter_get_offset(insert->iter);
+    gtk_text_buffer_insert(text_buffer, insert->iter, text, len);
+    gtk_text_buffer_get_iter_at_offset(text_buffer, &start, offset);
+
+    if (style->fg != SQCHAT_DEFAULT_COLOR)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&fg_tags[style->fg], "foreground",
+                                          sqchat_text_colors[style->fg], NULL),
+                                  &start, insert->iter);
+    if (style->bg != SQCHAT_DEFAULT_COLOR)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&bg_tags[style->bg], "background",
+                                          sqchat_text_colors[style->bg], NULL),
+                                  &start, insert->iter);
+    if (style->bold)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&bold_tag, "weight",
+                                          PANGO_WEIGHT_BOLD, NULL),
+                                  &start, insert->iter);
+    if (style->italic)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&italic_tag, "style",
+                                          PANGO_STYLE_ITALIC, NULL),
+                                  &start, insert->iter);
+    if (style->underline)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&underline_tag, "underline",
+                                          PANGO_UNDERLINE_SINGLE, NULL),
+                                  &start, insert->iter);
+    if (style->strikethrough)
+        gtk_text_buffer_apply_tag(text_buffer,
+                                  get_tag(&strikethrough_tag, "strikethrough",
+                                          TRUE, NULL),
+                                  &start, insert->iter);
+}
+
+/* Inserts text at iter with any formatting codes in it turned into tags. iter
+ * ends up at the end of the new text.
+ */
+static void insert_styled(GtkTextBuffer * text_buffer,
+                          GtkTextIter * iter,
+                          const char * text,
+                          size_t len) {
+    struct styled_insert insert = {
+        .text_buffer = text_buffer,
+        .iter = iter
+    };
+
+    sqchat_text_style_parse(text, len, (sqchat_text_span_cb)insert_span,
+                            &insert);
+}
+
+static void get_style_at(const GtkTextIter * iter,
+                         struct sqchat_text_style * style) {
+    *style = SQCHAT_TEXT_STYLE_DEFAULT;
+
+    for (int i = 0; i < SQCHAT_TEXT_COLORS; i++) {
+        if (fg_tags[i] && gtk_text_iter_has_tag(iter, fg_tags[i]))
+            style->fg = i;
+        if (bg_tags[i] && gtk_text_iter_has_tag(iter, bg_tags[i]))
+            style->bg = i;
+    }
+
+    style->bold = bold_tag && gtk_text_iter_has_tag(iter, bold_tag);
+    style->italic = italic_tag && gtk_text_iter_has_tag(iter, italic_tag);
+    style->underline =
+        underline_tag && gtk_text_iter_has_tag(iter, underline_tag);
+    style->strikethrough =
+        strikethrough_tag && gtk_text_iter_has_tag(iter, strikethrough_tag);
+}
+
+/* Turns the contents of a text buffer back into text with formatting codes,
+ * so it can be put back with insert_styled() later
+ */
+static void save_styled_text(GtkTextBuffer * text_buffer, GString * output) {
+    struct sqchat_text_style current = SQCHAT_TEXT_STYLE_DEFAULT;
+    struct sqchat_text_style style;
+    GtkTextIter pos;
+    GtkTextIter next;
+    char * text;
+
+    gtk_text_buffer_get_start_iter(text_buffer, &pos);
+    while (!gtk_text_iter_is_end(&pos)) {
+        next = pos;
+        gtk_text_iter_forward_to_tag_toggle(&next, NULL);
+
+        get_style_at(&pos, &style);
+        sqchat_text_style_append_codes(output, &current, &style);
+        current = style;
+
+        text = gtk_text_buffer_get_text(text_buffer, &pos, &next, FALSE);
+        g_string_append(output, text);
+        g_free(text);
+
+        pos = next;
+    }
+}
+
+static void create_widgets(struct sqchat_buffer * buffer) {
+    if (tag_table == NULL)
+        tag_table = gtk_text_tag_table_new();
+
+    buffer->buffer = gtk_text_buffer_new(tag_table);
+    buffer->command_box_buffer =
+        gtk_entry_buffer_new(buffer->hibernated_input, -1);
+
+    buffer->buffer_view = sqchat_buffer_view_new(buffer->buffer);
+    buffer->command_box_entry =
+        sqchat_command_box_new(buffer->command_box_buffer, buffer);
+
+    buffer->scrolled_container = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(buffer->scrolled_container),
+                      buffer->buffer_view);
+
+    g_signal_connect(gtk_scrolled_window_get_vadjustment(
+                         GTK_SCROLLED_WINDOW(buffer->scrolled_container)),
+                     "value-changed", G_CALLBACK(backlog_scroll_cb), buffer);
+
+    g_object_ref_sink(buffer->command_box_entry);
+    g_object_ref_sink(buffer->scrolled_container);
+    /* The textview for the buffer is already referenced by the scrolled
+     * container, so we don't need to reference that
+     */
+}
+
+static void destroy_widgets(struct sqchat_buffer * buffer) {
+    g_signal_handlers_disconnect_by_data(
+        gtk_scrolled_window_get_vadjustment(
+            GTK_SCROLLED_WINDOW(buffer->scrolled_container)),
+        buffer);
+
+    g_object_unref(buffer->scrolled_container);
+    g_object_unref(buffer->command_box_entry);
+    g_object_unref(buffer->buffer);
+    g_object_unref(buffer->command_box_buffer);
+
+    buffer->scrolled_container = NULL;
+    buffer->buffer_view = NULL;
+    buffer->buffer = NULL;
+    buffer->command_box_entry = NULL;
+    buffer->command_box_buffer = NULL;
+}
+
+/* Gets rid of the buffer's widgets, keeping only the text that was in them. If
+ * the backlog was in the middle of being loaded, it just picks up where it
+ * left off once the buffer's woken back up.
+ */
+static gboolean hibernate(struct sqchat_buffer * buffer) {
+    buffer->hibernate_timer = 0;
+    sqchat_watchdog_enter("Hibernating a buffer", buffer->buffer_name);
+
+    buffer->hibernated_text = g_string_new(NULL);
+    save_styled_text(buffer->buffer, buffer->hibernated_text);
+
+    if (gtk_entry_buffer_get_length(buffer->command_box_buffer) != 0)
+        buffer->hibernated_input =
+            strdup(gtk_entry_buffer_get_text(buffer->command_box_buffer));
+
+    destroy_widgets(buffer);
+    buffer->hibernating = true;
+    g_atomic_int_inc(&sqchat_stats.buffers_hibernating);
+
+    sqchat_watchdog_leave();
+    return false;
+}
+
+/* Hibernates the buffer once it's gone unseen for long enough. Called when a
+ * buffer stops being shown.
+ */
+void sqchat_buffer_hibernate_later(struct sqchat_buffer * buffer) {
+    if (buffer->hibernating || buffer->hibernate_timer != 0 ||
+        sqchat_buffer_hibernate_after <= 0)
+        return;
+
+    buffer->hibernate_timer =
+        g_timeout_add_seconds(sqchat_buffer_hibernate_after * 60,
+                              (GSourceFunc)hibernate, buffer);
+}
+
+static bool scrolled_to_bottom(struct sqchat_buffer * buffer) {
+    GtkAdjustment * scroll_adjustment =
+        gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(buffer->buffer_view));
+
+    return gtk_adjustment_get_value(scroll_adjustment) >=
+           gtk_adjustment_get_upper(scroll_adjustment) -
+           gtk_adjustment_get_page_size(scroll_adjustment) - 1e-12;
+}
+
+/* Makes sure the buffer has it's widgets, rebuilding them if it's been
+ * hibernating. Called right before a buffer gets shown.
+ */
+void sqchat_buffer_wake(struct sqchat_buffer * buffer) {
+    GtkTextIter end;
+
+    if (buffer->hibernate_timer != 0) {
+        g_source_remove(buffer->hibernate_timer);
+        buffer->hibernate_timer = 0;
+    }
+
+    if (!buffer->hibernating) {
+        /* Output only gets scrolled to in the buffer that's being shown, so
+         * catch up if the buffer was scrolled all the way down when it was
+         * hidden
+         */
+        if (scrolled_to_bottom(buffer))
+            gtk_text_view_scroll_to_mark(
+                GTK_TEXT_VIEW(buffer->buffer_view),
+                gtk_text_buffer_get_insert(buffer->buffer),
+                0.0, true, 0.0, 1.0);
+        return;
+    }
+
+    sqchat_watchdog_enter("Waking up a buffer", buffer->buffer_name);
+
+    create_widgets(buffer);
+    gtk_text_buffer_get_end_iter(buffer->buffer, &end);
+    insert_styled(buffer->buffer, &end, buffer->hibernated_text->str,
+                  buffer->hibernated_text->len);
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(buffer->buffer_view),
+                                 gtk_text_buffer_get_insert(buffer->buffer),
+                                 0.0, true, 0.0, 1.0);
+
+    g_string_free(buffer->hibernated_text, TRUE);
+    free(buffer->hibernated_input);
+    buffer->hibernated_text = NULL;
+    buffer->hibernated_input = NULL;
+
+    buffer->hibernating = false;
+    g_atomic_int_add(&sqchat_stats.buffers_hibernating, -1);
+
+    sqchat_watchdog_leave();
+}
+
 static void destroy_users(GtkTreeRowReference * user,
                           struct sqchat_buffer * buffer) {
     if (buffer->network->multi_prefix) {
@@ -101,113 +415,327 @@ void sqchat_buffer_destroy(struct sqchat_buffer * buffer) {
 
 void sqchat_buffer_free(struct sqchat_buffer * buffer) {
     if (buffer->type == CHANNEL) {
+        sqchat_netsplit_forget_buffer(buffer);
         g_object_unref(buffer->chan_data->user_list_store);
         sqchat_trie_free(buffer->chan_data->users, destroy_users, buffer);
     }
-    g_object_unref(buffer->scrolled_container);
-    g_object_unref(buffer->command_box_entry);
+
+    if (buffer->hibernate_timer != 0)
+        g_source_remove(buffer->hibernate_timer);
+
+    if (buffer->hibernating) {
+        g_string_free(buffer->hibernated_text, TRUE);
+        free(buffer->hibernated_input);
+        g_atomic_int_add(&sqchat_stats.buffers_hibernating, -1);
+    }
+    else
+        destroy_widgets(buffer);
+    g_atomic_int_add(&sqchat_stats.buffers, -1);
+
+    sqchat_network_tree_buffer_forget(buffer);
 
     free(buffer->buffer_name);
     gtk_tree_row_reference_free(buffer->row);
     free(buffer->extra_data);
 
+    // Make sure a search doesn't try to print to us after we're gone
+    if (buffer->search)
+        sqchat_log_search_cancel(buffer->search);
+
     g_mutex_clear(&buffer->output_mutex);
 
-    /* If there was still data waiting to be outputted, destroy it and remove
-     * idle function from the event loop
+    if (buffer->log)
+        sqchat_log_close(buffer->log);
+
+    if (buffer->backlog)
+        sqchat_log_backlog_free(buffer->backlog);
+
+    /* If there was still data waiting to be outputted, destroy it and make
+     * sure the buffer doesn't get flushed
      */
-    if (g_idle_remove_by_data(buffer)) {
-        struct __sqchat_queued_output * n;
-        for (struct __sqchat_queued_output * c = buffer->out_queue;
-             c != NULL;
-             c = n) {
-            free(c->msg);
-            n = c->next;
-            free(c);
-        }
-    }
+    g_mutex_lock(&dirty_mutex);
+    dirty_buffers = g_slist_remove(dirty_buffers, buffer);
+    g_mutex_unlock(&dirty_mutex);
+
+    g_string_free(buffer->out_queue, TRUE);
 
     free(buffer);
 }
 
+/* Loads the next chunk of the buffer's history from the logs, and adds it to
+ * the top of the buffer
+ */
+void sqchat_buffer_load_backlog(struct sqchat_buffer * buffer) {
+    bool first = !buffer->backlog_started;
+    GString * text;
+    GtkTextIter start;
+    GtkTextMark * mark;
+
+    if (first) {
+        const char * network_name = sqchat_network_log_name(buffer->network);
+        char * path;
+
+        buffer->backlog_started = true;
+        if (buffer->log == NULL)
+            return;
+
+        path = sqchat_log_path(network_name ? network_name : "unknown",
+                               buffer->buffer_name ? buffer->buffer_name :
+                               SQCHAT_LOG_SERVER_NAME);
+        if (path == NULL)
+            return;
+
+        buffer->backlog = sqchat_log_backlog_new(path, buffer->created);
+        g_free(path);
+    }
+    else if (buffer->backlog == NULL)
+        return;
+
+    sqchat_watchdog_enter("Loading backlog", buffer->buffer_name);
+
+    text = g_string_new(NULL);
+    if (sqchat_log_backlog_read(buffer->backlog, SQCHAT_BACKLOG_CHUNK, text) <
+        SQCHAT_BACKLOG_CHUNK) {
+        sqchat_log_backlog_free(buffer->backlog);
+        buffer->backlog = NULL;
+    }
+
+    if (text->len != 0) {
+        if (first)
+            g_string_append(text, "--- End of backlog ---\n");
+
+        /* The mark stays in front of what's already in the buffer, so we can
+         * keep whatever the user was looking at where it was
+         */
+        gtk_text_buffer_get_start_iter(buffer->buffer, &start);
+        mark = gtk_text_buffer_get_mark(buffer->buffer, "backlog");
+        if (mark == NULL)
+            mark = gtk_text_buffer_create_mark(buffer->buffer, "backlog",
+                                               &start, FALSE);
+        else
+            gtk_text_buffer_move_mark(buffer->buffer, mark, &start);
+
+        insert_styled(buffer->buffer, &start, text->str, text->len);
+
+        // The first time around, stay at the bottom of the buffer instead
+        if (first)
+            gtk_text_view_scroll_to_mark(
+                GTK_TEXT_VIEW(buffer->buffer_view),
+                gtk_text_buffer_get_insert(buffer->buffer),
+                0.0, true, 0.0, 1.0);
+        else
+            gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(buffer->buffer_view),
+                                         mark, 0.0, true, 0.0, 0.0);
+    }
+
+    g_string_free(text, TRUE);
+    sqchat_watchdog_leave();
+}
+
+// Loads more of the backlog once the user scrolls all the way to the top
+static void backlog_scroll_cb(GtkAdjustment * adjustment,
+                              struct sqchat_buffer * buffer) {
+    if (buffer->backlog != NULL &&
+        gtk_adjustment_get_value(adjustment) <=
+        gtk_adjustment_get_lower(adjustment))
+        sqchat_buffer_load_backlog(buffer);
+}
+
+static void flush_dirty_buffers() {
+    GSList * dirty;
+
+    g_mutex_lock(&dirty_mutex);
+    dirty = dirty_buffers;
+    dirty_buffers = NULL;
+    flush_scheduled = false;
+    g_mutex_unlock(&dirty_mutex);
+
+    for (GSList * l = dirty; l != NULL; l = l->next)
+        flush_buffer_output(l->data);
+
+    g_slist_free(dirty);
+}
+
+// Whichever of the tick or the fallback runs first cancels the other
+static void cancel_scheduled_flush() {
+    if (tick_id != 0) {
+        gtk_widget_remove_tick_callback(tick_widget, tick_id);
+        tick_id = 0;
+    }
+    if (fallback_id != 0) {
+        g_source_remove(fallback_id);
+        fallback_id = 0;
+    }
+    g_clear_object(&tick_widget);
+}
+
+static gboolean flush_tick(GtkWidget * widget,
+                           GdkFrameClock * frame_clock,
+                           gpointer data) {
+    tick_id = 0;
+    cancel_scheduled_flush();
+    flush_dirty_buffers();
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean flush_fallback(gpointer data) {
+    fallback_id = 0;
+    cancel_scheduled_flush();
+    flush_dirty_buffers();
+    return G_SOURCE_REMOVE;
+}
+
+/* Waits for the next frame to flush everything, so we never touch the text
+ * buffers more then once per frame. If there's no window that's going to draw
+ * a frame, there's no point in waiting, and if the window doesn't get around
+ * to drawing one soon we flush without it so the queues can't keep growing.
+ */
+static gboolean schedule_flush(struct sqchat_chat_window * window) {
+    if (window != NULL && gtk_widget_get_mapped(window->window)) {
+        tick_widget = g_object_ref(window->window);
+        tick_id = gtk_widget_add_tick_callback(window->window, flush_tick,
+                                               NULL, NULL);
+        fallback_id = g_timeout_add(SQCHAT_FLUSH_FALLBACK, flush_fallback,
+                                    NULL);
+    }
+    else
+        flush_dirty_buffers();
+
+    return false;
+}
+
+// Called with the buffer's output mutex held, from any thread
+static void mark_dirty(struct sqchat_buffer * buffer) {
+    g_mutex_lock(&dirty_mutex);
+    dirty_buffers = g_slist_prepend(dirty_buffers, buffer);
+
+    // Tick callbacks can only be added from the main thread
+    if (!flush_scheduled) {
+        flush_scheduled = true;
+        g_idle_add((GSourceFunc)schedule_flush, buffer->window);
+    }
+    g_mutex_unlock(&dirty_mutex);
+}
+
+static void print_to_buffer(struct sqchat_buffer * buffer,
+                            bool log,
+                            const char * msg,
+                            va_list args) {
+    va_list args_copy;
+    size_t start;
+    size_t parsed_msg_len;
+
+    va_copy(args_copy, args);
+    parsed_msg_len = vsnprintf(NULL, 0, msg, args_copy);
+    va_end(args_copy);
+
+    // Write the message right onto the end of the queue
+    g_mutex_lock(&buffer->output_mutex);
+    if (buffer->out_queue_len++ == 0)
+        mark_dirty(buffer);
+
+    start = buffer->out_queue->len;
+    g_string_set_size(buffer->out_queue, start + parsed_msg_len);
+    vsnprintf(buffer->out_queue->str + start, parsed_msg_len + 1, msg, args);
+
+    if (log && buffer->log)
+        sqchat_log_write(buffer->log, buffer->out_queue->str + start,
+                         parsed_msg_len);
+    g_mutex_unlock(&buffer->output_mutex);
+}
+
 void sqchat_buffer_print(struct sqchat_buffer * buffer,
                          const char * msg, ...) {
     va_list args;
-    size_t parsed_msg_len;
-    struct __sqchat_queued_output * parsed_msg = malloc(sizeof(struct __sqchat_queued_output));
-
-    parsed_msg->next = NULL;
 
-    // Create the string
     va_start(args, msg);
-    parsed_msg_len = vsnprintf(NULL, 0, msg, args);
+    print_to_buffer(buffer, true, msg, args);
+    va_end(args);
+}
+
+/* Same as sqchat_buffer_print(), but leaves the message out of the buffer's
+ * log. Used for things like search results that are already in the logs.
+ */
+void sqchat_buffer_print_unlogged(struct sqchat_buffer * buffer,
+                                  const char * msg, ...) {
+    va_list args;
 
     va_start(args, msg);
-    parsed_msg->msg = malloc(parsed_msg_len + 1);
-    vsprintf(parsed_msg->msg, msg, args);
+    print_to_buffer(buffer, false, msg, args);
     va_end(args);
+}
+
+/* Prints a template to the buffer. This only takes one pass over the template
+ * and it's arguments, and doesn't allocate anything.
+ */
+void sqchat_buffer_print_format(struct sqchat_buffer * buffer,
+                                struct sqchat_format * format,
+                                unsigned int argc,
+                                const char * const * argv) {
+    size_t start;
 
-    // Add the message to the end of the queue and update the end pointer
     g_mutex_lock(&buffer->output_mutex);
-    if (buffer->out_queue == NULL) {
-        g_idle_add((GSourceFunc)flush_buffer_output, buffer);
-        buffer->out_queue = parsed_msg;
-        buffer->out_queue_end = parsed_msg;
-    }
-    else {
-        buffer->out_queue_end->next = parsed_msg;
-        buffer->out_queue_end = parsed_msg;
-    }
-    buffer->out_queue_size += parsed_msg_len;
-    parsed_msg->msg_len = parsed_msg_len;
+    if (buffer->out_queue_len++ == 0)
+        mark_dirty(buffer);
+
+    start = buffer->out_queue->len;
+    sqchat_format_expand(format, argc, argv, buffer->out_queue);
+
+    if (buffer->log)
+        sqchat_log_write(buffer->log, buffer->out_queue->str + start,
+                         buffer->out_queue->len - start);
     g_mutex_unlock(&buffer->output_mutex);
 }
 
-static gboolean flush_buffer_output(struct sqchat_buffer * buffer) {
+static void flush_buffer_output(struct sqchat_buffer * buffer) {
+    gint64 start = sqchat_stats_now();
+    sqchat_watchdog_enter("Printing to a buffer", buffer->buffer_name);
     g_mutex_lock(&buffer->output_mutex);
 
-    char output_dump[buffer->out_queue_size + 1];
-    char * dump_pos = &output_dump[0];
+    GString * output = buffer->out_queue;
     GtkTextIter end_of_buffer;
-    GtkAdjustment * scroll_adjustment =
-        gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(buffer->buffer_view));
 
-    struct __sqchat_queued_output * n;
-    // Concatenate all the messages in the queue and clear it
-    for (struct __sqchat_queued_output * c = buffer->out_queue;
-         c != NULL;
-         c = n) {
-        strcpy(dump_pos, c->msg);
-        dump_pos += c->msg_len;
-        n = c->next;
-        free(c->msg);
-        free(c);
+    // Hibernating buffers just hang onto the text until they wake up
+    if (buffer->hibernating) {
+        g_string_append_len(buffer->hibernated_text, output->str, output->len);
+        goto done;
     }
 
     // Figure out where the end of the buffer is
     gtk_text_buffer_get_end_iter(buffer->buffer, &end_of_buffer);
 
     /* If the user has manually scrolled, don't adjust the scroll position,
-     * otherwise scroll to the bottom when printing the message
+     * otherwise scroll to the bottom when printing the message. Buffers that
+     * aren't being shown catch up once they are.
      */
-    if (gtk_adjustment_get_value(scroll_adjustment) >=
-        gtk_adjustment_get_upper(scroll_adjustment) -
-        gtk_adjustment_get_page_size(scroll_adjustment) - 1e-12) {
-        gtk_text_buffer_insert(buffer->buffer, &end_of_buffer, &output_dump[0],
-                               buffer->out_queue_size);
+    if (buffer->window != NULL && buffer->window->current_buffer == buffer &&
+        scrolled_to_bottom(buffer)) {
+        insert_styled(buffer->buffer, &end_of_buffer, output->str,
+                      output->len);
         gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(buffer->buffer_view),
                                      gtk_text_buffer_get_mark(buffer->buffer,
                                                               "insert"),
                                      0.0, false, 0.0, 0.0);
     }
     else
-        gtk_text_buffer_insert(buffer->buffer, &end_of_buffer, &output_dump[0],
-                               buffer->out_queue_size);
+        insert_styled(buffer->buffer, &end_of_buffer, output->str,
+                      output->len);
+
+done:
 
-    buffer->out_queue = NULL;
-    buffer->out_queue_size = 0;
+    sqchat_stats_record_flush(buffer->out_queue_len,
+                              sqchat_stats_now() - start);
+
+    if (output->allocated_len > SQCHAT_OUTPUT_QUEUE_KEEP) {
+        g_string_free(output, TRUE);
+        buffer->out_queue = g_string_new(NULL);
+    }
+    else
+        g_string_truncate(output, 0);
+    buffer->out_queue_len = 0;
     g_mutex_unlock(&buffer->output_mutex);
-    return false;
+
+    sqchat_watchdog_leave();
 }
 
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
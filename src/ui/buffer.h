@@ -20,15 +20,42 @@
 #include "../irc_network.h"
 #include "chat_window.h"
 #include "../trie.h"
+#include "../log_writer.h"
+#include "../log_search.h"
+#include "../log_backlog.h"
+#include "../format.h"
 
 #include <gtk/gtk.h>
 
+/* If a buffer's output queue grows past this (in bytes), it gets freed after
+ * being flushed instead of hanging onto all that memory
+ */
+#define SQCHAT_OUTPUT_QUEUE_KEEP (64 * 1024)
+
+/* How long to wait for a frame before flushing output anyway (in
+ * milliseconds). Windows that are minimized or hidden might not draw one for
+ * a long time.
+ */
+#define SQCHAT_FLUSH_FALLBACK 100
+
+// How many messages from the logs get loaded at a time
+#define SQCHAT_BACKLOG_CHUNK 200
+
 enum sqchat_buffer_type {
     NETWORK,
     CHANNEL,
     QUERY
 };
 
+// In order of how much the user would want to know about it
+enum sqchat_buffer_activity {
+    SQCHAT_ACTIVITY_NONE,
+    // Joins, parts, and the like
+    SQCHAT_ACTIVITY_EVENT,
+    SQCHAT_ACTIVITY_MESSAGE,
+    SQCHAT_ACTIVITY_HIGHLIGHT
+};
+
 struct __sqchat_channel_data {
     GtkListStore * user_list_store;
     sqchat_trie * users;
@@ -39,21 +66,50 @@ struct __sqchat_query_data {
     bool received_away;
 };
 
-struct __sqchat_queued_output {
-    char * msg;
-    size_t msg_len;
-    struct __sqchat_queued_output * next;
-};
-
 struct sqchat_buffer {
     enum sqchat_buffer_type type;
     char * buffer_name;
     GtkTreeRowReference * row;
 
+    /* What's happened in the buffer since the user last looked at it. These
+     * only get pushed to the network tree once per frame, tree_dirty is set
+     * while they're waiting to be.
+     */
+    enum sqchat_buffer_activity activity;
+    unsigned int unread;
+    unsigned int highlights;
+    bool tree_dirty;
+
+    /* Output waiting to be flushed to the text buffer. Messages get written
+     * straight into here, so printing doesn't have to allocate anything once
+     * the queue's grown big enough.
+     */
     GMutex output_mutex;
-    struct __sqchat_queued_output * out_queue;
-    struct __sqchat_queued_output * out_queue_end;
-    size_t out_queue_size;
+    GString * out_queue;
+    unsigned int out_queue_len;
+
+    // NULL if logging is turned off
+    struct sqchat_log * log;
+    // The log search printing to this buffer, if there is one
+    struct sqchat_log_search * search;
+
+    /* History from before the buffer was created doesn't get loaded from the
+     * logs until the buffer is shown, and then only a chunk at a time as the
+     * user scrolls up. backlog is NULL once there's nothing left to load.
+     */
+    gint64 created;
+    bool backlog_started;
+    struct sqchat_log_backlog * backlog;
+
+    /* Buffers that haven't been looked at in a while drop all of their
+     * widgets, and just hold onto their text and whatever was typed into their
+     * command box until they get shown again. None of the widgets below exist
+     * while a buffer is hibernating.
+     */
+    bool hibernating;
+    GString * hibernated_text;
+    char * hibernated_input;
+    guint hibernate_timer;
 
     struct sqchat_network * network;
     struct sqchat_chat_window * window;
@@ -82,9 +138,35 @@ extern void sqchat_buffer_free(struct sqchat_buffer * buffer)
 extern void sqchat_buffer_destroy(struct sqchat_buffer * buffer)
     _attr_nonnull(1);
 
+extern void sqchat_buffer_wake(struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+extern void sqchat_buffer_hibernate_later(struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+
+extern void sqchat_buffer_load_backlog(struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+
 extern void sqchat_buffer_print(struct sqchat_buffer * buffer,
                                 const char * msg, ...)
     _attr_nonnull(1, 2) _attr_format(printf, 2, 3);
+extern void sqchat_buffer_print_unlogged(struct sqchat_buffer * buffer,
+                                         const char * msg, ...)
+    _attr_nonnull(1, 2) _attr_format(printf, 2, 3);
+
+extern void sqchat_buffer_print_format(struct sqchat_buffer * buffer,
+                                       struct sqchat_format * format,
+                                       unsigned int argc,
+                                       const char * const * argv)
+    _attr_nonnull(1, 2);
+
+/* Prints a template to the buffer, with the rest of the parameters as it's
+ * arguments
+ */
+#define sqchat_buffer_format(_buffer, _format, ...)                           \
+    sqchat_buffer_print_format(                                               \
+        (_buffer), (_format),                                                 \
+        sizeof((const char * []) { __VA_ARGS__ }) / sizeof(const char *),     \
+        (const char * []) { __VA_ARGS__ })
 
 #endif /* __BUFFER_H__ */
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
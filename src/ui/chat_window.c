@@ -27,6 +27,14 @@
 #include <stdlib.h>
 #include <gtk/gtk.h>
 
+// Once the user comes back to the window, it doesn't need their attention
+static gboolean focus_in_handler(GtkWidget * widget,
+                                 GdkEvent * event,
+                                 gpointer user_data) {
+    gtk_window_set_urgency_hint(GTK_WINDOW(widget), FALSE);
+    return FALSE;
+}
+
 struct sqchat_chat_window * sqchat_chat_window_new(struct sqchat_network * network) {
     struct sqchat_chat_window * new_window = malloc(sizeof(struct sqchat_chat_window));
     memset(new_window, '\0', sizeof(struct sqchat_chat_window));
@@ -110,6 +118,8 @@ struct sqchat_chat_window * sqchat_chat_window_new(struct sqchat_network * netwo
     // TODO: Destroy sqchat_chat_window struct when windows are destroyed
     g_signal_connect(new_window->window, "destroy", G_CALLBACK(gtk_main_quit),
                      NULL);
+    g_signal_connect(new_window->window, "focus-in-event",
+                     G_CALLBACK(focus_in_handler), NULL);
 
     // Show the main window
     gtk_widget_show_all(new_window->window);
@@ -131,7 +141,9 @@ void sqchat_chat_window_change_active_buffer(struct sqchat_chat_window * window,
         gtk_container_remove(
             GTK_CONTAINER(window->buffer_and_command_box_container),
             window->current_buffer->command_box_entry);
+        sqchat_buffer_hibernate_later(window->current_buffer);
     }
+    sqchat_buffer_wake(new_buffer);
     gtk_box_pack_start(GTK_BOX(window->buffer_and_command_box_container),
                        new_buffer->scrolled_container, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(window->buffer_and_command_box_container),
@@ -147,6 +159,11 @@ void sqchat_chat_window_change_active_buffer(struct sqchat_chat_window * window,
         gtk_widget_hide(window->scrolled_window_for_user_list);
 
     window->current_buffer = new_buffer;
+    sqchat_network_tree_buffer_clear_activity(new_buffer);
+
+    // Now that the buffer's actually being shown, load it's history
+    if (!new_buffer->backlog_started)
+        sqchat_buffer_load_backlog(new_buffer);
 
     // Make sure that the buffer is selected in the network tree
     gtk_tree_view_expand_to_path(GTK_TREE_VIEW(window->network_tree),
@@ -155,4 +172,17 @@ void sqchat_chat_window_change_active_buffer(struct sqchat_chat_window * window,
                              path_to_buffer,
                              NULL, false);
 }
+
+/* Lets the user know they were highlighted. The buffer gets marked in the
+ * network tree unless they're already looking at it, and the window asks for
+ * their attention if it isn't focused.
+ */
+void sqchat_chat_window_highlight(struct sqchat_chat_window * window,
+                                  struct sqchat_buffer * buffer) {
+    sqchat_network_tree_buffer_activity(buffer, SQCHAT_ACTIVITY_HIGHLIGHT);
+
+    if (!gtk_window_is_active(GTK_WINDOW(window->window)))
+        gtk_window_set_urgency_hint(GTK_WINDOW(window->window), TRUE);
+}
+
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
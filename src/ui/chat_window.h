@@ -69,6 +69,10 @@ extern void sqchat_chat_window_change_active_buffer(struct sqchat_chat_window *
                                                     struct sqchat_buffer * new_buffer)
     _attr_nonnull(1, 2);
 
+extern void sqchat_chat_window_highlight(struct sqchat_chat_window * window,
+                                         struct sqchat_buffer * buffer)
+    _attr_nonnull(1, 2);
+
 #endif // CHAT_WINDOW_H
 
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
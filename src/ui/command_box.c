@@ -17,6 +17,7 @@
 #include "chat_window.h"
 #include "../commands.h"
 #include "../chat.h"
+#include "../nick_color.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -78,7 +79,9 @@ void command_box_activated_handler(GtkEntry * entry,
             sqchat_send_privmsg(buffer->network,
                          buffer->buffer_name,
                          input);
-            sqchat_buffer_print(buffer, "<%s> %s\n",
+            sqchat_buffer_print(buffer, "<%s%s\x03> %s\n",
+                                sqchat_nick_color_code(
+                                    buffer->network->nickname),
                                 buffer->network->nickname,
                                 input);
         }
@@ -18,6 +18,7 @@
 #include "network_tree.h"
 
 #include <gtk/gtk.h>
+#include <stdio.h>
 
 #include "chat_window.h"
 #include "../net_io.h"
@@ -25,6 +26,23 @@
 
 GtkTreeIter network_tree_toplevel;
 
+/* Buffers with activity that hasn't been shown in the tree yet. Busy channels
+ * can get dozens of messages a frame, so rows only get updated once per frame
+ * instead of every time something happens.
+ */
+static GSList * dirty_rows;
+static bool update_scheduled;
+static GtkWidget * tick_widget;
+static guint tick_id;
+static guint fallback_id;
+
+static const char * const activity_colors[] = {
+    [SQCHAT_ACTIVITY_NONE]      = NULL,
+    [SQCHAT_ACTIVITY_EVENT]     = "#808080",
+    [SQCHAT_ACTIVITY_MESSAGE]   = NULL,
+    [SQCHAT_ACTIVITY_HIGHLIGHT] = "#FF0000"
+};
+
 // Sets up the network tree
 void sqchat_network_tree_setup(struct sqchat_chat_window * window) {
     GtkCellRenderer * network_tree_renderer;
@@ -32,8 +50,14 @@ void sqchat_network_tree_setup(struct sqchat_chat_window * window) {
     GtkTreeViewColumn *network_tree_title_column;
     GtkTreeViewColumn *network_tree_data_column;
 
-    window->network_tree_store = gtk_tree_store_new(2, G_TYPE_STRING,
-                                                    G_TYPE_POINTER);
+    /* The columns are the name, the buffer, the color and weight the name gets
+     * shown in, and the unread count
+     */
+    window->network_tree_store = gtk_tree_store_new(5, G_TYPE_STRING,
+                                                    G_TYPE_POINTER,
+                                                    G_TYPE_STRING,
+                                                    G_TYPE_INT,
+                                                    G_TYPE_STRING);
     window->network_tree = gtk_tree_view_new_with_model(
             GTK_TREE_MODEL(window->network_tree_store));
     network_tree_title_column = gtk_tree_view_column_new();
@@ -48,6 +72,18 @@ void sqchat_network_tree_setup(struct sqchat_chat_window * window) {
                                     network_tree_renderer, TRUE);
     gtk_tree_view_column_add_attribute(network_tree_title_column,
                                        network_tree_renderer, "text", 0);
+    gtk_tree_view_column_add_attribute(network_tree_title_column,
+                                       network_tree_renderer, "foreground", 2);
+    gtk_tree_view_column_add_attribute(network_tree_title_column,
+                                       network_tree_renderer, "weight", 3);
+
+    network_tree_renderer = gtk_cell_renderer_text_new();
+    gtk_tree_view_column_pack_start(network_tree_data_column,
+                                    network_tree_renderer, FALSE);
+    gtk_tree_view_column_add_attribute(network_tree_data_column,
+                                       network_tree_renderer, "text", 4);
+    gtk_tree_view_column_add_attribute(network_tree_data_column,
+                                       network_tree_renderer, "foreground", 2);
     gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(window->network_tree),
                                       FALSE);
     gtk_tree_view_set_show_expanders(GTK_TREE_VIEW(window->network_tree),
@@ -138,7 +174,8 @@ void sqchat_network_tree_network_add(struct sqchat_chat_window * window,
     gtk_tree_store_append(window->network_tree_store,
                           &network_tree_toplevel, NULL);
     gtk_tree_store_set(window->network_tree_store, &network_tree_toplevel,
-                       0, "untitled", 1, network->buffer, -1);
+                       0, "untitled", 1, network->buffer,
+                       3, PANGO_WEIGHT_NORMAL, -1);
 
     toplevel_path =
         gtk_tree_model_get_path(GTK_TREE_MODEL(window->network_tree_store),
@@ -203,7 +240,8 @@ void sqchat_network_tree_buffer_add(struct sqchat_buffer * buffer,
     gtk_tree_store_append(GTK_TREE_STORE(tree_model), &buffer_row,
                           &network_row);
     gtk_tree_store_set(GTK_TREE_STORE(tree_model), &buffer_row, 0,
-                       buffer->buffer_name, 1, buffer, -1);
+                       buffer->buffer_name, 1, buffer,
+                       3, PANGO_WEIGHT_NORMAL, -1);
 
     // Store a reference in the network's sqchat_trie and in the buffer
     buffer_ref = gtk_tree_row_reference_new(tree_model,
@@ -225,6 +263,142 @@ void sqchat_network_tree_buffer_remove(struct sqchat_buffer * buffer) {
     gtk_tree_store_remove(GTK_TREE_STORE(network_tree_model), &buffer_row);
 }
 
+static void update_row(struct sqchat_buffer * buffer) {
+    GtkTreeModel * network_tree_model;
+    GtkTreePath * path;
+    GtkTreeIter buffer_row;
+    char unread[sizeof("4294967295 (4294967295)")];
+
+    buffer->tree_dirty = false;
+
+    // The row might have been removed since it was marked
+    if (buffer->row == NULL ||
+        (path = gtk_tree_row_reference_get_path(buffer->row)) == NULL)
+        return;
+
+    network_tree_model = gtk_tree_row_reference_get_model(buffer->row);
+    gtk_tree_model_get_iter(network_tree_model, &buffer_row, path);
+    gtk_tree_path_free(path);
+
+    if (buffer->highlights)
+        snprintf(unread, sizeof(unread), "%u (%u)", buffer->unread,
+                 buffer->highlights);
+    else
+        snprintf(unread, sizeof(unread), "%u", buffer->unread);
+
+    gtk_tree_store_set(GTK_TREE_STORE(network_tree_model), &buffer_row,
+                       2, activity_colors[buffer->activity],
+                       3, buffer->activity >= SQCHAT_ACTIVITY_MESSAGE
+                           ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL,
+                       4, buffer->unread ? unread : NULL, -1);
+}
+
+static void update_dirty_rows() {
+    GSList * dirty = dirty_rows;
+
+    // Whichever of the tick or the fallback runs first cancels the other
+    if (tick_id != 0)
+        gtk_widget_remove_tick_callback(tick_widget, tick_id);
+    if (fallback_id != 0)
+        g_source_remove(fallback_id);
+    tick_id = fallback_id = 0;
+    g_clear_object(&tick_widget);
+
+    dirty_rows = NULL;
+    update_scheduled = false;
+
+    for (GSList * l = dirty; l != NULL; l = l->next)
+        update_row(l->data);
+
+    g_slist_free(dirty);
+}
+
+static gboolean update_tick(GtkWidget * widget,
+                            GdkFrameClock * frame_clock,
+                            gpointer data) {
+    tick_id = 0;
+    update_dirty_rows();
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean update_idle(gpointer data) {
+    update_dirty_rows();
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean update_fallback(gpointer data) {
+    fallback_id = 0;
+    update_dirty_rows();
+    return G_SOURCE_REMOVE;
+}
+
+/* Same idea as flushing buffer output, the row waits for the next frame, or
+ * SQCHAT_FLUSH_FALLBACK milliseconds if the window isn't drawing any. If
+ * there's no window that's going to draw one, everything that happened by the
+ * time the main loop goes idle still gets batched together.
+ */
+static void mark_row_dirty(struct sqchat_buffer * buffer) {
+    if (buffer->tree_dirty)
+        return;
+
+    buffer->tree_dirty = true;
+    dirty_rows = g_slist_prepend(dirty_rows, buffer);
+
+    if (update_scheduled)
+        return;
+
+    update_scheduled = true;
+    if (buffer->window != NULL &&
+        gtk_widget_get_mapped(buffer->window->window)) {
+        tick_widget = g_object_ref(buffer->window->window);
+        tick_id = gtk_widget_add_tick_callback(tick_widget, update_tick, NULL,
+                                               NULL);
+        fallback_id = g_timeout_add(SQCHAT_FLUSH_FALLBACK, update_fallback,
+                                    NULL);
+    }
+    else
+        g_idle_add(update_idle, NULL);
+}
+
+/* Counts something happening in a buffer the user isn't looking at. Messages
+ * and highlights both count as unread, and the buffer's activity level only
+ * ever goes up until it's shown.
+ */
+void sqchat_network_tree_buffer_activity(struct sqchat_buffer * buffer,
+                                         enum sqchat_buffer_activity activity) {
+    if (buffer->window != NULL && buffer->window->current_buffer == buffer)
+        return;
+
+    if (activity >= SQCHAT_ACTIVITY_MESSAGE)
+        buffer->unread++;
+    if (activity == SQCHAT_ACTIVITY_HIGHLIGHT)
+        buffer->highlights++;
+
+    // Joins and parts don't change anything once there's been a message
+    if (activity < SQCHAT_ACTIVITY_MESSAGE && activity <= buffer->activity)
+        return;
+
+    if (activity > buffer->activity)
+        buffer->activity = activity;
+    mark_row_dirty(buffer);
+}
+
+void sqchat_network_tree_buffer_clear_activity(struct sqchat_buffer * buffer) {
+    if (buffer->activity == SQCHAT_ACTIVITY_NONE)
+        return;
+
+    buffer->activity = SQCHAT_ACTIVITY_NONE;
+    buffer->unread = 0;
+    buffer->highlights = 0;
+    mark_row_dirty(buffer);
+}
+
+// Makes sure a row doesn't get updated after it's buffer has been freed
+void sqchat_network_tree_buffer_forget(struct sqchat_buffer * buffer) {
+    if (buffer->tree_dirty)
+        dirty_rows = g_slist_remove(dirty_rows, buffer);
+}
+
 // Callbacks
 /* TODO: Modify this handler to also work with all types of buffers, not just
  * network buffers
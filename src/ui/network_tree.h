@@ -40,6 +40,16 @@ extern void sqchat_network_tree_buffer_add(struct sqchat_buffer * buffer,
 extern void sqchat_network_tree_buffer_remove(struct sqchat_buffer * buffer)
     _attr_nonnull(1);
 
+extern void sqchat_network_tree_buffer_activity(
+    struct sqchat_buffer * buffer,
+    enum sqchat_buffer_activity activity)
+    _attr_nonnull(1);
+extern void sqchat_network_tree_buffer_clear_activity(
+    struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+extern void sqchat_network_tree_buffer_forget(struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+
 #endif /* __NETWORK_TREE_H__ */
 
 // vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
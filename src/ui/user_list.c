@@ -17,6 +17,8 @@
 #include "user_list.h"
 #include "chat_window.h"
 #include "buffer.h"
+#include "../nick_color.h"
+#include "../text_style.h"
 
 #include <gtk/gtk.h>
 #include <string.h>
@@ -36,6 +38,11 @@ int sqchat_user_list_user_row_find(const struct sqchat_buffer * buffer,
     return 0;
 }
 
+unsigned int sqchat_user_list_user_count(const struct sqchat_buffer * buffer) {
+    return gtk_tree_model_iter_n_children(
+        GTK_TREE_MODEL(buffer->chan_data->user_list_store), NULL);
+}
+
 char * sqchat_user_list_user_get_prefixes(const struct sqchat_buffer * buffer,
                                           GtkTreeIter * user) {
     GValue value = G_VALUE_INIT;
@@ -56,13 +63,18 @@ static inline void set_user_prefixes(struct sqchat_buffer * buffer,
 
 void sqchat_user_list_setup(struct sqchat_chat_window * window) {
     GtkCellRenderer * renderer = gtk_cell_renderer_text_new();
+    /* The name column needs a renderer of it's own, otherwise the prefixes
+     * would end up in whatever color the last name was drawn in
+     */
+    GtkCellRenderer * name_renderer = gtk_cell_renderer_text_new();
 
     GtkTreeViewColumn * prefix_column =
         gtk_tree_view_column_new_with_attributes("User prefix", renderer,
                                                  "text", 0, NULL);
     GtkTreeViewColumn * name_column =
-        gtk_tree_view_column_new_with_attributes("Name", renderer,
-                                                 "text", 1, NULL);
+        gtk_tree_view_column_new_with_attributes("Name", name_renderer,
+                                                 "text", 1,
+                                                 "foreground", 3, NULL);
     GtkTreeViewColumn * data_column = gtk_tree_view_column_new();
 
     gtk_tree_view_column_set_sizing(prefix_column,
@@ -96,14 +108,20 @@ void sqchat_user_list_user_add(struct sqchat_buffer * buffer,
                            0, &prefix_row_str[0], -1);
     }
 
+    /* The color's worked out once here and kept in the user's row, so the list
+     * doesn't have to hash every nickname each time it gets drawn
+     */
     if (buffer->network->multi_prefix)
         gtk_list_store_set(buffer->chan_data->user_list_store, &new_user_row,
                            1, nickname, 2,
                            prefix_str ? strndup(prefix_str, prefix_len) : NULL,
+                           3, sqchat_text_colors[sqchat_nick_color(nickname)],
                            -1);
     else
         gtk_list_store_set(buffer->chan_data->user_list_store, &new_user_row,
-                           1, nickname, -1);
+                           1, nickname,
+                           3, sqchat_text_colors[sqchat_nick_color(nickname)],
+                           -1);
 
     sqchat_trie_set(buffer->chan_data->users, nickname,
              gtk_tree_row_reference_new(
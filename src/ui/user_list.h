@@ -40,6 +40,10 @@ extern int sqchat_user_list_user_prefix_subtract(struct sqchat_buffer * buffer,
                                                  char prefix)
     _attr_nonnull(1, 2);
 
+extern unsigned int sqchat_user_list_user_count(
+    const struct sqchat_buffer * buffer)
+    _attr_nonnull(1);
+
 extern int sqchat_user_list_user_row_find(const struct sqchat_buffer * buffer,
                                           const char * nickname,
                                           GtkTreeIter * user_row)
@@ -0,0 +1,231 @@
+/* Keeps an eye on the main loop, and catches whatever is keeping it from
+ * running when it stops responding
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "watchdog.h"
+#include "stats.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The main loop checks in on a timer, and the watchdog thread checks to see
+ * how long it's been since it last did. Everything here is protected by
+ * watchdog_mutex.
+ */
+static GMutex watchdog_mutex;
+static gint64 last_heartbeat;
+
+static bool stalled;
+static gint64 stall_start;
+static char stall_context[SQCHAT_WATCHDOG_CONTEXT_LEN];
+
+/* What the main thread says it's doing right now. These get set on every
+ * message, so instead of being behind the mutex they're a seqlock: only the
+ * main thread writes them, and it makes context_seq odd while it's in the
+ * middle of doing so. The watchdog thread can then tell if what it read got
+ * changed under it. The detail gets copied in here (as words, so it can be
+ * read atomically) since whatever the caller passed might be freed as soon as
+ * the main thread moves on. context_what is NULL when the main thread isn't
+ * doing anything in particular.
+ */
+static const char * context_what;
+static gint context_detail[SQCHAT_WATCHDOG_CONTEXT_LEN / sizeof(gint)];
+static gint context_seq;
+// The context_seq of the context the main loop last stalled in
+static gint stalled_seq;
+
+// Only touched by the main thread
+static unsigned int context_depth;
+static gint entered_seq;
+
+static struct sqchat_watchdog_stats watchdog_stats;
+
+static gboolean heartbeat(gpointer data) {
+    gint64 now = sqchat_stats_now();
+    gint64 lateness;
+
+    g_mutex_lock(&watchdog_mutex);
+
+    lateness = now - last_heartbeat -
+               (gint64)SQCHAT_WATCHDOG_INTERVAL * 1000000;
+    sqchat_histogram_add(&sqchat_stats.loop_latency, MAX(lateness, 0));
+
+    if (stalled) {
+        gint64 stall_time = now - stall_start;
+
+        watchdog_stats.stalls++;
+        watchdog_stats.total_time += stall_time;
+        watchdog_stats.max_time = MAX(watchdog_stats.max_time, stall_time);
+        strcpy(watchdog_stats.last_context, stall_context);
+
+        stalled = false;
+    }
+
+    last_heartbeat = now;
+    g_mutex_unlock(&watchdog_mutex);
+
+    return TRUE;
+}
+
+/* Only the watchdog thread formats the context, and only once it's actually
+ * caught the main loop stalling
+ */
+static void describe_context() {
+    char detail[sizeof(context_detail)];
+    const char * what;
+    gint seq;
+
+    // The main thread's stalled, so it shouldn't take more than one retry
+    for (int tries = 0; tries < 3; tries++) {
+        seq = g_atomic_int_get(&context_seq);
+        if (seq % 2 == 1) {
+            g_thread_yield();
+            continue;
+        }
+
+        what = g_atomic_pointer_get(&context_what);
+        for (size_t i = 0; i < G_N_ELEMENTS(context_detail); i++) {
+            gint word = g_atomic_int_get(&context_detail[i]);
+            memcpy(&detail[i * sizeof(gint)], &word, sizeof(gint));
+        }
+        detail[sizeof(detail) - 1] = '\0';
+
+        // If the main thread moved on while we were looking, try again
+        if (g_atomic_int_get(&context_seq) != seq)
+            continue;
+
+        if (what == NULL)
+            break;
+
+        if (detail[0] != '\0')
+            snprintf(stall_context, sizeof(stall_context), "%s (%s)", what,
+                     detail);
+        else
+            snprintf(stall_context, sizeof(stall_context), "%s", what);
+
+        g_atomic_int_set(&stalled_seq, seq);
+        return;
+    }
+
+    strcpy(stall_context, "outside of a message handler");
+}
+
+static gpointer watchdog_thread(gpointer data) {
+    gint64 now;
+
+    while (true) {
+        g_usleep(SQCHAT_WATCHDOG_INTERVAL * 1000);
+
+        g_mutex_lock(&watchdog_mutex);
+        now = sqchat_stats_now();
+
+        if (!stalled && now - last_heartbeat >
+                        (gint64)SQCHAT_WATCHDOG_THRESHOLD * 1000000) {
+            stalled = true;
+            stall_start = last_heartbeat;
+
+            // Take note of what's going on while it's still going on
+            describe_context();
+        }
+
+        g_mutex_unlock(&watchdog_mutex);
+    }
+
+    return NULL;
+}
+
+// Starts watching the default main context. Should be called before it runs.
+void sqchat_watchdog_init() {
+    g_mutex_init(&watchdog_mutex);
+    last_heartbeat = sqchat_stats_now();
+
+    g_timeout_add(SQCHAT_WATCHDOG_INTERVAL, heartbeat, NULL);
+    g_thread_unref(g_thread_new("Watchdog", watchdog_thread, NULL));
+}
+
+static void publish_context(const char * what, const char * detail) {
+    // Nobody else writes context_seq, so we don't need to worry about races
+    guint seq = g_atomic_int_get(&context_seq);
+
+    g_atomic_int_set(&context_seq, seq + 1);
+    g_atomic_pointer_set(&context_what, what);
+
+    if (detail) {
+        char copy[sizeof(context_detail)];
+        size_t len = MIN(strlen(detail), sizeof(copy) - 1);
+        size_t words = len / sizeof(gint) + 1;
+
+        // Don't hand the watchdog thread garbage after the terminator
+        memset(&copy[(words - 1) * sizeof(gint)], 0, sizeof(gint));
+        memcpy(copy, detail, len);
+        copy[len] = '\0';
+
+        for (size_t i = 0; i < words; i++) {
+            gint word;
+
+            memcpy(&word, &copy[i * sizeof(gint)], sizeof(gint));
+            g_atomic_int_set(&context_detail[i], word);
+        }
+    }
+    else
+        g_atomic_int_set(&context_detail[0], 0);
+
+    g_atomic_int_set(&context_seq, seq + 2);
+}
+
+/* Lets the watchdog know what the main thread is about to do, so it can say
+ * what was going on if the main loop stalls. what has to be a string that's
+ * never freed, like a string literal, and detail (which can be NULL) gets
+ * copied, and cut short if it's too long. Calls to this can be nested, in which
+ * case only the outermost one is what gets reported. It should only be called
+ * from the main thread.
+ */
+void sqchat_watchdog_enter(const char * what, const char * detail) {
+    if (context_depth++ > 0)
+        return;
+
+    publish_context(what, detail);
+    entered_seq = g_atomic_int_get(&context_seq);
+}
+
+/* Lets the watchdog know the main thread finished whatever it said it was doing
+ * with sqchat_watchdog_enter(). If the main loop stalled in the meantime,
+ * returns how long it's been stalled for in nanoseconds, otherwise returns 0.
+ * Leaving a nested call always returns 0, the outermost one gets the stall.
+ */
+gint64 sqchat_watchdog_leave() {
+    if (--context_depth > 0)
+        return 0;
+
+    publish_context(NULL, NULL);
+
+    /* stall_start gets set before stalled_seq, and the watchdog thread won't
+     * touch it again until the next heartbeat clears the stall
+     */
+    if (g_atomic_int_get(&stalled_seq) != entered_seq)
+        return 0;
+    return sqchat_stats_now() - stall_start;
+}
+
+void sqchat_watchdog_get_stats(struct sqchat_watchdog_stats * stats) {
+    g_mutex_lock(&watchdog_mutex);
+    memcpy(stats, &watchdog_stats, sizeof(struct sqchat_watchdog_stats));
+    g_mutex_unlock(&watchdog_mutex);
+}
+
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4:
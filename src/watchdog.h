@@ -0,0 +1,55 @@
+/* Keeps an eye on the main loop, and catches whatever is keeping it from
+ * running when it stops responding
+ *
+ * Copyright (C) 2013 Stephen Chandler Paul
+ *
+ * This file is free software: you may copy it, redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of this License or (at your option) any
+ * later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WATCHDOG_H__
+#define __WATCHDOG_H__
+
+#include <glib.h>
+#include <stdbool.h>
+
+// How often the main loop checks in with the watchdog, in milliseconds
+#define SQCHAT_WATCHDOG_INTERVAL    20
+
+/* How long the main loop can go without checking in before it counts as
+ * stalled, in milliseconds
+ */
+#define SQCHAT_WATCHDOG_THRESHOLD   200
+
+// The longest description of what the main loop is doing that we keep
+#define SQCHAT_WATCHDOG_CONTEXT_LEN 128
+
+struct sqchat_watchdog_stats {
+    unsigned long stalls;
+    gint64 total_time;
+    gint64 max_time;
+
+    // What the main loop was doing during the last stall
+    char last_context[SQCHAT_WATCHDOG_CONTEXT_LEN];
+};
+
+extern void sqchat_watchdog_init();
+
+extern void sqchat_watchdog_enter(const char * what, const char * detail)
+    _attr_nonnull(1);
+extern gint64 sqchat_watchdog_leave();
+
+extern void sqchat_watchdog_get_stats(struct sqchat_watchdog_stats * stats)
+    _attr_nonnull(1);
+
+#endif // __WATCHDOG_H__
+// vim: set expandtab tw=80 shiftwidth=4 softtabstop=4 cinoptions=(0,W4: